@@ -0,0 +1,130 @@
+/*
+ *
+ * Low power example for treacle (https://github.com/ncmreynolds/treacle)
+ *
+ * This example starts treacle with LoRa as a transport then sleeps between the ticks treacle must send.
+ *
+ * The LoRa radio is left receiving and its IRQ pin wakes the microcontroller if a packet arrives.
+ *
+ * On ESP32 light sleep is used, which keeps millis() running. On AVR power down stops millis() so
+ * the time asleep is passed to catchUp() instead, here using the LowPower library from Rocket Scream.
+ * The rising edge the LoRa library listens for can't wake AVR from power down, so a pin change interrupt
+ * on the same pin does that.
+ *
+ * Every few minutes it prints how much of the time it has been awake, compared to the 100% of polling messageWaiting().
+ *
+ */
+#include <treacle.h>
+#if defined(AVR)
+  #include <LowPower.h>
+#endif
+
+uint8_t encryptionKey[] = {0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80};
+uint32_t timeOfLastMessage = 0;
+uint32_t timeOfLastReport = 0;
+uint32_t timeAsleep = 0;
+#if defined(AVR)
+  volatile bool woken = false;
+#endif
+char message[] = "Hello there";
+#if defined(ESP32)
+  uint8_t loRaCsPin = 5;
+  uint8_t loRaResetPin = 14;
+  uint8_t loRaIrqPin = 26;
+#else
+  uint8_t loRaCsPin = 10;
+  uint8_t loRaResetPin = 9;
+  uint8_t loRaIrqPin = 2;
+#endif
+
+void setup()
+{
+  Serial.begin(115200);                         //Set up the Serial Monitor
+  delay(1000);                                  //Allow the IDE Serial Monitor to start after flashing
+  #if !defined(AVR)
+    treacle.enableDebug(Serial);              //Enable debug on Serial, but not on AVR to reduce memory use
+  #endif
+  treacle.setLoRaPins(loRaCsPin, loRaResetPin, loRaIrqPin); //Set the LoRa reset, CS and IRQ pins, the IRQ pin is needed to receive while asleep
+  treacle.setLoRaFrequency(868E6);              //Set the LoRa frequency to 868Mhz. Valid value are 433/868/915Mhz depending on region
+  treacle.enableLoRa();                         //Enable LoRa
+  treacle.setEncryptionKey(encryptionKey);      //Set encryption key for all protocols
+  Serial.print("Starting LoRa low power node:");
+  if(treacle.begin())                           //Start treacle
+  {
+    Serial.println("OK");
+  }
+  else
+  {
+    Serial.println("failed");
+  }
+  #if defined(ESP32)
+    esp_sleep_enable_ext0_wakeup((gpio_num_t)loRaIrqPin, 1);  //Wake when the LoRa radio raises its IRQ pin
+  #elif defined(AVR)
+    *digitalPinToPCMSK(loRaIrqPin) |= bit(digitalPinToPCMSKbit(loRaIrqPin));  //Pin change interrupts can wake from power down
+    PCIFR |= bit(digitalPinToPCICRbit(loRaIrqPin));
+    PCICR |= bit(digitalPinToPCICRbit(loRaIrqPin));
+  #endif
+}
+
+#if defined(AVR)
+ISR(PCINT2_vect)                                //Pin 2 is on PCINT2, change this if the IRQ pin is moved
+{
+  woken = true;
+}
+#endif
+
+void loop()
+{
+  if(treacle.messageWaiting() > 0)
+  {
+    Serial.println(F("Message waiting"));
+    treacle.clearWaitingMessage();
+  }
+  #if defined(AVR)
+    uint32_t timeElapsed = millis() + timeAsleep;  //millis() does not include time powered down
+  #else
+    uint32_t timeElapsed = millis();
+  #endif
+  if(timeElapsed - timeOfLastMessage > 300E3)   //Send a message every 5 minutes
+  {
+    timeOfLastMessage = timeElapsed;
+    if(treacle.online() == true)
+    {
+      treacle.queueMessage(message);
+    }
+  }
+  if(timeElapsed - timeOfLastReport > 300E3)    //Report the awake time every 5 minutes
+  {
+    Serial.print("Awake ");
+    Serial.print(100.0 - (100.0 * timeAsleep) / timeElapsed);
+    Serial.println("% of the time, polling would be 100%");
+    timeOfLastReport = timeElapsed;
+  }
+  uint32_t sleepTime = treacle.nextMandatoryTickInMs();
+  if(sleepTime > 10)                            //Not worth sleeping for very short periods
+  {
+    Serial.flush();
+    #if defined(ESP32)
+      uint32_t sleepStart = millis();
+      esp_sleep_enable_timer_wakeup(sleepTime * 1000ULL);
+      esp_light_sleep_start();
+      timeAsleep += millis() - sleepStart;
+      treacle.catchUp();                        //millis() carries on during light sleep
+    #elif defined(AVR)
+      uint32_t sleptFor = 0;
+      woken = false;
+      while(sleptFor + 1000 < sleepTime && digitalRead(loRaIrqPin) == LOW)  //Power down in 1s chunks until the tick is due or a packet arrives
+      {
+        LowPower.powerDown(SLEEP_1S, ADC_OFF, BOD_OFF);
+        if(woken == true)
+        {
+          sleptFor += 500;                      //Woken part way through by the IRQ pin, on average half way
+          break;
+        }
+        sleptFor += 1000;
+      }
+      timeAsleep += sleptFor;
+      treacle.catchUp(sleptFor);                //millis() stops during power down, so tell treacle how long it was
+    #endif
+  }
+}
@@ -0,0 +1,99 @@
+/*
+ *	Acknowledged message delivery over a lossy COBS link
+ *
+ *	Two nodes on a COBS link. Once both are online the link drops whole
+ *	frames at 1%, 10% and then 30%, and one node sends acknowledged messages
+ *	to the other, one at a time. Prints how many the delivery callback
+ *	reported delivered or failed, their latency, and the final round trip
+ *	time and retransmission timeout
+ *
+ *	Usage: acknowledgedMessages [to all nodes 0/1]
+ *
+ */
+#include "host.h"
+#include <treacle.h>
+
+static uint32_t delivered, failed, totalLatency, maximumLatency;
+
+static void deliveryCallback(uint8_t, bool success, uint32_t latency)
+{
+	if(success)
+	{
+		delivered++;
+		totalLatency += latency;
+		maximumLatency = max(maximumLatency, latency);
+	}
+	else
+	{
+		failed++;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	uint8_t destination = argc > 1 && atoi(argv[1]) ? 255 : 2;	//255 is all nodes
+	const double lossRates[] = {0.01, 0.10, 0.30};
+	for(double lossRate : lossRates)
+	{
+		hostMicros = 0;
+		delivered = failed = totalLatency = maximumLatency = 0;
+		hostLink linkA, linkB;
+		linkA.connect(linkB);
+		linkB.connect(linkA);
+		treacleClass* a = new treacleClass;
+		treacleClass* b = new treacleClass;
+		a->setNodeName((char*)"A");
+		b->setNodeName((char*)"B");
+		a->setNodeId(1);
+		b->setNodeId(2);
+		a->enableCobs();
+		a->setCobsStream(linkA);
+		b->enableCobs();
+		b->setCobsStream(linkB);
+		a->begin();
+		b->begin();
+		a->setMaxDutyCycle(0, 100);
+		b->setMaxDutyCycle(0, 100);
+		a->setDeliveryCallback(deliveryCallback);
+		uint32_t sent = 0, received = 0, damaged = 0;
+		uint8_t message[64] = {0xa5};
+		uint8_t buffer[64];
+		for(uint32_t step = 0; step < 2000000; step++)
+		{
+			hostMicros += 1000;
+			a->messageWaiting();
+			uint32_t waiting = b->messageWaiting();
+			if(waiting > 0)
+			{
+				b->retrieveWaitingMessage(buffer);
+				b->clearWaitingMessage();
+				if(buffer[0] != 0xa5 || waiting != (uint32_t)buffer[1]%50 + 10)
+				{
+					damaged++;
+				}
+				else
+				{
+					received++;
+				}
+			}
+			if(a->online() && b->online() && millis() > 200000)		//Let the nodes settle before losing frames
+			{
+				linkA.lossRate = lossRate;
+				linkB.lossRate = lossRate;
+				if(step%2000 == 0 && a->acknowledgedMessageInProgress() == false)
+				{
+					message[1] = sent;
+					if(a->queueAcknowledgedMessage(destination, message, message[1]%50 + 10) != 0)
+					{
+						sent++;
+					}
+				}
+			}
+		}
+		printf("loss %2.0f%%: sent %u received %u delivered %u failed %u latency mean %.1fms maximum %ums round trip %ums timeout %ums damaged %u\n",
+			lossRate*100, sent, received, delivered, failed, delivered ? (double)totalLatency/delivered : 0, maximumLatency,
+			a->getRoundTripTime(0), a->getRetransmissionTimeout(0), damaged);
+		delete a;
+		delete b;
+	}
+}
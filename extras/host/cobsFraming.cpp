@@ -0,0 +1,93 @@
+/*
+ *	COBS framing check
+ *
+ *	Two nodes on a lossless COBS link. One sends application messages of
+ *	every length, filled with random bytes of which about a quarter are zero,
+ *	and the other checks each one arrives intact and in order. Any message
+ *	lost or changed points at the COBS encoder or decoder
+ *
+ *	Usage: cobsFraming [messages per length]
+ *
+ */
+#include "host.h"
+#include <treacle.h>
+
+static const uint8_t largestMessage = 237;			//One less than treacle's maximum payload size
+
+int main(int argc, char** argv)
+{
+	uint32_t repeats = argc > 1 ? atoi(argv[1]) : 4;
+	hostLink linkA, linkB;
+	linkA.connect(linkB);
+	linkB.connect(linkA);
+	treacleClass* a = new treacleClass;
+	treacleClass* b = new treacleClass;
+	a->setNodeName((char*)"A");
+	b->setNodeName((char*)"B");
+	a->setNodeId(1);
+	b->setNodeId(2);
+	a->enableCobs();
+	a->setCobsStream(linkA);
+	b->enableCobs();
+	b->setCobsStream(linkB);
+	a->begin();
+	b->begin();
+	a->setMaxDutyCycle(0, 100);
+	b->setMaxDutyCycle(0, 100);
+	std::deque<std::vector<uint8_t>> inFlight;			//Messages sent but not yet received, in order
+	uint32_t sent = 0, intact = 0, changed = 0, lost = 0;
+	uint8_t received[largestMessage];
+	uint8_t length = 1;
+	uint32_t repeat = 0;
+	while(length <= largestMessage || inFlight.empty() == false)
+	{
+		hostMicros += 1000;
+		a->messageWaiting();
+		uint32_t waiting = b->messageWaiting();
+		if(waiting > 0)
+		{
+			b->retrieveWaitingMessage(received);
+			b->clearWaitingMessage();
+			std::deque<std::vector<uint8_t>>::iterator match = inFlight.begin();
+			while(match != inFlight.end() && (match->size() != waiting || memcmp(received, match->data(), waiting) != 0))
+			{
+				match++;
+			}
+			if(match == inFlight.end())
+			{
+				changed++;
+			}
+			else
+			{
+				lost += match - inFlight.begin();	//Anything skipped over was lost
+				inFlight.erase(inFlight.begin(), match + 1);
+				intact++;
+			}
+		}
+		if(length <= largestMessage && a->online() && b->online() && hostMicros%100000 == 0)
+		{
+			std::vector<uint8_t> message(length);
+			for(uint8_t& character : message)
+			{
+				character = hostChance(0.25) ? 0 : hostRandom();
+			}
+			if(a->sendMessage(message.data(), length))
+			{
+				inFlight.push_back(message);
+				sent++;
+				if(++repeat == repeats)
+				{
+					repeat = 0;
+					length++;
+				}
+			}
+		}
+		if(hostMicros > 3600000000ULL)					//Give up on anything still in flight after an hour
+		{
+			lost += inFlight.size();
+			break;
+		}
+	}
+	printf("messages of 1-%u bytes: sent %u intact %u changed %u lost %u\n", largestMessage, sent, intact, changed, lost);
+	return changed + lost > 0;
+}
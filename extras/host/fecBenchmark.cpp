@@ -0,0 +1,134 @@
+/*
+ *	Forward error correction encode and decode cost
+ *
+ *	Two nodes on a COBS link, one sending 100 byte messages to all nodes
+ *	as fast as it can. Measures the host CPU time spent inside the sender,
+ *	which builds the parity, and inside the receiver, which checks it and
+ *	rebuilds lost packets, for each group size with and without frame loss.
+ *	The extra time over a group size of 0 is the cost of error correction.
+ *	Each case is run several times and the quickest kept, to reduce noise
+ *
+ *	Usage: fecBenchmark [messages] [runs]
+ *
+ */
+#include "host.h"
+#include <treacle.h>
+#include <chrono>
+
+struct cost
+{
+	double sender;		//Nanoseconds per message sent
+	double receiver;	//Nanoseconds per message sent
+	uint32_t received;
+	uint32_t recovered;
+};
+
+static cost run(uint8_t groupSize, double lossRate, uint32_t messages)
+{
+	typedef std::chrono::steady_clock clock;
+	hostMicros = 0;
+	hostRandom.seed(1234);
+	hostLink linkA, linkB;
+	linkA.connect(linkB);
+	linkB.connect(linkA);
+	treacleClass* a = new treacleClass;
+	treacleClass* b = new treacleClass;
+	a->setNodeName((char*)"A");
+	b->setNodeName((char*)"B");
+	a->setNodeId(1);
+	b->setNodeId(2);
+	a->enableCobs();
+	a->setCobsStream(linkA);
+	b->enableCobs();
+	b->setCobsStream(linkB);
+	a->begin();
+	b->begin();
+	a->setMaxDutyCycle(0, 100);
+	b->setMaxDutyCycle(0, 100);
+	a->setForwardErrorCorrection(0, groupSize);
+	b->setForwardErrorCorrection(0, groupSize);
+	uint8_t message[100];
+	uint8_t buffer[100];
+	for(uint8_t& character : message)
+	{
+		character = hostRandom();
+	}
+	while(a->online() == false || b->online() == false || millis() < 200000)	//Settle without loss or timing
+	{
+		hostMicros += 1000;
+		a->messageWaiting();
+		if(b->messageWaiting() > 0)
+		{
+			b->clearWaitingMessage();
+		}
+	}
+	linkA.lossRate = lossRate;
+	clock::duration senderTime = clock::duration::zero(), receiverTime = clock::duration::zero();
+	uint32_t sent = 0, received = 0;
+	while(sent < messages)
+	{
+		hostMicros += 1000;
+		clock::time_point start = clock::now();
+		a->messageWaiting();
+		if(hostMicros%20000 == 0)
+		{
+			message[0] = sent;
+			sent += a->sendMessage(message, sizeof(message)) ? 1 : 0;
+		}
+		clock::time_point middle = clock::now();
+		uint32_t waiting = b->messageWaiting();
+		if(waiting > 0)
+		{
+			b->retrieveWaitingMessage(buffer);
+			b->clearWaitingMessage();
+			received++;
+		}
+		receiverTime += clock::now() - middle;
+		senderTime += middle - start;
+	}
+	cost result;
+	result.sender = std::chrono::duration<double, std::nano>(senderTime).count()/sent;
+	result.receiver = std::chrono::duration<double, std::nano>(receiverTime).count()/sent;
+	result.received = received;
+	result.recovered = b->getRecoveredPackets(0);
+	delete a;
+	delete b;
+	return result;
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t messages = argc > 1 ? atoi(argv[1]) : 5000;
+	uint8_t runs = argc > 2 ? atoi(argv[2]) : 5;
+	const uint8_t groupSizes[] = {0, 2, 4, 8};
+	const double lossRates[] = {0, 0.10};
+	for(double lossRate : lossRates)
+	{
+		cost baseline = {};
+		for(uint8_t groupSize : groupSizes)
+		{
+			cost best = {};
+			for(uint8_t attempt = 0; attempt < runs; attempt++)
+			{
+				cost result = run(groupSize, lossRate, messages);
+				if(attempt == 0 || result.sender < best.sender)
+				{
+					best.sender = result.sender;
+				}
+				if(attempt == 0 || result.receiver < best.receiver)
+				{
+					best.receiver = result.receiver;
+				}
+				best.received = result.received;
+				best.recovered = result.recovered;
+			}
+			if(groupSize == 0)
+			{
+				baseline = best;
+			}
+			printf("loss %2.0f%% group %u: sender %.0fns (+%.0f) receiver %.0fns (+%.0f) per message, received %u of %u, recovered %u\n",
+				lossRate*100, groupSize, best.sender, best.sender - baseline.sender, best.receiver, best.receiver - baseline.receiver,
+				best.received, messages, best.recovered);
+		}
+	}
+}
@@ -0,0 +1,111 @@
+/*
+ *	Forward error correction delivery over a lossy COBS link
+ *
+ *	One or two senders and a receiver share a COBS link. Once all are online
+ *	the link drops whole frames at 1%, 10% and then 30%, and the senders
+ *	take turns sending short messages to all nodes. Prints how many reached
+ *	the receiver, how many of those were rebuilt from parity and any that
+ *	arrived twice or damaged. A group size of 0 turns error correction off
+ *
+ *	Usage: fecDelivery [group size] [senders 1/2]
+ *
+ */
+#include "host.h"
+#include <treacle.h>
+#include <set>
+
+int main(int argc, char** argv)
+{
+	uint8_t groupSize = argc > 1 ? atoi(argv[1]) : 4;
+	uint8_t senders = argc > 2 ? atoi(argv[2]) : 1;
+	const double lossRates[] = {0.01, 0.10, 0.30};
+	for(double lossRate : lossRates)
+	{
+		hostMicros = 0;
+		uint8_t numberOfNodes = senders + 1;
+		std::vector<hostLink> links(numberOfNodes);
+		std::vector<treacleClass*> nodes(numberOfNodes);
+		for(uint8_t i = 0; i < numberOfNodes; i++)	//Node 0 receives, the rest send
+		{
+			for(uint8_t j = 0; j < numberOfNodes; j++)
+			{
+				if(i != j)
+				{
+					links[i].connect(links[j]);
+				}
+			}
+			nodes[i] = new treacleClass;
+			char* name = new char[5];
+			sprintf(name, "N%u", i);
+			nodes[i]->setNodeName(name);
+			nodes[i]->setNodeId(i + 1);
+			nodes[i]->enableCobs();
+			nodes[i]->setCobsStream(links[i]);
+			nodes[i]->begin();
+			nodes[i]->setMaxDutyCycle(0, 100);
+			nodes[i]->setForwardErrorCorrection(0, groupSize);
+		}
+		std::set<uint32_t> seen;
+		uint32_t sent = 0, received = 0, duplicates = 0, damaged = 0;
+		uint8_t message[64] = {};
+		uint8_t buffer[64];
+		bool allOnline = false;
+		for(uint32_t step = 0; step < 2000000; step++)
+		{
+			hostMicros += 1000;
+			for(uint8_t i = 1; i < numberOfNodes; i++)
+			{
+				nodes[i]->messageWaiting();
+			}
+			uint32_t waiting = nodes[0]->messageWaiting();
+			if(waiting > 0)
+			{
+				nodes[0]->retrieveWaitingMessage(buffer);
+				nodes[0]->clearWaitingMessage();
+				uint32_t number = buffer[1] << 16 | buffer[2] << 8 | buffer[3];	//Sender and sequence number
+				if(buffer[0] != 0xa5 || waiting != (number & 0xffff)%50 + 10)
+				{
+					damaged++;
+				}
+				else if(seen.insert(number).second == false)
+				{
+					duplicates++;
+				}
+				else
+				{
+					received++;
+				}
+			}
+			if(allOnline == false && millis() > 200000)	//Let the nodes settle before losing frames
+			{
+				allOnline = true;
+				for(uint8_t i = 0; i < numberOfNodes; i++)
+				{
+					allOnline = allOnline && nodes[i]->online();
+				}
+				for(uint8_t i = 0; allOnline && i < numberOfNodes; i++)
+				{
+					links[i].lossRate = lossRate;
+				}
+			}
+			if(allOnline && step%(2000/senders) == 0)
+			{
+				uint8_t sender = 1 + (step/(2000/senders))%senders;
+				message[0] = 0xa5;
+				message[1] = sender;
+				message[2] = sent >> 8;
+				message[3] = sent;
+				if(nodes[sender]->sendMessage(message, sent%50 + 10))
+				{
+					sent++;
+				}
+			}
+		}
+		printf("loss %2.0f%% group %u senders %u: sent %u received %u (%.1f%%) recovered %u duplicates %u damaged %u\n",
+			lossRate*100, groupSize, senders, sent, received, 100.0*received/sent, nodes[0]->getRecoveredPackets(0), duplicates, damaged);
+		for(treacleClass* node : nodes)
+		{
+			delete node;
+		}
+	}
+}
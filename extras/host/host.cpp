@@ -0,0 +1,112 @@
+/*
+ *	Shared simulation for the treacle host harnesses
+ *
+ */
+#include "host.h"
+
+uint64_t hostMicros = 0;
+uint8_t hostCurrentNode = 0;
+std::mt19937 hostRandom(hostOption("SEED", 1234));
+static double clockSkew[hostMaximumNodes];
+static uint64_t clockOffset[hostMaximumNodes];
+
+HardwareSerial Serial;
+uint8_t UniqueID8[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+
+static uint64_t localMicros()
+{
+	return clockOffset[hostCurrentNode] + (uint64_t)(hostMicros * (1.0 + clockSkew[hostCurrentNode]));
+}
+unsigned long millis()
+{
+	return localMicros()/1000;
+}
+unsigned long micros()
+{
+	return (unsigned long)localMicros();
+}
+long random(long howBig)
+{
+	return howBig <= 0 ? 0 : hostRandom()%howBig;
+}
+long random(long howSmall, long howBig)
+{
+	return howBig <= howSmall ? howSmall : howSmall + hostRandom()%(howBig - howSmall);
+}
+void randomSeed(unsigned long) {}
+void delay(unsigned long ms)
+{
+	hostMicros += ms*1000;
+}
+void delayMicroseconds(unsigned int) {}
+void yield() {}
+void pinMode(uint8_t, uint8_t) {}
+int digitalRead(uint8_t)
+{
+	return LOW;
+}
+void digitalWrite(uint8_t, uint8_t) {}
+
+void hostSetClock(uint8_t node, double skew, uint64_t offset)
+{
+	clockSkew[node] = skew;
+	clockOffset[node] = offset;
+}
+bool hostChance(double probability)
+{
+	return (hostRandom()%10000)/10000.0 < probability;
+}
+uint32_t hostOption(const char* name, uint32_t defaultValue)
+{
+	const char* value = getenv(name);
+	return value != nullptr ? strtoul(value, nullptr, 10) : defaultValue;
+}
+
+void hostLink::connect(hostLink& peer)
+{
+	peers_.push_back(&peer);
+}
+int hostLink::available()
+{
+	return received_.size();
+}
+int hostLink::read()
+{
+	if(received_.empty())
+	{
+		return -1;
+	}
+	int character = received_.front();
+	received_.pop_front();
+	return character;
+}
+int hostLink::peek()
+{
+	if(received_.empty())
+	{
+		hostMicros += 100;		//Let time pass so receive timeouts still fire
+		return -1;
+	}
+	return received_.front();
+}
+size_t hostLink::write(uint8_t character)
+{
+	frame_.push_back(character);
+	if(character == 0)			//End of a COBS frame
+	{
+		frames++;
+		for(hostLink* peer : peers_)
+		{
+			if(hostChance(lossRate))
+			{
+				dropped++;
+			}
+			else
+			{
+				peer->received_.insert(peer->received_.end(), frame_.begin(), frame_.end());
+			}
+		}
+		frame_.clear();
+	}
+	return 1;
+}
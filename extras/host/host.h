@@ -0,0 +1,43 @@
+/*
+ *	Shared simulation for the treacle host harnesses
+ *
+ *	Every node runs in one process against a simulated clock. Harnesses
+ *	advance hostMicros themselves and set hostCurrentNode before calling
+ *	into a node, so that node sees its own clock
+ *
+ */
+#ifndef host_h
+#define host_h
+#include <Arduino.h>
+#include <deque>
+#include <vector>
+#include <random>
+
+static const uint8_t hostMaximumNodes = 64;
+
+extern uint64_t hostMicros;							//Simulated time, shared by every node
+extern uint8_t hostCurrentNode;						//Node whose clock millis() and micros() currently report
+extern std::mt19937 hostRandom;						//Seeded from the SEED environment variable, 1234 by default
+
+void hostSetClock(uint8_t node, double skew, uint64_t offset);	//Give a node a clock that drifts by skew and starts at offset microseconds
+bool hostChance(double probability);				//True with the given probability
+uint32_t hostOption(const char* name, uint32_t defaultValue);	//Read a number from the environment
+
+class hostLink : public Stream	//A serial link for COBS that delivers or drops whole frames
+{
+	public:
+		void connect(hostLink& peer);					//Frames written here are copied to peer, one way
+		double lossRate = 0;							//Chance of dropping each frame to each peer
+		uint32_t frames = 0;							//Frames written
+		uint32_t dropped = 0;							//Frame copies dropped
+		int available();
+		int read();
+		int peek();
+		size_t write(uint8_t character);
+		using Print::write;
+	private:
+		std::deque<uint8_t> received_;
+		std::vector<uint8_t> frame_;
+		std::vector<hostLink*> peers_;
+};
+#endif
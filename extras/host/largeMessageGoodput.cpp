@@ -0,0 +1,88 @@
+/*
+ *	Large message goodput over a lossy COBS link
+ *
+ *	Two nodes on a COBS link. Once both are online the link starts dropping
+ *	whole frames at 1%, 10% and then 30%, and one node sends a large message
+ *	of random bytes to the other. Prints the time taken to deliver it intact
+ *	and the goodput, with the sender's retransmission count and final window
+ *
+ *	Usage: largeMessageGoodput [length] [acknowledged 0/1]
+ *
+ */
+#include "host.h"
+#include <treacle.h>
+
+int main(int argc, char** argv)
+{
+	uint32_t length = argc > 1 ? atoi(argv[1]) : 20000;
+	bool acknowledged = argc > 2 ? atoi(argv[2]) : true;
+	const double lossRates[] = {0.01, 0.10, 0.30};
+	for(double lossRate : lossRates)
+	{
+		hostMicros = 0;
+		hostLink linkA, linkB;
+		linkA.connect(linkB);
+		linkB.connect(linkA);
+		treacleClass* a = new treacleClass;
+		treacleClass* b = new treacleClass;
+		a->setNodeName((char*)"A");
+		b->setNodeName((char*)"B");
+		a->setNodeId(1);
+		b->setNodeId(2);
+		a->enableCobs();
+		a->setCobsStream(linkA);
+		b->enableCobs();
+		b->setCobsStream(linkB);
+		a->begin();
+		b->begin();
+		a->setMaxDutyCycle(0, 100);
+		b->setMaxDutyCycle(0, 100);
+		b->setMaximumLargeMessageSize(100000);
+		std::vector<uint8_t> message(length);
+		for(uint8_t& character : message)
+		{
+			character = hostRandom();
+		}
+		std::vector<uint8_t> received(length);
+		bool queued = false, delivered = false;
+		uint32_t start = 0, end = 0;
+		while(delivered == false && millis() < 4000000)
+		{
+			hostMicros += 1000;
+			a->messageWaiting();
+			uint32_t waiting = b->messageWaiting();
+			if(waiting == length)
+			{
+				b->retrieveWaitingMessage(received.data());
+				delivered = memcmp(received.data(), message.data(), length) == 0;
+				end = millis();
+			}
+			if(waiting > 0)
+			{
+				b->clearWaitingMessage();
+			}
+			if(queued == false && a->online() && b->online() && millis() > 200000)	//Let the nodes settle before losing frames
+			{
+				linkA.lossRate = lossRate;
+				linkB.lossRate = lossRate;
+				queued = a->queueLargeMessage(message.data(), length, acknowledged);
+				start = millis();
+			}
+		}
+		if(delivered == false)
+		{
+			end = millis();
+		}
+		while(a->largeMessageInProgress() && millis() - start < 4000000)	//Let the sender finish collecting acknowledgements
+		{
+			hostMicros += 1000;
+			a->messageWaiting();
+			b->messageWaiting();
+		}
+		printf("loss %2.0f%% length %u acknowledged %u: %s in %.1fs goodput %.0fB/s retransmissions %u window %u frames %u dropped %u\n",
+			lossRate*100, length, acknowledged, delivered ? "delivered" : "FAILED", (end - start)/1000.0, delivered ? length*1000.0/(end - start) : 0,
+			a->getLargeMessageRetransmissions(0), a->getLargeMessageWindow(0), linkA.frames, linkA.dropped);
+		delete a;
+		delete b;
+	}
+}
@@ -0,0 +1,296 @@
+/*
+ *	LoRa network with hidden terminals
+ *
+ *	Nodes are scattered at random over a square and hear each other within
+ *	a fixed range, so many pairs can't hear each other. A
+ *	packet is lost at a receiver if another packet it can hear overlaps it,
+ *	or if the receiver was sending at the time. Each node's clock drifts by
+ *	up to 100ppm. After a quarter of the run has passed to let the network
+ *	settle, prints the share of packet copies lost and the mean LoRa
+ *	reliability nodes record for each other. With SNR=1 or adaptive data
+ *	rate on, packets also need the receiver on the same spreading factor
+ *	and enough SNR for it, from a simple path loss model
+ *
+ *	Usage: loRaNetwork [nodes] [slots]
+ *
+ *	Environment: SF spreading factor (7), TICK tick interval in ms,
+ *	RANGE in metres (450), SIDE of the square in metres (1000), SECS to
+ *	simulate (3600), SEED, LBT=1 for listen-before-talk, ADR=margin in dB
+ *	for adaptive data rate
+ *
+ */
+#include "host.h"
+#include <treacle.h>
+#include <cmath>
+
+struct frame
+{
+	uint8_t sender;
+	uint64_t start;
+	uint64_t end;
+	uint8_t spreadingFactor;
+	int8_t power;
+	std::vector<uint8_t> data;
+};
+
+LoRaClass LoRa;
+static uint8_t numberOfNodes;
+static std::vector<treacleClass*> nodes;
+static std::vector<std::vector<bool>> inRange;		//inRange[sender][receiver]
+static std::vector<std::vector<double>> distance;	//In metres
+static bool modelSnr;
+static std::vector<frame> air;						//Packets on the air or just finished
+static std::vector<std::deque<std::vector<uint8_t>>> inbox;	//Packets each node has received and not yet read
+static std::vector<uint64_t> sendingUntil;
+static std::vector<uint8_t> spreadingFactor;
+static std::vector<int8_t> power;
+static std::vector<float> lastSnr;
+static uint64_t transmitted, delivered, collided, halfDuplex;
+static double airtime;
+
+static double snr(uint8_t sender, uint8_t receiver, int8_t transmitPower)	//15dB at 100m and 17dBm, falling away with distance
+{
+	return 15 - 35*log10(distance[sender][receiver]/100) + (transmitPower - 17);
+}
+static double snrFloor(uint8_t sf)					//Demodulation floor, -7.5dB at SF7 and 2.5dB lower for each step up
+{
+	return -5 - 2.5*(sf - 6);
+}
+
+int LoRaClass::beginPacket(int)
+{
+	if(sendingUntil[hostCurrentNode] > hostMicros)
+	{
+		return 0;
+	}
+	transmitBuffer.clear();
+	return 1;
+}
+int LoRaClass::endPacket(bool)
+{
+	frame packet;
+	packet.sender = hostCurrentNode;
+	packet.start = hostMicros;
+	packet.end = hostMicros + nodes[hostCurrentNode]->loRaTimeOnAir(transmitBuffer.size());
+	packet.spreadingFactor = spreadingFactor[hostCurrentNode];
+	packet.power = power[hostCurrentNode];
+	packet.data = transmitBuffer;
+	air.push_back(packet);
+	sendingUntil[hostCurrentNode] = packet.end;
+	airtime += (packet.end - packet.start)/1e6;
+	transmitted++;
+	return 1;
+}
+int LoRaClass::parsePacket(int)
+{
+	if(inbox[hostCurrentNode].empty())
+	{
+		return 0;
+	}
+	receiveBuffer.assign(inbox[hostCurrentNode].front().begin(), inbox[hostCurrentNode].front().end());
+	inbox[hostCurrentNode].pop_front();
+	return receiveBuffer.size();
+}
+int LoRaClass::rssi()
+{
+	hostMicros += 100;								//Sampling takes time
+	for(frame& packet : air)
+	{
+		if(packet.sender != hostCurrentNode && inRange[packet.sender][hostCurrentNode] && packet.start <= hostMicros)
+		{
+			return -60;
+		}
+	}
+	return -120;
+}
+float LoRaClass::packetSnr()
+{
+	return lastSnr[hostCurrentNode];
+}
+void LoRaClass::setTxPower(int level, int)
+{
+	power[hostCurrentNode] = level;
+}
+void LoRaClass::setSpreadingFactor(int sf)
+{
+	spreadingFactor[hostCurrentNode] = sf;
+}
+
+static void deliverFinishedPackets()				//Hand out packets that have finished, unless they collided
+{
+	for(size_t index = 0; index < air.size();)
+	{
+		frame& packet = air[index];
+		if(packet.end > hostMicros)
+		{
+			index++;
+			continue;
+		}
+		for(uint8_t receiver = 0; receiver < numberOfNodes; receiver++)
+		{
+			if(receiver == packet.sender || inRange[packet.sender][receiver] == false)
+			{
+				continue;
+			}
+			bool lost = false;
+			for(frame& other : air)
+			{
+				if(&other != &packet && other.start < packet.end && packet.start < other.end)
+				{
+					if(other.sender == receiver)
+					{
+						halfDuplex++;
+						lost = true;
+						break;
+					}
+					if(inRange[other.sender][receiver])
+					{
+						collided++;
+						lost = true;
+						break;
+					}
+				}
+			}
+			if(lost == false && modelSnr)
+			{
+				double packetSnr = snr(packet.sender, receiver, packet.power);
+				if(spreadingFactor[receiver] != packet.spreadingFactor || packetSnr < snrFloor(packet.spreadingFactor))
+				{
+					lost = true;
+				}
+				else
+				{
+					lastSnr[receiver] = packetSnr;
+				}
+			}
+			if(lost == false)
+			{
+				inbox[receiver].push_back(packet.data);
+				delivered++;
+			}
+		}
+		air.erase(air.begin() + index);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	numberOfNodes = argc > 1 ? atoi(argv[1]) : 20;
+	uint8_t slots = argc > 2 ? atoi(argv[2]) : 0;
+	uint32_t range = hostOption("RANGE", 450);
+	uint32_t side = hostOption("SIDE", 1000);
+	uint32_t seconds = hostOption("SECS", 3600);
+	uint32_t margin = hostOption("ADR", 0);
+	modelSnr = margin > 0 || hostOption("SNR", 0);
+	std::vector<double> x(numberOfNodes), y(numberOfNodes);
+	for(uint8_t i = 0; i < numberOfNodes; i++)
+	{
+		x[i] = (hostRandom()%1000)*side/1000.0;
+		y[i] = (hostRandom()%1000)*side/1000.0;
+	}
+	inRange.assign(numberOfNodes, std::vector<bool>(numberOfNodes, false));
+	distance.assign(numberOfNodes, std::vector<double>(numberOfNodes, 1));
+	for(uint8_t i = 0; i < numberOfNodes; i++)
+	{
+		for(uint8_t j = 0; j < numberOfNodes; j++)
+		{
+			distance[i][j] = max(1.0, hypot(x[i] - x[j], y[i] - y[j]));
+			inRange[i][j] = i != j && distance[i][j] < range;
+		}
+	}
+	inbox.resize(numberOfNodes);
+	sendingUntil.resize(numberOfNodes);
+	spreadingFactor.resize(numberOfNodes);
+	power.resize(numberOfNodes);
+	lastSnr.resize(numberOfNodes);
+	nodes.resize(numberOfNodes);
+	for(uint8_t i = 0; i < numberOfNodes; i++)
+	{
+		hostSetClock(i, ((int)(hostRandom()%200) - 100)*1e-6, (hostRandom()%100000)*1000ULL);
+	}
+	for(uint8_t i = 0; i < numberOfNodes; i++)
+	{
+		hostCurrentNode = i;
+		nodes[i] = new treacleClass;
+		char* name = new char[5];
+		sprintf(name, "N%u", i);
+		nodes[i]->setNodeName(name);
+		nodes[i]->setNodeId(i + 1);
+		nodes[i]->setLoRaPins(5, 14);
+		nodes[i]->setLoRaSpreadingFactor(hostOption("SF", 7));
+		nodes[i]->setLoRaSignalBandwidth(125E3);
+		nodes[i]->enableLoRa();
+		if(slots > 0)
+		{
+			nodes[i]->enableLoRaSlots(slots);
+		}
+		if(hostOption("LBT", 0))
+		{
+			nodes[i]->enableLoRaListenBeforeTalk();
+		}
+		if(margin > 0)
+		{
+			nodes[i]->enableLoRaAdaptiveDataRate(margin);
+		}
+		nodes[i]->begin(numberOfNodes);
+		nodes[i]->setMaxDutyCycle(0, 100);
+		if(getenv("TICK") != nullptr)
+		{
+			nodes[i]->setLoRaTickInterval(hostOption("TICK", 0));
+		}
+	}
+	uint64_t warmUp = seconds*1000ULL/4;
+	uint64_t deliveredBefore = 0, collidedBefore = 0, halfDuplexBefore = 0;
+	for(uint64_t step = 0; step < seconds*1000ULL; step++)
+	{
+		hostMicros += 1000;
+		deliverFinishedPackets();
+		for(uint8_t i = 0; i < numberOfNodes; i++)
+		{
+			hostCurrentNode = i;
+			if(nodes[i]->messageWaiting() > 0)
+			{
+				nodes[i]->clearWaitingMessage();
+			}
+		}
+		if(step == warmUp)
+		{
+			deliveredBefore = delivered;
+			collidedBefore = collided;
+			halfDuplexBefore = halfDuplex;
+		}
+	}
+	double reliability = 0;
+	uint32_t links = 0, slotChanges = 0, deferrals = 0, busy = 0, fallbacks = 0;
+	for(uint8_t i = 0; i < numberOfNodes; i++)
+	{
+		hostCurrentNode = i;
+		for(uint8_t j = 0; j < numberOfNodes; j++)
+		{
+			if(inRange[j][i])
+			{
+				reliability += nodes[i]->loRaRxReliability(j + 1);
+				links++;
+			}
+		}
+		slotChanges += nodes[i]->getLoRaSlotChanges();
+		deferrals += nodes[i]->getLoRaDeferrals();
+		busy += nodes[i]->getLoRaChannelBusy();
+		fallbacks += nodes[i]->getLoRaDataRateFallbacks();
+	}
+	uint64_t received = delivered - deliveredBefore, lost = (collided - collidedBefore) + (halfDuplex - halfDuplexBefore);
+	printf("nodes %u slots %u links %u: sent %llu airtime %.0fs slot changes %u deferrals %u channel busy %u\n", numberOfNodes, slots, links,
+		(unsigned long long)transmitted, airtime, slotChanges, deferrals, busy);
+	printf("after warm up: received %llu collided %llu half duplex %llu loss %.2f%% mean reliability %.0f/65535\n",
+		(unsigned long long)received, (unsigned long long)(collided - collidedBefore), (unsigned long long)(halfDuplex - halfDuplexBefore),
+		100.0*lost/(received + lost), links ? reliability/links : 0);
+	if(margin > 0)
+	{
+		printf("spreading factor/TX power:");
+		for(uint8_t i = 0; i < numberOfNodes; i++)
+		{
+			printf(" %u/%d", spreadingFactor[i], power[i]);
+		}
+		printf(" fallbacks %u\n", fallbacks);
+	}
+}
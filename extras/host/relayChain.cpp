@@ -0,0 +1,79 @@
+/*
+ *	Multi-hop relaying along a chain of nodes
+ *
+ *	Nodes sit in a line on COBS links, each hearing the nodes up to range
+ *	places either side. Once they are online the first node sends a message
+ *	to all nodes every five seconds. Prints how many each node received and
+ *	how many relays each node sent and suppressed. A range above one gives a
+ *	denser mesh where suppression has more to do
+ *
+ *	Usage: relayChain [nodes] [range] [relaying 0/1]
+ *
+ */
+#include "host.h"
+#include <treacle.h>
+
+int main(int argc, char** argv)
+{
+	uint8_t numberOfNodes = argc > 1 ? atoi(argv[1]) : 5;
+	uint8_t range = argc > 2 ? atoi(argv[2]) : 1;
+	bool relaying = argc > 3 ? atoi(argv[3]) : true;
+	std::vector<hostLink> links(numberOfNodes);
+	std::vector<treacleClass*> nodes(numberOfNodes);
+	for(uint8_t i = 0; i < numberOfNodes; i++)
+	{
+		for(uint8_t j = 0; j < numberOfNodes; j++)
+		{
+			if(i != j && abs(i - j) <= range)
+			{
+				links[i].connect(links[j]);
+			}
+		}
+		nodes[i] = new treacleClass;
+		char* name = new char[5];
+		sprintf(name, "N%u", i);
+		nodes[i]->setNodeName(name);
+		nodes[i]->setNodeId(i + 1);
+		nodes[i]->enableCobs();
+		nodes[i]->setCobsStream(links[i]);
+		nodes[i]->begin();
+		nodes[i]->setMaxDutyCycle(0, 100);
+		if(relaying)
+		{
+			nodes[i]->enableRelaying(numberOfNodes);
+		}
+	}
+	std::vector<uint32_t> received(numberOfNodes);
+	uint32_t sent = 0;
+	uint8_t message[20] = {0xa5};
+	uint8_t buffer[20];
+	for(uint32_t step = 0; step < 1500000; step++)
+	{
+		hostMicros += 1000;
+		for(uint8_t i = 0; i < numberOfNodes; i++)
+		{
+			uint32_t waiting = nodes[i]->messageWaiting();
+			if(waiting > 0)
+			{
+				nodes[i]->retrieveWaitingMessage(buffer);
+				if(nodes[i]->messageSender() == 1 && buffer[0] == 0xa5)
+				{
+					received[i]++;
+				}
+				nodes[i]->clearWaitingMessage();
+			}
+		}
+		if(millis() > 300000 && step%5000 == 0 && nodes[0]->online())	//Let the chain settle first
+		{
+			if(nodes[0]->sendMessage(message, sizeof(message)))
+			{
+				sent++;
+			}
+		}
+	}
+	printf("nodes %u range %u relaying %u: sent %u\n", numberOfNodes, range, relaying, sent);
+	for(uint8_t i = 1; i < numberOfNodes; i++)
+	{
+		printf("N%u: received %u relayed %u suppressed %u\n", i, received[i], nodes[i]->getRelayedPackets(0), nodes[i]->getRelaysSuppressed(0));
+	}
+}
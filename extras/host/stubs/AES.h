@@ -0,0 +1,4 @@
+#ifndef AES_h
+#define AES_h
+class AES128 {};
+#endif
@@ -0,0 +1,146 @@
+/*
+ *	Just enough of the Arduino core to build treacle on a desktop machine
+ *
+ *	The functions declared here are defined in host.cpp
+ *
+ */
+#ifndef Arduino_h
+#define Arduino_h
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define PROGMEM
+#define PSTR(x) x
+#define F(x) x
+#define sprintf_P sprintf
+#define strcat_P strcat
+#define strlen_P strlen
+#define memcpy_P memcpy
+
+#define HEX 16
+#define DEC 10
+#define LOW 0
+#define HIGH 1
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define RISING 1
+#define FALLING 2
+#define CHANGE 3
+
+unsigned long millis();
+unsigned long micros();
+long random(long howBig);
+long random(long howSmall, long howBig);
+void randomSeed(unsigned long seed);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+void pinMode(uint8_t pin, uint8_t mode);
+int digitalRead(uint8_t pin);
+void digitalWrite(uint8_t pin, uint8_t value);
+inline int digitalPinToInterrupt(int pin) {return pin;}
+inline void attachInterrupt(int, void(*)(), int) {}
+inline void detachInterrupt(int) {}
+inline void noInterrupts() {}
+inline void interrupts() {}
+template<class T> T min(T a, T b) {return a < b ? a : b;}
+template<class T> T max(T a, T b) {return a > b ? a : b;}
+inline size_t strlcpy(char* destination, const char* source, size_t size)
+{
+	size_t length = strlen(source);
+	if(size > 0)
+	{
+		size_t copied = length < size - 1 ? length : size - 1;
+		memcpy(destination, source, copied);
+		destination[copied] = 0;
+	}
+	return length;
+}
+
+class String
+{
+	public:
+		String() {}
+		String(const char*) {}
+		unsigned int length() const {return 0;}
+		const char* c_str() const {return "";}
+		void toCharArray(char*, unsigned int) {}
+};
+
+class Print
+{
+	public:
+		virtual size_t write(uint8_t) = 0;
+		virtual size_t write(const uint8_t* buffer, size_t size)
+		{
+			for(size_t i = 0; i < size; i++)
+			{
+				write(buffer[i]);
+			}
+			return size;
+		}
+		size_t print(const char* text) {return write((const uint8_t*)text, strlen(text));}
+		size_t print(char character) {return write((uint8_t)character);}
+		size_t print(const String&) {return 0;}
+		size_t print(unsigned char value, int base = DEC) {return printNumber(value, base, false);}
+		size_t print(int value, int base = DEC) {return printNumber(value, base, true);}
+		size_t print(unsigned int value, int base = DEC) {return printNumber(value, base, false);}
+		size_t print(long value, int base = DEC) {return printNumber(value, base, true);}
+		size_t print(unsigned long value, int base = DEC) {return printNumber(value, base, false);}
+		size_t print(double value, int = 2)
+		{
+			char text[32];
+			snprintf(text, sizeof(text), "%.2f", value);
+			return print(text);
+		}
+		size_t println() {return print("\n");}
+		template<class T> size_t println(T value) {return print(value) + println();}
+		template<class T> size_t println(T value, int base) {return print(value, base) + println();}
+		size_t printf(const char*, ...) {return 0;}
+		size_t printf_P(const char*, ...) {return 0;}
+	private:
+		size_t printNumber(long long value, int base, bool isSigned)
+		{
+			char text[32];
+			snprintf(text, sizeof(text), base == HEX ? "%llx" : (isSigned ? "%lld" : "%llu"), value);
+			return print(text);
+		}
+};
+
+class Stream : public Print
+{
+	public:
+		virtual int available() = 0;
+		virtual int read() = 0;
+		virtual int peek() = 0;
+		size_t readBytes(uint8_t* buffer, size_t length)
+		{
+			size_t count = 0;
+			while(count < length && available() > 0)
+			{
+				buffer[count++] = read();
+			}
+			return count;
+		}
+};
+
+class HardwareSerial : public Stream	//Debug output goes to stdout
+{
+	public:
+		void begin(unsigned long) {}
+		int available() {return 0;}
+		int read() {return -1;}
+		int peek() {return -1;}
+		size_t write(uint8_t character) {putchar(character); return 1;}
+		using Print::write;
+};
+extern HardwareSerial Serial;
+#endif
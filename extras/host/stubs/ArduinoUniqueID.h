@@ -0,0 +1,5 @@
+#ifndef ArduinoUniqueID_h
+#define ArduinoUniqueID_h
+#include <stdint.h>
+extern uint8_t UniqueID8[8];
+#endif
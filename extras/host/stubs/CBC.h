@@ -0,0 +1,28 @@
+/*
+ *	Stand-in for the Crypto library's CBC mode. It XORs with the key and IV
+ *	rather than encrypting, which is enough to exercise the padding and
+ *	key handling in treacle but gives no security at all
+ *
+ */
+#ifndef CBC_h
+#define CBC_h
+#include <stdint.h>
+#include <string.h>
+template<class T> class CBC
+{
+	public:
+		bool setKey(const uint8_t* key, size_t) {memcpy(key_, key, 16); return true;}
+		bool setIV(const uint8_t* iv, size_t) {memcpy(iv_, iv, 16); return true;}
+		void encrypt(uint8_t* output, const uint8_t* input, size_t length)
+		{
+			for(size_t i = 0; i < length; i++)
+			{
+				output[i] = input[i] ^ key_[i%16] ^ iv_[i%16] ^ (uint8_t)(i/16);
+			}
+		}
+		void decrypt(uint8_t* output, const uint8_t* input, size_t length) {encrypt(output, input, length);}
+	private:
+		uint8_t key_[16] = {};
+		uint8_t iv_[16] = {};
+};
+#endif
@@ -0,0 +1 @@
+//Empty, everything treacle needs is in CRC16.h
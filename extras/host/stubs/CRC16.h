@@ -0,0 +1,29 @@
+/*
+ *	Bitwise CRC16 with the same interface as the CRC library treacle uses
+ *
+ */
+#ifndef CRC16_h
+#define CRC16_h
+#include <stdint.h>
+#include <stddef.h>
+class CRC16
+{
+	public:
+		CRC16(uint16_t polynome) : polynome_(polynome) {}
+		void add(const uint8_t* buffer, size_t length)
+		{
+			for(size_t i = 0; i < length; i++)
+			{
+				crc_ ^= (uint16_t)buffer[i] << 8;
+				for(uint8_t bit = 0; bit < 8; bit++)
+				{
+					crc_ = (crc_ & 0x8000) ? (crc_ << 1) ^ polynome_ : (crc_ << 1);
+				}
+			}
+		}
+		uint16_t calc() {return crc_;}
+	private:
+		uint16_t polynome_;
+		uint16_t crc_ = 0xffff;
+};
+#endif
@@ -0,0 +1 @@
+//Empty, the stand-in CBC.h needs nothing from here
@@ -0,0 +1,67 @@
+/*
+ *	Simulated radio with the interface of the LoRa library treacle uses
+ *
+ *	As on a real device there is one LoRa object, shared here by every node.
+ *	The harness defines the functions that touch the air and keeps each
+ *	node's radio state, looking it up by hostCurrentNode
+ *
+ */
+#ifndef LORA_H
+#define LORA_H
+#include <Arduino.h>
+#include <vector>
+#include <deque>
+
+class LoRaClass : public Stream
+{
+	public:
+		//Defined by the harness
+		int beginPacket(int implicitHeader = 0);		//Fails while this node is still sending
+		int endPacket(bool async = false);				//Puts the packet on the air
+		int parsePacket(int size = 0);					//Takes the next packet this node received
+		int rssi();										//Current channel RSSI at this node
+		float packetSnr();
+		void setTxPower(int level, int outputPin = 1);
+		void setSpreadingFactor(int spreadingFactor);
+		//Buffers for the packet being written or read
+		size_t write(uint8_t character) {transmitBuffer.push_back(character); return 1;}
+		size_t write(const uint8_t* buffer, size_t size) {transmitBuffer.insert(transmitBuffer.end(), buffer, buffer + size); return size;}
+		int available() {return receiveBuffer.size();}
+		int read()
+		{
+			if(receiveBuffer.empty())
+			{
+				return -1;
+			}
+			int character = receiveBuffer.front();
+			receiveBuffer.pop_front();
+			return character;
+		}
+		int peek() {return receiveBuffer.empty() ? -1 : receiveBuffer.front();}
+		std::vector<uint8_t> transmitBuffer;
+		std::deque<uint8_t> receiveBuffer;
+		//Settings and callbacks the simulation ignores
+		void setPins(int, int, int = 2) {}
+		int begin(long) {return 1;}
+		void setSignalBandwidth(long) {}
+		void setCodingRate4(int) {}
+		void setPreambleLength(long) {}
+		void setSyncWord(int) {}
+		void setGain(uint8_t) {}
+		void enableCrc() {}
+		void disableCrc() {}
+		void explicitHeaderMode() {}
+		void implicitHeaderMode() {}
+		void onTxDone(void(*)()) {}
+		void onReceive(void(*)(int)) {}
+		void onCadDone(void(*)(bool)) {}
+		void channelActivityDetection() {}
+		void receive(int = 0) {}
+		void idle() {}
+		void sleep() {}
+		int packetRssi() {return -80;}
+		long packetFrequencyError() {return 0;}
+		uint8_t random() {return 0;}
+};
+extern LoRaClass LoRa;
+#endif
@@ -0,0 +1 @@
+//Empty, the simulated radio in LoRa.h has no bus
@@ -9,6 +9,7 @@
 #ifndef treacle_cpp
 #define treacle_cpp
 #include "treacle.h"
+#include <new>
 
 
 treacleClass::treacleClass()	//Constructor function
@@ -165,6 +166,112 @@ float treacleClass::getMaxDutyCycle(uint8_t index)
 	}
 	return 0;
 }
+void treacleClass::setMaxDutyCycle(uint8_t index, float dutyCycle)
+{
+	if(index < numberOfActiveTransports && dutyCycle > 0 && dutyCycle <= 100)
+	{
+		transport[index].maximumDutyCycle = dutyCycle;
+		if(transport[index].airtimeTokens > airtimeTokenBucketSize(index))
+		{
+			transport[index].airtimeTokens = airtimeTokenBucketSize(index);
+		}
+	}
+}
+uint32_t treacleClass::getAirtimeBudget(uint8_t index)
+{
+	if(index < numberOfActiveTransports)
+	{
+		calculateDutyCycle(index);
+		if(dutyCycleAllowsTx(index))
+		{
+			uint32_t windowBudget = (transport[index].maximumDutyCycle - transport[index].calculatedDutyCycle) * (dutyCycleWindow/100);	//Remaining TX time in the window, in ms
+			if((uint32_t)transport[index].airtimeTokens/1000 < windowBudget)
+			{
+				return transport[index].airtimeTokens/1000;
+			}
+			return windowBudget;
+		}
+	}
+	return 0;
+}
+void treacleClass::setForwardErrorCorrection(uint8_t index, uint8_t groupSize)
+{
+	if(transport != nullptr && index < numberOfActiveTransports)
+	{
+		if(groupSize > fecMaximumGroupSize)
+		{
+			groupSize = fecMaximumGroupSize;
+		}
+		if(groupSize > 0)
+		{
+			if(transport[index].fec == nullptr)
+			{
+				transport[index].fec = new fecTransportData;
+				transport[index].fec->history = new uint8_t[fecHistorySize * ((uint8_t)headerPosition::payload + fecMaximumPayloadSize)];	//Sized for the largest group, as senders may use a larger one than this node
+				memset(transport[index].fec->history, 0, fecHistorySize * ((uint8_t)headerPosition::payload + fecMaximumPayloadSize));
+			}
+		}
+		else if(transport[index].fec != nullptr)
+		{
+			delete[] transport[index].fec->history;
+			delete transport[index].fec;
+			transport[index].fec = nullptr;
+		}
+		transport[index].fecGroupSize = groupSize;
+		resetParity(index);
+	}
+}
+uint8_t treacleClass::getForwardErrorCorrection(uint8_t index)
+{
+	if(index < numberOfActiveTransports)
+	{
+		return transport[index].fecGroupSize;
+	}
+	return 0;
+}
+uint32_t treacleClass::getRecoveredPackets(uint8_t index)
+{
+	if(index < numberOfActiveTransports && transport[index].fec != nullptr)
+	{
+		return transport[index].fec->recovered;
+	}
+	return 0;
+}
+void treacleClass::setTransportCost(uint8_t index, uint16_t cost)
+{
+	if(transport != nullptr && index < numberOfActiveTransports)
+	{
+		transport[index].fixedCost = cost;
+	}
+}
+void treacleClass::setTargetDeliveryProbability(float probability)
+{
+	if(probability > 0 && probability < 100)
+	{
+		targetDeliveryProbability = probability/100;
+	}
+}
+uint8_t treacleClass::getLastTransportSelection()
+{
+	return lastTransportSelection;
+}
+uint32_t treacleClass::getTransportCost(uint8_t index)
+{
+	if(index < numberOfActiveTransports)
+	{
+		return transport[index].selectionCost;
+	}
+	return 0;
+}
+float treacleClass::getDeliveryProbability(uint8_t id, uint8_t index)
+{
+	uint8_t nodeIndex = nodeIndexFromId(id);
+	if(nodeIndex != maximumNumberOfNodes && index < numberOfActiveTransports)
+	{
+		return deliveryProbability(nodeIndex, index) * 100;
+	}
+	return 0;
+}
 uint32_t treacleClass::nodeLastSeen(uint8_t index)
 {
 	if(index < numberOfNodes)
@@ -266,6 +373,10 @@ uint8_t  treacleClass::nodeLastPayloadNumber(uint8_t index, uint8_t transport)
 bool treacleClass::begin(uint8_t maxNodes)
 {
 	//The maximum number of nodes is used in creating a load of data structures
+	if(maxNodes > absoluteMaximumNumberOfNodes)
+	{
+		maxNodes = absoluteMaximumNumberOfNodes;	//Node bitmasks are a fixed size so this is the limit
+	}
 	maximumNumberOfNodes = maxNodes;
 	node = new nodeInfo[maximumNumberOfNodes];	//Assign at start
 	//The name is important so assign one if it is not set. This is based off MAC address on ESP8266/ESP32
@@ -358,6 +469,7 @@ bool treacleClass::begin(uint8_t maxNodes)
 	if(numberOfActiveTransports > 0)
 	{
 		transport = new transportData[numberOfActiveTransports];
+		deliveryChances = new uint8_t[numberOfActiveTransports * maximumNumberOfNodes];	//Scratch space for transport selection
 		//Initialise all the transports
 		uint8_t numberOfInitialisedTransports = 0;
 		for(uint8_t transportIndex = 0; transportIndex < numberOfActiveTransports; transportIndex++)	//Initialise every transport that is enabled
@@ -366,6 +478,11 @@ bool treacleClass::begin(uint8_t maxNodes)
 				if(transportIndex == espNowTransportId)
 				{
 					transport[transportIndex].initialised = initialiseEspNow();
+					if(transport[transportIndex].initialised)
+					{
+						espNowMacAddresses = new uint8_t[maximumNumberOfNodes * 6];	//Storage for MAC addresses
+						memset(espNowMacAddresses, 0, maximumNumberOfNodes * 6);
+					}
 				}
 			#endif
 			#if defined(TREACLE_SUPPORT_LORA)
@@ -381,6 +498,14 @@ bool treacleClass::begin(uint8_t maxNodes)
 							rssi[index] = 0;
 							snr[index] = 0;
 						}
+						if(loRaNumberOfSlots > 0)
+						{
+							allocateLoRaSlots();
+						}
+						if(loRaAdaptiveDataRate == true)
+						{
+							allocateLoRaDataRate();
+						}
 					}
 				}
 			#endif
@@ -394,6 +519,10 @@ bool treacleClass::begin(uint8_t maxNodes)
 				if(transportIndex == UDPTransportId)
 				{
 					transport[transportIndex].initialised = initialiseUDP();
+					if(transport[transportIndex].initialised && udpUnicast == true)
+					{
+						allocateUDPPeerAddresses();
+					}
 				}
 			#endif
 			#if defined(TREACLE_SUPPORT_COBS)
@@ -406,11 +535,19 @@ bool treacleClass::begin(uint8_t maxNodes)
 			{
 				numberOfInitialisedTransports++;
 			}
+			transport[transportIndex].dutyCycleSlotStart = millis();								//Start the duty cycle window now
+			transport[transportIndex].lastTokenRefill = millis();
+			transport[transportIndex].airtimeTokens = airtimeTokenBucketSize(transportIndex);		//Start with a full token bucket
 			if(encryptionKey != nullptr)
 			{
 				transport[transportIndex].encrypted = true;	//Default to encrypted if a key is set
 			}
 		}
+		if(relaying == true)
+		{
+			allocateRelaying();
+		}
+		allocateBridging();
 		#if defined(TREACLE_DEBUG)
 			debugPrint(treacleDebugString_treacleSpace);
 			debugPrint(treacleDebugString_start);
@@ -500,6 +637,33 @@ bool treacleClass::packetInQueue(uint8_t transportId)
 	}
 	return false;
 }
+bool treacleClass::sendBackingOff(uint8_t transportId)
+{
+	#if defined(TREACLE_SUPPORT_LORA)
+		if(transportId == loRaTransportId)
+		{
+			return timeToLoRaBackoffEnd() > 0;
+		}
+	#endif
+	return false;
+}
+bool treacleClass::backOffAfterBusyChannel(uint8_t transportId)
+{
+	#if defined(TREACLE_SUPPORT_LORA)
+		if(transportId == loRaTransportId && loRaChannelWasBusy == true)
+		{
+			deferLoRaSend();
+			#if defined(TREACLE_DEBUG)
+				debugPrint(treacleDebugString_treacleSpace);
+				debugPrintTransportName(transportId);
+				debugPrint(' ');
+				debugPrintln(treacleDebugString_channel_busy);
+			#endif
+			return true;
+		}
+	#endif
+	return false;
+}
 bool treacleClass::sendBuffer(uint8_t transportId, uint8_t* buffer, uint8_t packetSize)
 {
 	#if defined(TREACLE_SUPPORT_ESPNOW)
@@ -831,6 +995,13 @@ void treacleClass::setNextTickTime()
 }
 void treacleClass::setNextTickTime(uint8_t transportId)
 {
+	#if defined(TREACLE_SUPPORT_LORA)
+		if(transportId == loRaTransportId && loRaNumberOfSlots > 0)
+		{
+			transport[transportId].nextTick = nextLoRaSlotTick();								//Ticks happen in this node's slot
+			return;
+		}
+	#endif
 	transport[transportId].nextTick = transport[transportId].defaultTick - tickRandomisation(transportId);
 }
 uint16_t treacleClass::tickRandomisation(uint8_t transportId)
@@ -846,6 +1017,13 @@ void treacleClass::bringForwardNextTick()
 	#endif
 	for(uint8_t transportIndex = 0; transportIndex < numberOfActiveTransports; transportIndex++)
 	{
+		#if defined(TREACLE_SUPPORT_LORA)
+			if(transportIndex == loRaTransportId)
+			{
+				bringForwardLoRaTick();
+				continue;
+			}
+		#endif
 		if(transport[transportIndex].nextTick != 0)
 		{
 			transport[transportIndex].lastTick = millis() - (transport[transportIndex].nextTick + tickRandomisation(transportIndex));
@@ -856,8 +1034,14 @@ bool treacleClass::sendPacketOnTick()
 {
 	for(uint8_t transportId = 0; transportId < numberOfActiveTransports; transportId++)
 	{
-		if(transport[transportId].nextTick != 0 && millis() - transport[transportId].lastTick > transport[transportId].nextTick)	//nextTick = 0 implies never
+		if(timeToNextTick(transportId) == 0)																				//Tick is due
 		{
+			#if defined(TREACLE_SUPPORT_LORA)
+				if(transportId == loRaTransportId && loRaTransmitting())				//The previous packet is still on air, the tick stays due until it finishes
+				{
+					continue;
+				}
+			#endif
 			transport[transportId].lastTick = millis();									//Update the last tick time
 			calculateDutyCycle(transportId);
 			#if defined(TREACLE_DEBUG)
@@ -865,7 +1049,7 @@ bool treacleClass::sendPacketOnTick()
 				debugPrintTransportName(transportId);
 				debugPrint(' ');
 			#endif
-			if(transport[transportId].calculatedDutyCycle < transport[transportId].maximumDutyCycle)
+			if(dutyCycleAllowsTx(transportId))
 			{
 				if(packetInQueue(transportId) == false)									//Nothing ready to send from the application for _this_ transport
 				{
@@ -910,6 +1094,14 @@ bool treacleClass::sendPacketOnTick()
 				#if defined(TREACLE_DEBUG)
 					debugPrint(':');
 				#endif
+				if(dutyCycleAllowsTx(transportId, expectedTxTime(transportId, transport[transportId].transmitPacketSize)) == false)	//Now the packet is built, check it will fit in the remaining duty cycle
+				{
+					transport[transportId].dutyCycleExceptions++;
+					#if defined(TREACLE_DEBUG)
+						debugPrintln(treacleDebugString_duty_cycle_exceeded);
+					#endif
+					return false;
+				}
 				if(sendBuffer(transportId, transport[transportId].transmitBuffer, transport[transportId].transmitPacketSize))
 				{
 					#if defined(TREACLE_DEBUG)
@@ -940,6 +1132,25 @@ bool treacleClass::sendPacketOnTick()
 				}
 				else
 				{
+					#if defined(TREACLE_SUPPORT_LORA)
+						if(transportId == loRaTransportId && loRaChannelWasBusy == true)
+						{
+							if((transport[transportId].transmitBuffer[(uint8_t)headerPosition::payloadType] & 0x0f) == (uint8_t)payloadType::keepalive)
+							{
+								transport[transportId].bufferSent = true;												//Keepalives carry the network time and link data, so a fresh one is built next time
+							}
+							uint32_t backoff = deferLoRaSend();														//Packets sent between ticks wait too
+							if(backoff > transport[transportId].nextTick)
+							{
+								transport[transportId].nextTick = backoff;
+							}
+							transport[transportId].lastTick = millis() + backoff - transport[transportId].nextTick;	//Try again after the backoff, anything else stays queued
+							#if defined(TREACLE_DEBUG)
+								debugPrintln(treacleDebugString_channel_busy);
+							#endif
+							return false;
+						}
+					#endif
 					#if defined(TREACLE_DEBUG)
 						debugPrintln(treacleDebugString_failed);
 					#endif
@@ -960,23 +1171,164 @@ bool treacleClass::sendPacketOnTick()
 	}
 	return false;
 }
+uint32_t treacleClass::timeToNextTick(uint8_t transportId)
+{
+	if(transport[transportId].nextTick == 0)	//nextTick = 0 implies never
+	{
+		return maximumTickTime;
+	}
+	uint32_t sinceLastTick = millis() - transport[transportId].lastTick;
+	if(sinceLastTick > transport[transportId].nextTick)
+	{
+		return 0;
+	}
+	return transport[transportId].nextTick - sinceLastTick + 1;	//sendPacketOnTick() fires once the tick is strictly exceeded
+}
+/*
+ *
+ *	Low power support
+ *
+ */
+uint32_t treacleClass::nextMandatoryTickInMs()
+{
+	uint32_t nextTick = maximumTickTime;
+	for(uint8_t transportId = 0; transportId < numberOfActiveTransports; transportId++)
+	{
+		if(transport[transportId].initialised == true && timeToNextTick(transportId) < nextTick)
+		{
+			nextTick = timeToNextTick(transportId);
+		}
+	}
+	if(currentState == state::selectingId && millis() - lastStateChange < maximumTickTime && maximumTickTime - (millis() - lastStateChange) < nextTick)
+	{
+		nextTick = maximumTickTime - (millis() - lastStateChange);	//ID selection must also happen on time
+	}
+	return nextTick;												//Timing out other nodes is not urgent and is caught up on waking
+}
+void treacleClass::catchUp(uint32_t sleptFor)
+{
+	if(sleptFor > 0)												//millis() did not advance during sleep (eg. AVR power down), so move all the timestamps back instead
+	{
+		for(uint8_t transportId = 0; transportId < numberOfActiveTransports; transportId++)
+		{
+			transport[transportId].lastTick -= sleptFor;
+			for(uint8_t nodeIndex = 0; nodeIndex < numberOfNodes; nodeIndex++)
+			{
+				node[nodeIndex].lastTick[transportId] -= sleptFor;
+			}
+		}
+		for(uint8_t transportId = 0; transportId < numberOfActiveTransports; transportId++)
+		{
+			transport[transportId].dutyCycleSlotStart -= sleptFor;	//The duty cycle window and token bucket refill for the time asleep
+			transport[transportId].lastTokenRefill -= sleptFor;
+			if(transport[transportId].largeMessage != nullptr)
+			{
+				transport[transportId].largeMessage->startTime -= sleptFor;
+				transport[transportId].largeMessage->lastSent -= sleptFor;
+				transport[transportId].largeMessage->ackRequestTime -= sleptFor;
+				transport[transportId].largeMessage->ackTime -= sleptFor;
+			}
+			if(transport[transportId].acknowledgement != nullptr)
+			{
+				transport[transportId].acknowledgement->sentTime -= sleptFor;
+				transport[transportId].acknowledgement->time -= sleptFor;
+			}
+			if(transport[transportId].relay != nullptr)
+			{
+				transport[transportId].relay->time -= sleptFor;
+			}
+		}
+		for(uint8_t bridgeIndex = 0; bridgeIndex < numberOfBridges; bridgeIndex++)
+		{
+			bridges[bridgeIndex].startTime -= sleptFor;
+		}
+		lastStateChange -= sleptFor;
+		lastStatusMessage -= sleptFor;
+		nextRemoteTimeOut -= sleptFor;
+		largeMessageLastFragment -= sleptFor;
+		acknowledgedMessageQueueTime -= sleptFor;
+		acknowledgedMessageAttemptTime -= sleptFor;
+		#if defined(TREACLE_SUPPORT_ESPNOW)
+			espNowScanStepTime -= sleptFor;
+			espNowLastChannelCheck -= sleptFor;
+			espNowLastRx -= sleptFor;
+			if(espNowRejoinStart != 0)								//0 means not rejoining
+			{
+				espNowRejoinStart -= sleptFor;
+			}
+		#endif
+		#if defined(TREACLE_SUPPORT_LORA)
+			if(loRaDataRateSwitchTime != 0)							//0 means contact has been confirmed
+			{
+				loRaDataRateSwitchTime -= sleptFor;
+			}
+			if(loRaDataRateHoldStart != 0)							//0 means not holding
+			{
+				loRaDataRateHoldStart -= sleptFor;
+			}
+			loRaLastBeacon -= sleptFor;
+			if(loRaBeaconListenStart != 0)							//0 means the beacon hasn't been sent
+			{
+				loRaBeaconListenStart -= sleptFor;
+			}
+		#endif
+		timeSyncOffset += sleptFor;									//The network clock carried on while millis() stopped
+		timeSyncLastMeasuredOffset += sleptFor;
+		timeSyncLastSample -= sleptFor;
+		timeSyncReferenceHeard -= sleptFor;
+	}
+	if(currentState == state::uninitialised || currentState == state::starting || currentState == state::stopped)
+	{
+		return;
+	}
+	#if defined(TREACLE_SUPPORT_LORA)
+		if(loRaTransportId != 255 && transport[loRaTransportId].initialised == true)
+		{
+			receiveMissedLoRaPacket();								//A packet that woke the node may not have raised an interrupt
+			receiveLoRa();											//A LoRa packet that woke the node is queued
+		}
+	#endif
+	if(packetReceived() && receiveBufferCrcChecked == false)		//A packet woke the node
+	{
+		unpackPacket();
+	}
+	for(uint8_t transportId = 0; transportId < numberOfActiveTransports; transportId++)	//Each transport with a tick due sends once, a transport that can't send doesn't hold up the others
+	{
+		sendPacketOnTick();
+	}
+	timeOutTicks();													//Time out every node that was missed while asleep in one pass
+}
 void treacleClass::timeOutTicks()
 {
+	if(remoteTicksChanged == false && (int32_t)(millis() - nextRemoteTimeOut) < 0)	//Nothing has changed and no node is due to time out yet
+	{
+		return;
+	}
 	uint16_t totalTxReliability = 0x0000;
 	uint16_t totalRxReliability = 0x0000;
 	bool reliabilityWorsened = false;
+	uint32_t earliestTimeOut = maximumTickTime;	//Recalculated on every full pass, relative to now
 	for(uint8_t transportId = 0; transportId < numberOfActiveTransports; transportId++)
 	{
 		for(uint8_t nodeIndex = 0; nodeIndex < numberOfNodes; nodeIndex++)
 		{
-			if(millis() - node[nodeIndex].lastTick[transportId] > node[nodeIndex].nextTick[transportId] + transport[transportId].minimumTick	//Missed the next window
-				&& node[nodeIndex].rxReliability[transportId] > 0																				//Actually has some reliability to begin with
+			uint32_t sinceLastTick = millis() - node[nodeIndex].lastTick[transportId];
+			uint32_t tickWindow = node[nodeIndex].nextTick[transportId] + transport[transportId].minimumTick;
+			if(sinceLastTick > tickWindow																	//Missed the next window
+				&& node[nodeIndex].rxReliability[transportId] > 0											//Actually has some reliability to begin with
 				)
 			{
-				node[nodeIndex].rxReliability[transportId] = node[nodeIndex].rxReliability[transportId] >> 1;	//Reduce rxReliability
-				node[nodeIndex].txReliability[transportId] = node[nodeIndex].txReliability[transportId] >> 1;	//As we've not heard anything to the contrary also reduce txReliability
+				uint32_t missedWindows = sinceLastTick/(tickWindow + 1);										//More than one window may have been missed if the application was slow or asleep
+				if(missedWindows > 16)
+				{
+					missedWindows = 16;
+				}
+				node[nodeIndex].rxReliability[transportId] = node[nodeIndex].rxReliability[transportId] >> missedWindows;	//Reduce rxReliability
+				node[nodeIndex].txReliability[transportId] = node[nodeIndex].txReliability[transportId] >> missedWindows;	//As we've not heard anything to the contrary also reduce txReliability
 				node[nodeIndex].lastTick[transportId] = millis();												//Update last tick timer, even though one was missed
+				updateNodeReachability(nodeIndex, transportId);
 				reliabilityWorsened = true;
+				sinceLastTick = 0;																				//The window restarts from now
 				#if defined(TREACLE_DEBUG)
 					debugPrint(treacleDebugString_treacleSpace);
 					debugPrintTransportName(transportId);
@@ -993,10 +1345,16 @@ void treacleClass::timeOutTicks()
 					debugPrintln('%');
 				#endif
 			}
+			if(node[nodeIndex].rxReliability[transportId] > 0 && sinceLastTick <= tickWindow && tickWindow - sinceLastTick + 1 < earliestTimeOut)
+			{
+				earliestTimeOut = tickWindow - sinceLastTick + 1;											//This node will be the next to time out
+			}
 			totalTxReliability = totalTxReliability | node[nodeIndex].txReliability[transportId];		//OR all the bits of transmit reliability we have
 			totalRxReliability = totalRxReliability | node[nodeIndex].rxReliability[transportId];		//OR all the bits of receive reliability we have
 		}
 	}
+	nextRemoteTimeOut = millis() + earliestTimeOut;
+	remoteTicksChanged = false;																			//Anything changed during this pass is already accounted for
 	if((totalRxReliability == 0x0000 || totalTxReliability == 0x0000) && currentState == state::online)
 	{
 		changeCurrentState(state::offline);
@@ -1016,12 +1374,21 @@ void treacleClass::timeOutTicks()
  *	Packet packing
  *
  */
-void treacleClass::buildPacketHeader(uint8_t transportId, uint8_t recipient, payloadType type)
+void treacleClass::buildPacketHeader(uint8_t transportId, uint8_t recipient, payloadType type, bool onTick)
 {
-	setNextTickTime(transportId);																								//Set the next tick time for this packet
-	if(recipient == (uint8_t)nodeId::unknownNode)
+	uint16_t nextTick = 0;
+	if(onTick == true)
+	{
+		setNextTickTime(transportId);																							//Set the next tick time for this packet
+		if(recipient == (uint8_t)nodeId::unknownNode)
+		{
+			bringForwardNextTick();																								//Bring forward the next tick ASAP for any starting nodes
+		}
+		nextTick = transport[transportId].nextTick;
+	}
+	else
 	{
-		bringForwardNextTick();																									//Bring forward the next tick ASAP for any starting nodes
+		nextTick = timeToNextTick(transportId);																					//This is sent between ticks so give the time remaining to the next one
 	}
 	transport[transportId].transmitBuffer[(uint8_t)headerPosition::recipient] = recipient;										//Add the recipient Id
 	transport[transportId].transmitBuffer[(uint8_t)headerPosition::sender] = currentNodeId;										//Add the current nodeId
@@ -1031,8 +1398,8 @@ void treacleClass::buildPacketHeader(uint8_t transportId, uint8_t recipient, pay
 	transport[transportId].transmitBuffer[(uint8_t)headerPosition::blockIndex] = random(0,256);									//Large payload start bits 16-23, by default just randomised
 	transport[transportId].transmitBuffer[(uint8_t)headerPosition::blockIndex+1] = random(0,256);								//Large payload start bits 8-15
 	transport[transportId].transmitBuffer[(uint8_t)headerPosition::blockIndex+2] = random(0,256);								//Large payload start bits 0-7
-	transport[transportId].transmitBuffer[(uint8_t)headerPosition::nextTick] = (transport[transportId].nextTick & 0xff00) >> 8;	//nextTick bits 8-15
-	transport[transportId].transmitBuffer[(uint8_t)headerPosition::nextTick+1] = (transport[transportId].nextTick & 0x00ff);	//nextTick bits 0-7
+	transport[transportId].transmitBuffer[(uint8_t)headerPosition::nextTick] = (nextTick & 0xff00) >> 8;						//nextTick bits 8-15
+	transport[transportId].transmitBuffer[(uint8_t)headerPosition::nextTick+1] = (nextTick & 0x00ff);							//nextTick bits 0-7
 	//
 	transport[transportId].transmitPacketSize = (uint8_t)headerPosition::payload;												//Set the size to just the header
 	transport[transportId].bufferSent = false;																					//Mark as unsent for this transport
@@ -1052,6 +1419,20 @@ void treacleClass::buildKeepalivePacket(uint8_t transportId)
 			
 		}
 	}
+	#if defined(TREACLE_SUPPORT_LORA)
+		if(transportId == loRaTransportId)
+		{
+			addLoRaLinkDataToPacket();																							//Add link data, if adapting data rate
+			addLoRaSlotToPacket();																								//Add slots, if used
+		}
+	#endif
+	#if defined(TREACLE_ESPNOW_LARGE_FRAMES)
+		if(transportId == espNowTransportId && espNowLargeFrames == true && espNowTxFrame != nullptr)
+		{
+			transport[transportId].transmitBuffer[(uint8_t)headerPosition::payloadType] |= (uint8_t)payloadType::espNowLargeFrames;	//Tell other nodes this one can receive large frames
+		}
+	#endif
+	addTimeSyncToPacket(transportId);																							//Add network time, if enabled
 	transport[transportId].transmitBuffer[(uint8_t)headerPosition::packetLength] = transport[transportId].transmitPacketSize;	//Update packetLength field
 	processPacketBeforeTransmission(transportId);																				//Do CRC and encryption if needed
 }
@@ -1095,6 +1476,76 @@ void treacleClass::buildIdAndNameResolutionResponsePacket(uint8_t transportId, u
 	}
 	processPacketBeforeTransmission(transportId);																								//Do CRC and encryption if needed
 }
+void treacleClass::buildLargeMessageFragmentPacket(uint8_t transportId, uint32_t fragmentIndex, bool ackRequest)	//Fragment of a large message
+{
+	uint32_t offset = fragmentIndex * largeMessageFragmentSize;
+	uint8_t fragmentLength = largeMessageFragmentLength(largeMessageLength, fragmentIndex);
+	buildPacketHeader(transportId, (uint8_t)nodeId::allNodes, payloadType::largeApplicationData, false);						//Set payloadType, this is not sent on a tick
+	transport[transportId].transmitBuffer[(uint8_t)headerPosition::blockIndex] = (offset & 0xff0000) >> 16;						//Large payload start bits 16-23
+	transport[transportId].transmitBuffer[(uint8_t)headerPosition::blockIndex+1] = (offset & 0x00ff00) >> 8;					//Large payload start bits 8-15
+	transport[transportId].transmitBuffer[(uint8_t)headerPosition::blockIndex+2] = (offset & 0x0000ff);							//Large payload start bits 0-7
+	transport[transportId].transmitBuffer[transport[transportId].transmitPacketSize++] = largeMessageId;						//Add the message ID
+	transport[transportId].transmitBuffer[transport[transportId].transmitPacketSize++] = ackRequest ? largeMessageAckRequest : 0;	//Add the flags
+	transport[transportId].transmitBuffer[transport[transportId].transmitPacketSize++] = (largeMessageLength & 0xff0000) >> 16;	//Add the total length bits 16-23
+	transport[transportId].transmitBuffer[transport[transportId].transmitPacketSize++] = (largeMessageLength & 0x00ff00) >> 8;	//Add the total length bits 8-15
+	transport[transportId].transmitBuffer[transport[transportId].transmitPacketSize++] = (largeMessageLength & 0x0000ff);		//Add the total length bits 0-7
+	memcpy(&transport[transportId].transmitBuffer[transport[transportId].transmitPacketSize], &largeMessageData[offset], fragmentLength);	//Add the fragment
+	transport[transportId].transmitPacketSize += fragmentLength;
+	transport[transportId].transmitBuffer[(uint8_t)headerPosition::packetLength] = transport[transportId].transmitPacketSize;	//Update packetLength field
+	processPacketBeforeTransmission(transportId);																				//Do CRC and encryption if needed
+}
+bool treacleClass::buildLargeMessageAckPacket(uint8_t transportId)															//Report which fragments of a large message are missing
+{
+	uint8_t recipient = transport[transportId].largeMessage->ackRecipient;
+	uint8_t messageId = transport[transportId].largeMessage->ackId;
+	uint32_t firstMissing = transport[transportId].largeMessage->ackFragments;												//By default report the whole message as received
+	if(largeMessageReceiveBuffer != nullptr && largeMessageReceiveSender == recipient && largeMessageReceiveId == messageId)
+	{
+		firstMissing = 0;
+		while(firstMissing < transport[transportId].largeMessage->ackFragments && largeMessageFragmentReceived(firstMissing))
+		{
+			firstMissing++;
+		}
+	}
+	else if(lastLargeMessageSender != recipient || lastLargeMessageId != messageId)										//Nothing of this message is held, perhaps it was abandoned
+	{
+		return false;
+	}
+	buildPacketHeader(transportId, recipient, payloadType::largeApplicationDataAck, false);									//Set recipient and payloadType, this is not sent on a tick
+	transport[transportId].transmitBuffer[transport[transportId].transmitPacketSize++] = messageId;							//Add the message ID
+	transport[transportId].transmitBuffer[transport[transportId].transmitPacketSize++] = (firstMissing & 0xff0000) >> 16;		//Add the first missing fragment bits 16-23
+	transport[transportId].transmitBuffer[transport[transportId].transmitPacketSize++] = (firstMissing & 0x00ff00) >> 8;		//Add the first missing fragment bits 8-15
+	transport[transportId].transmitBuffer[transport[transportId].transmitPacketSize++] = (firstMissing & 0x0000ff);			//Add the first missing fragment bits 0-7
+	for(uint8_t bitmapByte = 0; bitmapByte < largeMessageMaximumAckBitmap &&
+		firstMissing + bitmapByte*8 < transport[transportId].largeMessage->ackFragments; bitmapByte++)						//Add a bitmap of the fragments received after it
+	{
+		uint8_t bitmap = 0;
+		for(uint8_t bit = 0; bit < 8; bit++)
+		{
+			uint32_t fragmentIndex = firstMissing + bitmapByte*8 + bit;
+			if(fragmentIndex < transport[transportId].largeMessage->ackFragments && largeMessageFragmentReceived(fragmentIndex))
+			{
+				bitmap |= (0x01 << bit);
+			}
+		}
+		transport[transportId].transmitBuffer[transport[transportId].transmitPacketSize++] = bitmap;
+	}
+	transport[transportId].transmitBuffer[(uint8_t)headerPosition::packetLength] = transport[transportId].transmitPacketSize;	//Update packetLength field
+	processPacketBeforeTransmission(transportId);																				//Do CRC and encryption if needed
+	return true;
+}
+void treacleClass::buildParityPacket(uint8_t transportId)																		//Parity of the last few application packets
+{
+	buildPacketHeader(transportId, (uint8_t)nodeId::allNodes, payloadType::applicationDataParity, false);						//Set payloadType, this is not sent on a tick
+	transport[transportId].transmitBuffer[transport[transportId].transmitPacketSize++] = transport[transportId].fec->groupCount;	//Add the group size
+	memcpy(&transport[transportId].transmitBuffer[transport[transportId].transmitPacketSize], transport[transportId].fec->groupPayloadNumbers, transport[transportId].fec->groupCount);	//Add the payload numbers in the group
+	transport[transportId].transmitPacketSize += transport[transportId].fec->groupCount;
+	transport[transportId].transmitBuffer[transport[transportId].transmitPacketSize++] = transport[transportId].fec->lengthParity;	//Add the length parity
+	memcpy(&transport[transportId].transmitBuffer[transport[transportId].transmitPacketSize], transport[transportId].fec->parity, transport[transportId].fec->parityLength);	//Add the payload parity
+	transport[transportId].transmitPacketSize += transport[transportId].fec->parityLength;
+	transport[transportId].transmitBuffer[(uint8_t)headerPosition::packetLength] = transport[transportId].transmitPacketSize;	//Update packetLength field
+	processPacketBeforeTransmission(transportId);																				//Do CRC and encryption if needed
+}
 /*
  *
  *	Packet unpacking
@@ -1121,6 +1572,8 @@ void treacleClass::unpackPacket()
 				debugPrintPayloadTypeDescription((uint8_t)receiveBuffer[(uint8_t)headerPosition::payloadType]);
 				debugPrint(' ');
 			#endif
+			bool bridged = unpackBridgeMarker();							//Forwarded by a bridge, so it says nothing about the link to the sender
+			stagePacketForBridging();										//Keep a copy as it arrived, in case it is forwarded
 			if(receiveBuffer[(uint8_t)headerPosition::payloadType] & (uint8_t)payloadType::encrypted)	//Check for encrypted packet
 			{
 				decryptPayload(receiveBuffer, receiveBufferSize);			//Decrypt payload after the header, note this is not shown as valid until the CRC is checked
@@ -1135,6 +1588,15 @@ void treacleClass::unpackPacket()
 					debugPrint(':');
 					debugPrint(senderId);
 				#endif
+				if(senderId == currentNodeId && currentNodeId != (uint8_t)nodeId::unknownNode)		//This node's own packet, forwarded back by a bridge
+				{
+					#if defined(TREACLE_DEBUG)
+						debugPrint(' ');
+						debugPrintln(treacleDebugString_this_node);
+					#endif
+					clearReceiveBuffer();
+					return;
+				}
 				if(senderId != (uint8_t)nodeId::unknownNode && receiveBuffer[(uint8_t)headerPosition::sender] != (uint8_t)nodeId::allNodes)	//Only handle valid node IDs
 				{
 					if(nodeExists(receiveBuffer[(uint8_t)headerPosition::sender]) == false)		//Check if it doesn't exist
@@ -1159,24 +1621,49 @@ void treacleClass::unpackPacket()
 					#endif
 					uint8_t nodeIndex = nodeIndexFromId(receiveBuffer[(uint8_t)headerPosition::sender]);								//Turn node ID into nodeIndex
 					#if defined(TREACLE_SUPPORT_LORA)
-						if(receiveTransport == loRaTransportId)
+						if(receiveTransport == loRaTransportId && bridged == false)
 						{
 							rssi[nodeIndex] = lastLoRaRssi;																					//Record RSSI if it's a LoRa packet
 							snr[nodeIndex] = lastLoRaSNR;																					//Record SNR if it's a LoRa packet
 						}
 					#endif
+					#if defined(TREACLE_SUPPORT_ESPNOW)
+						if(receiveTransport == espNowTransportId && bridged == false)
+						{
+							espNowPacketReceived(nodeIndex);																			//Contact with other nodes on this channel
+						}
+						if(receiveTransport == espNowTransportId && bridged == false && espNowMacAddresses != nullptr &&
+							memcmp(&espNowMacAddresses[nodeIndex * 6], lastEspNowMacAddress, 6) != 0)
+						{
+							if(espNowPeerIndex(nodeIndex) != numberOfEspNowPeers)
+							{
+								removeEspNowPeer(espNowPeerIndex(nodeIndex));																	//The node has a new MAC address, so the old peer is no use
+							}
+							memcpy(&espNowMacAddresses[nodeIndex * 6], lastEspNowMacAddress, 6);									//Record the MAC address so packets for this node can be unicast
+						}
+					#endif
+					#if defined(TREACLE_SUPPORT_UDP)
+						if(receiveTransport == UDPTransportId && bridged == false && udpPeerAddresses != nullptr)
+						{
+							udpPeerAddresses[nodeIndex] = lastUDPAddress;																	//Record the IP address so packets for this node can be unicast
+						}
+					#endif
 					#if defined(TREACLE_DEBUG)
 						debugPrintString(node[nodeIndex].name);
 					#endif
-					if(receiveBuffer[(uint8_t)headerPosition::payloadNumber] == node[nodeIndex].lastPayloadNumber[receiveTransport])	//Check for duplicate packets
+					if(bridged == false)																			//Payload numbers of bridged packets come from another transport, so they are only checked against the bridge history
 					{
-						#if defined(TREACLE_DEBUG)
-							debugPrintln(treacleDebugString_duplicate);
-						#endif
-						clearReceiveBuffer();
-						return;
+						if(receiveBuffer[(uint8_t)headerPosition::payloadNumber] == node[nodeIndex].lastPayloadNumber[receiveTransport])	//Check for duplicate packets
+						{
+							#if defined(TREACLE_DEBUG)
+								debugPrintln(treacleDebugString_duplicate);
+							#endif
+							clearReceiveBuffer();
+							return;
+						}
+						node[nodeIndex].lastPayloadNumber[receiveTransport] = receiveBuffer[(uint8_t)headerPosition::payloadNumber];
+						recordPayloadNumber(nodeIndex, receiveTransport, receiveBuffer[(uint8_t)headerPosition::payloadNumber]);
 					}
-					node[nodeIndex].lastPayloadNumber[receiveTransport] = receiveBuffer[(uint8_t)headerPosition::payloadNumber];
 					#if defined(TREACLE_DEBUG)
 						debugPrint(treacleDebugString_payload_numberColon);
 						debugPrint(node[nodeIndex].lastPayloadNumber[receiveTransport]);
@@ -1192,13 +1679,52 @@ void treacleClass::unpackPacket()
 						#endif
 					}
 					//node[nodeIndex].lastSeen = millis();	//Overall last seen
-					node[nodeIndex].rxReliability[receiveTransport] = (node[nodeIndex].rxReliability[receiveTransport] >> 1) | 0x8000;	//Potentially improve rxReliability
-					node[nodeIndex].lastTick[receiveTransport] = millis();															//Update last tick time
-					node[nodeIndex].nextTick[receiveTransport] = ((uint16_t)receiveBuffer[(uint8_t)headerPosition::nextTick])<<8;	//Update next tick time MSB
-					node[nodeIndex].nextTick[receiveTransport] += ((uint16_t)receiveBuffer[1+(uint8_t)headerPosition::nextTick]);	//Update next tick time LSB
-					#if defined(TREACLE_DEBUG)
-						debugPrint(' ');
-					#endif
+					#if defined(TREACLE_SUPPORT_LORA)
+						if(receiveTransport == loRaTransportId && bridged == false)
+						{
+							checkLoRaBeaconReply(nodeIndex);																		//Before this packet counts towards rxReliability
+						}
+					#endif
+					if(bridged == false)																			//A bridged packet is sent on the bridge's schedule, not the sender's
+					{
+						node[nodeIndex].rxReliability[receiveTransport] = (node[nodeIndex].rxReliability[receiveTransport] >> 1) | 0x8000;	//Potentially improve rxReliability
+						updateNodeReachability(nodeIndex, receiveTransport);
+						node[nodeIndex].lastTick[receiveTransport] = millis();															//Update last tick time
+						node[nodeIndex].nextTick[receiveTransport] = ((uint16_t)receiveBuffer[(uint8_t)headerPosition::nextTick])<<8;	//Update next tick time MSB
+						node[nodeIndex].nextTick[receiveTransport] += ((uint16_t)receiveBuffer[1+(uint8_t)headerPosition::nextTick]);	//Update next tick time LSB
+					}
+					if(bridgePacket(bridged) == true)																//Forward it on to other transports, if needed
+					{
+						#if defined(TREACLE_DEBUG)
+							debugPrint(' ');
+							debugPrint(treacleDebugString_bridged);
+							debugPrint(' ');
+							debugPrintln(treacleDebugString_duplicate);
+						#endif
+						clearReceiveBuffer();																		//It has already arrived by another path, or come back round a loop of bridges
+						return;
+					}
+					#if defined(TREACLE_DEBUG)
+						debugPrint(' ');
+					#endif
+					if(receiveBuffer[(uint8_t)headerPosition::payloadType] & (uint8_t)payloadType::timeSync)
+					{
+						unpackTimeSync(nodeIndex);																					//Sample and remove the network time
+					}
+					#if defined(TREACLE_SUPPORT_ESPNOW)
+						if(receiveTransport == espNowTransportId)
+						{
+							unpackEspNowFlags(nodeIndex);																				//Large frame support uses the same flag as LoRa slots
+						}
+					#endif
+					if(receiveBuffer[(uint8_t)headerPosition::payloadType] & (uint8_t)payloadType::loRaSlots)
+					{
+						unpackLoRaSlots(nodeIndex);																					//Record and remove the slots
+					}
+					if(receiveBuffer[(uint8_t)headerPosition::payloadType] & (uint8_t)payloadType::loRaLinkData)
+					{
+						unpackLoRaLinkData(nodeIndex);																				//Record and remove the link data
+					}
 					if(receiveBuffer[(uint8_t)headerPosition::payloadType] == (uint8_t)payloadType::keepalive)
 					{
 						if(currentState != state::selectingId)
@@ -1227,7 +1753,41 @@ void treacleClass::unpackPacket()
 						#if defined(TREACLE_DEBUG)
 							debugPrintln();
 						#endif
-						//Nothing needed, the application will pick this up
+						if(receiveBuffer[(uint8_t)headerPosition::recipient] == (uint8_t)nodeId::allNodes && bridged == false)	//Parity only covers packets sent on this transport
+						{
+							storePacketForParity(receiveTransport);	//The application will pick this up, but keep a copy in case it's needed to recover a lost packet
+						}
+					}
+					else if(receiveBuffer[(uint8_t)headerPosition::payloadType] == (uint8_t)payloadType::relayableApplicationData)
+					{
+						unpackRelayablePacket(receiveTransport);		//The application will pick this up unless it's a copy
+					}
+					else if(receiveBuffer[(uint8_t)headerPosition::payloadType] == (uint8_t)payloadType::acknowledgedApplicationData)
+					{
+						unpackAcknowledgedMessagePacket(receiveTransport, senderId);	//The application will pick this up unless it's a retransmission
+					}
+					else if(receiveBuffer[(uint8_t)headerPosition::payloadType] == (uint8_t)payloadType::acknowledgedApplicationDataAck)
+					{
+						unpackAcknowledgementPacket(receiveTransport, senderId);
+						clearReceiveBuffer();
+					}
+					else if(receiveBuffer[(uint8_t)headerPosition::payloadType] == (uint8_t)payloadType::applicationDataParity)
+					{
+						unpackParityPacket(receiveTransport, senderId);
+						if(applicationDataPacketReceived() == false)
+						{
+							clearReceiveBuffer();				//Leave any recovered packet for the application to pick up
+						}
+					}
+					else if(receiveBuffer[(uint8_t)headerPosition::payloadType] == (uint8_t)payloadType::largeApplicationData)
+					{
+						unpackLargeMessageFragment(receiveTransport, senderId);	//Fragments are copied into the reassembly buffer, the application picks up the whole message
+						clearReceiveBuffer();
+					}
+					else if(receiveBuffer[(uint8_t)headerPosition::payloadType] == (uint8_t)payloadType::largeApplicationDataAck)
+					{
+						unpackLargeMessageAckPacket(receiveTransport, senderId);
+						clearReceiveBuffer();
 					}
 					else
 					{
@@ -1301,6 +1861,7 @@ void treacleClass::unpackKeepalivePacket(uint8_t transportId, uint8_t senderId)
 			{
 				uint8_t senderIndex = nodeIndexFromId(receiveBuffer[(uint8_t)headerPosition::sender]);
 				node[senderIndex].txReliability[transportId] = receivedTxReliabilityMetric;
+				updateNodeReachability(senderIndex, transportId);
 				#if defined(TREACLE_DEBUG)
 					debugPrint(' ');
 					debugPrint(treacleDebugString_this_node);
@@ -1526,6 +2087,291 @@ void treacleClass::unpackIdAndNameResolutionResponsePacket(uint8_t transportId,
 		}
 	}
 }
+void treacleClass::unpackLargeMessageFragment(uint8_t transportId, uint8_t senderId)
+{
+	uint8_t payloadLength = receiveBuffer[(uint8_t)headerPosition::packetLength] - (uint8_t)headerPosition::payload;
+	if(maximumLargeMessageSize == 0 || payloadLength <= largeMessageFragmentHeaderSize)								//Large messages are not wanted, or this can't be one
+	{
+		#if defined(TREACLE_DEBUG)
+			debugPrintln(treacleDebugString_dropped);
+		#endif
+		return;
+	}
+	uint8_t* fragment = &receiveBuffer[(uint8_t)headerPosition::payload];
+	uint8_t messageId = fragment[0];
+	bool ackRequest = fragment[1] & largeMessageAckRequest;
+	uint32_t totalLength = ((uint32_t)fragment[2])<<16 | ((uint32_t)fragment[3])<<8 | (uint32_t)fragment[4];
+	uint32_t offset = ((uint32_t)receiveBuffer[(uint8_t)headerPosition::blockIndex])<<16 |
+		((uint32_t)receiveBuffer[(uint8_t)headerPosition::blockIndex+1])<<8 |
+		(uint32_t)receiveBuffer[(uint8_t)headerPosition::blockIndex+2];
+	uint8_t fragmentLength = payloadLength - largeMessageFragmentHeaderSize;
+	#if defined(TREACLE_DEBUG)
+		debugPrint(offset);
+		debugPrint('/');
+		debugPrint(totalLength);
+		debugPrint(' ');
+	#endif
+	if(totalLength > maximumLargeMessageSize ||														//Too big to reassemble
+		offset % largeMessageFragmentSize != 0 ||													//Fragments always start on a boundary
+		offset + fragmentLength > totalLength ||													//Fragment runs past the end
+		(fragmentLength != largeMessageFragmentSize && offset + fragmentLength != totalLength))		//Only the last fragment can be short
+	{
+		#if defined(TREACLE_DEBUG)
+			debugPrintln(treacleDebugString_dropped);
+		#endif
+		return;
+	}
+	if(largeMessageReceiveBuffer != nullptr && (senderId != largeMessageReceiveSender || messageId != largeMessageReceiveId))	//Fragment of a different message
+	{
+		if(largeMessageComplete == true || millis() - largeMessageLastFragment < maximumTickTime)	//Keep the current message until it is collected, unless it has stalled
+		{
+			#if defined(TREACLE_DEBUG)
+				debugPrintln(treacleDebugString_dropped);
+			#endif
+			return;
+		}
+		#if defined(TREACLE_DEBUG)
+			debugPrint(treacleDebugString_abandoned);
+			debugPrint(' ');
+		#endif
+		clearLargeMessage();
+	}
+	if(largeMessageReceiveBuffer == nullptr)
+	{
+		if(senderId == lastLargeMessageSender && messageId == lastLargeMessageId)					//Copy of the last message over another transport, or a retransmission
+		{
+			#if defined(TREACLE_DEBUG)
+				debugPrintln(treacleDebugString_duplicate);
+			#endif
+			if(ackRequest == true)
+			{
+				scheduleLargeMessageAck(transportId, senderId, messageId, largeMessageFragments(totalLength));	//The sender still needs to know it arrived
+			}
+			return;
+		}
+		largeMessageReceiveBuffer = new (std::nothrow) uint8_t[totalLength];	//The length comes from the sender, so allow for it not fitting in memory
+		largeMessageFragmentsReceived = new (std::nothrow) uint8_t[(largeMessageFragments(totalLength) + 7)/8];
+		if(largeMessageReceiveBuffer == nullptr || largeMessageFragmentsReceived == nullptr)
+		{
+			clearLargeMessage();
+			#if defined(TREACLE_DEBUG)
+				debugPrintln(treacleDebugString_failed);
+			#endif
+			return;
+		}
+		memset(largeMessageFragmentsReceived, 0, (largeMessageFragments(totalLength) + 7)/8);
+		largeMessageReceiveLength = totalLength;
+		largeMessageFragmentsRemaining = largeMessageFragments(totalLength);
+		largeMessageReceiveSender = senderId;
+		largeMessageReceiveId = messageId;
+		largeMessageComplete = false;
+	}
+	uint32_t fragmentIndex = offset / largeMessageFragmentSize;
+	if(largeMessageFragmentReceived(fragmentIndex) == false)											//Fragments can arrive in any order, or more than once
+	{
+		memcpy(&largeMessageReceiveBuffer[offset], &fragment[largeMessageFragmentHeaderSize], fragmentLength);
+		largeMessageFragmentsReceived[fragmentIndex/8] |= (0x01 << (fragmentIndex%8));
+		largeMessageFragmentsRemaining--;
+	}
+	largeMessageLastFragment = millis();
+	if(largeMessageFragmentsRemaining == 0 && largeMessageComplete == false)
+	{
+		largeMessageComplete = true;
+		lastLargeMessageSender = senderId;
+		lastLargeMessageId = messageId;
+		#if defined(TREACLE_DEBUG)
+			debugPrint(treacleDebugString_complete);
+		#endif
+	}
+	#if defined(TREACLE_DEBUG)
+		debugPrintln();
+	#endif
+	if(ackRequest == true)
+	{
+		scheduleLargeMessageAck(transportId, senderId, messageId, largeMessageFragments(totalLength));
+	}
+}
+void treacleClass::scheduleLargeMessageAck(uint8_t transportId, uint8_t recipient, uint8_t messageId, uint32_t fragments)
+{
+	if(transport[transportId].largeMessage == nullptr)
+	{
+		transport[transportId].largeMessage = new largeMessageTransportData;
+	}
+	transport[transportId].largeMessage->ackDue = true;
+	transport[transportId].largeMessage->ackTime = millis() + random(0, transport[transportId].minimumTick/4);	//Spread replies from different receivers
+	transport[transportId].largeMessage->ackRecipient = recipient;
+	transport[transportId].largeMessage->ackId = messageId;
+	transport[transportId].largeMessage->ackFragments = fragments;
+}
+void treacleClass::unpackLargeMessageAckPacket(uint8_t transportId, uint8_t senderId)
+{
+	uint8_t payloadLength = receiveBuffer[(uint8_t)headerPosition::packetLength] - (uint8_t)headerPosition::payload;
+	uint8_t* ack = &receiveBuffer[(uint8_t)headerPosition::payload];
+	uint8_t nodeIndex = nodeIndexFromId(senderId);
+	if(receiveBuffer[(uint8_t)headerPosition::recipient] != currentNodeId || payloadLength < 4 || nodeIndex == maximumNumberOfNodes ||
+		largeMessageData == nullptr || ack[0] != largeMessageId || transport[transportId].largeMessage == nullptr || transport[transportId].largeMessage->sending == false)	//Not an acknowledgement of what is being sent
+	{
+		#if defined(TREACLE_DEBUG)
+			debugPrintln(treacleDebugString_dropped);
+		#endif
+		return;
+	}
+	uint32_t firstMissing = ((uint32_t)ack[1])<<16 | ((uint32_t)ack[2])<<8 | (uint32_t)ack[3];
+	uint32_t fragments = largeMessageFragments(largeMessageLength);
+	transport[transportId].largeMessage->receivers[nodeIndex/32] |= (0x00000001 << (nodeIndex%32));	//It may not have been reachable when the message started
+	transport[transportId].largeMessage->responded[nodeIndex/32] |= (0x00000001 << (nodeIndex%32));
+	if(firstMissing >= fragments)
+	{
+		transport[transportId].largeMessage->delivered[nodeIndex/32] |= (0x00000001 << (nodeIndex%32));
+		#if defined(TREACLE_DEBUG)
+			debugPrintln(treacleDebugString_complete);
+		#endif
+		return;
+	}
+	if(transport[transportId].largeMessage->awaitingAck == false)	//A late reply to an earlier request, which can't know about fragments sent since
+	{
+		#if defined(TREACLE_DEBUG)
+			debugPrintln(treacleDebugString_duplicate);
+		#endif
+		return;
+	}
+	uint32_t missing = 0;
+	for(uint32_t fragmentIndex = firstMissing; fragmentIndex < transport[transportId].largeMessage->highestSent &&
+		fragmentIndex - firstMissing < (uint32_t)(payloadLength - 4) * 8; fragmentIndex++)				//Only fragments already sent can be missing, the rest are still to come
+	{
+		uint32_t bit = fragmentIndex - firstMissing;
+		if((ack[4 + bit/8] & (0x01 << (bit%8))) == 0 &&
+			(transport[transportId].largeMessage->pending[fragmentIndex/8] & (0x01 << (fragmentIndex%8))) == 0)	//Not received and not already due to be sent again
+		{
+			transport[transportId].largeMessage->pending[fragmentIndex/8] |= (0x01 << (fragmentIndex%8));
+			transport[transportId].largeMessage->fragmentsPending++;
+			transport[transportId].largeMessage->retransmissions++;
+			missing++;
+		}
+	}
+	if(missing > 0)
+	{
+		transport[transportId].largeMessage->lossInWindow = true;
+	}
+	#if defined(TREACLE_DEBUG)
+		debugPrint(missing);
+		debugPrint(' ');
+		debugPrintln(treacleDebugString_missing);
+	#endif
+}
+void treacleClass::storePacketForParity(uint8_t transportId)
+{
+	if(transport[transportId].fec != nullptr &&
+		receiveBuffer[(uint8_t)headerPosition::packetLength] - (uint8_t)headerPosition::payload <= fecMaximumPayloadSize)	//Longer packets are never protected
+	{
+		memcpy(&transport[transportId].fec->history[transport[transportId].fec->historyIndex * ((uint8_t)headerPosition::payload + fecMaximumPayloadSize)],
+			receiveBuffer, receiveBuffer[(uint8_t)headerPosition::packetLength]);
+		transport[transportId].fec->historyIndex = (transport[transportId].fec->historyIndex + 1) % fecHistorySize;
+	}
+}
+void treacleClass::recordPayloadNumber(uint8_t nodeIndex, uint8_t transportId, uint8_t payloadNumber)
+{
+	uint8_t gap = payloadNumber - node[nodeIndex].newestPayloadNumber[transportId];	//Unsigned maths copes with payload numbers rolling over
+	if(gap < 32)																	//Newer than the newest one, or the same
+	{
+		node[nodeIndex].recentPayloadNumbers[transportId] = (node[nodeIndex].recentPayloadNumbers[transportId] << gap) | 0x00000001UL;
+		node[nodeIndex].newestPayloadNumber[transportId] = payloadNumber;
+	}
+	else if((uint8_t)(0 - gap) < 32)												//A little older than the newest one, eg. a recovered packet
+	{
+		node[nodeIndex].recentPayloadNumbers[transportId] |= 0x00000001UL << (uint8_t)(0 - gap);
+	}
+	else																			//A big jump, eg. the node restarted, so nothing is known about earlier packets
+	{
+		node[nodeIndex].recentPayloadNumbers[transportId] = 0x00000001UL;
+		node[nodeIndex].newestPayloadNumber[transportId] = payloadNumber;
+	}
+}
+bool treacleClass::payloadNumberMissed(uint8_t nodeIndex, uint8_t transportId, uint8_t payloadNumber)
+{
+	uint8_t age = node[nodeIndex].newestPayloadNumber[transportId] - payloadNumber;
+	if(age < 32)
+	{
+		return (node[nodeIndex].recentPayloadNumbers[transportId] & (0x00000001UL << age)) == 0;
+	}
+	return false;																	//Too old to know, so assume it was received
+}
+void treacleClass::unpackParityPacket(uint8_t transportId, uint8_t senderId)
+{
+	uint8_t payloadLength = receiveBuffer[(uint8_t)headerPosition::packetLength] - (uint8_t)headerPosition::payload;
+	uint8_t* parity = &receiveBuffer[(uint8_t)headerPosition::payload];
+	uint8_t groupSize = parity[0];
+	uint8_t nodeIndex = nodeIndexFromId(senderId);
+	if(transport[transportId].fec == nullptr || nodeIndex == maximumNumberOfNodes || groupSize == 0 || groupSize > fecMaximumGroupSize ||
+		payloadLength < groupSize + 2 || payloadLength - groupSize - 2 > fecMaximumPayloadSize)	//Not enabled on this transport, or not valid
+	{
+		#if defined(TREACLE_DEBUG)
+			debugPrintln(treacleDebugString_dropped);
+		#endif
+		return;
+	}
+	uint8_t parityLength = payloadLength - groupSize - 2;
+	uint8_t recoveredLength = parity[groupSize + 1];
+	uint8_t recoveredPayload[fecMaximumPayloadSize];
+	memcpy(recoveredPayload, &parity[groupSize + 2], parityLength);
+	uint8_t missing = 0;															//Packets in the group that aren't in the history
+	uint8_t lost = 0;																//Packets in the group that are known not to have been received
+	uint8_t missingPayloadNumber = 0;
+	for(uint8_t groupIndex = 0; groupIndex < groupSize; groupIndex++)
+	{
+		bool found = false;
+		for(uint8_t slot = 0; slot < fecHistorySize && found == false; slot++)
+		{
+			uint8_t* packet = &transport[transportId].fec->history[slot * ((uint8_t)headerPosition::payload + fecMaximumPayloadSize)];
+			if(packet[(uint8_t)headerPosition::packetLength] != 0 &&
+				packet[(uint8_t)headerPosition::sender] == senderId &&
+				packet[(uint8_t)headerPosition::payloadNumber] == parity[1 + groupIndex])
+			{
+				uint8_t packetPayloadLength = packet[(uint8_t)headerPosition::packetLength] - (uint8_t)headerPosition::payload;
+				for(uint8_t index = 0; index < packetPayloadLength && index < parityLength; index++)
+				{
+					recoveredPayload[index] ^= packet[(uint8_t)headerPosition::payload + index];	//Remove this packet from the parity
+				}
+				recoveredLength ^= packetPayloadLength;
+				found = true;
+			}
+		}
+		if(found == false)
+		{
+			missing++;
+			if(payloadNumberMissed(nodeIndex, transportId, parity[1 + groupIndex]))
+			{
+				lost++;
+				missingPayloadNumber = parity[1 + groupIndex];
+			}
+		}
+	}
+	#if defined(TREACLE_DEBUG)
+		debugPrint(missing);
+		debugPrint(' ');
+		debugPrint(treacleDebugString_missing);
+	#endif
+	if(missing == 1 && lost == 1 && recoveredLength <= parityLength)		//Exactly one packet can be recovered and it wasn't delivered, rather than pushed out of the history
+	{
+		receiveBuffer[(uint8_t)headerPosition::recipient] = (uint8_t)nodeId::allNodes;				//Rebuild the lost packet in the receive buffer for the application
+		receiveBuffer[(uint8_t)headerPosition::payloadType] = (uint8_t)payloadType::shortApplicationData;
+		receiveBuffer[(uint8_t)headerPosition::payloadNumber] = missingPayloadNumber;
+		receiveBuffer[(uint8_t)headerPosition::packetLength] = (uint8_t)headerPosition::payload + recoveredLength;
+		memcpy(&receiveBuffer[(uint8_t)headerPosition::payload], recoveredPayload, recoveredLength);
+		receiveBufferSize = (uint8_t)headerPosition::payload + recoveredLength;
+		storePacketForParity(transportId);
+		recordPayloadNumber(nodeIndex, transportId, missingPayloadNumber);
+		transport[transportId].fec->recovered++;
+		#if defined(TREACLE_DEBUG)
+			debugPrint(',');
+			debugPrint(' ');
+			debugPrint(treacleDebugString_recovered);
+		#endif
+	}
+	#if defined(TREACLE_DEBUG)
+		debugPrintln();
+	#endif
+}
 /*
  *
  *	Node management
@@ -1577,6 +2423,8 @@ bool treacleClass::addNode(uint8_t id, uint16_t reliability)
 		node[numberOfNodes].rxReliability = new uint16_t[numberOfActiveTransports];		//This is per transport
 		node[numberOfNodes].txReliability = new uint16_t[numberOfActiveTransports];		//This is per transport
 		node[numberOfNodes].lastPayloadNumber = new uint8_t[numberOfActiveTransports];	//This is per transport
+		node[numberOfNodes].newestPayloadNumber = new uint8_t[numberOfActiveTransports];	//This is per transport
+		node[numberOfNodes].recentPayloadNumbers = new uint32_t[numberOfActiveTransports];	//This is per transport
 		for(uint8_t transportIndex = 0; transportIndex < numberOfActiveTransports; transportIndex++)
 		{
 			node[numberOfNodes].lastTick[transportIndex] = millis();					//Count the addition of the node as a 'tick'
@@ -1584,6 +2432,9 @@ bool treacleClass::addNode(uint8_t id, uint16_t reliability)
 			node[numberOfNodes].rxReliability[transportIndex] = reliability;
 			node[numberOfNodes].txReliability[transportIndex] = reliability;
 			node[numberOfNodes].lastPayloadNumber[transportIndex] = 0;					//Cannot make any assumptions about payload number
+			node[numberOfNodes].newestPayloadNumber[transportIndex] = 0;
+			node[numberOfNodes].recentPayloadNumbers[transportIndex] = 0;
+			updateNodeReachability(numberOfNodes, transportIndex);
 		}
 		numberOfNodes++;
 		numberOfNodesChanged = true;													//Inform the application
@@ -1598,93 +2449,334 @@ bool treacleClass::addNode(uint8_t id, uint16_t reliability)
  */
 void treacleClass::calculateDutyCycle(uint8_t transportId)
 {
-	transport[transportId].calculatedDutyCycle = ((float)transport[transportId].txTime/(float)millis())/10.0;	//txTime is in micros so divided by 1000 to get percentage
-}
-/*
-void treacleClass::calculateDutyCycle()
-{
-	for(uint8_t transportIndex = 0; transportIndex < numberOfActiveTransports; transportIndex++)	//This does not cope with counter rollover!
+	const uint32_t slotLength = dutyCycleWindow/dutyCycleSlots;
+	#if defined(ESP32)
+		portENTER_CRITICAL(&txTimeLock);
+	#else
+		noInterrupts();
+	#endif
+	uint32_t pendingTxTime = transport[transportId].pendingTxTime;								//Take the TX time recorded by callbacks since the last calculation
+	transport[transportId].pendingTxTime = 0;
+	#if defined(ESP32)
+		portEXIT_CRITICAL(&txTimeLock);
+	#else
+		interrupts();
+	#endif
+	if(millis() - transport[transportId].dutyCycleSlotStart >= dutyCycleWindow)								//The whole window has expired
+	{
+		for(uint8_t slot = 0; slot < dutyCycleSlots; slot++)
+		{
+			transport[transportId].dutyCycleSlotTxTime[slot] = 0;
+		}
+		transport[transportId].currentDutyCycleSlot = 0;
+		transport[transportId].dutyCycleSlotStart = millis();
+	}
+	else
+	{
+		while(millis() - transport[transportId].dutyCycleSlotStart >= slotLength)								//Expire the oldest slots, unsigned maths copes with millis() rollover
+		{
+			transport[transportId].currentDutyCycleSlot = (transport[transportId].currentDutyCycleSlot + 1)%dutyCycleSlots;
+			transport[transportId].dutyCycleSlotTxTime[transport[transportId].currentDutyCycleSlot] = 0;
+			transport[transportId].dutyCycleSlotStart += slotLength;
+		}
+	}
+	transport[transportId].txTime += pendingTxTime;
+	transport[transportId].dutyCycleSlotTxTime[transport[transportId].currentDutyCycleSlot] += pendingTxTime;
+	transport[transportId].airtimeTokens -= pendingTxTime;													//This can go negative after a long TX, which delays the next one
+	uint32_t windowTxTime = 0;
+	for(uint8_t slot = 0; slot < dutyCycleSlots; slot++)
 	{
-		
-		//transport[transportIndex].calculatedDutyCycle = ((float)transport[transportIndex].txTime/(float)millis())/10.0;	//txTime is in micros so divided by 1000 to get percentage
+		windowTxTime += transport[transportId].dutyCycleSlotTxTime[slot];
 	}
+	transport[transportId].calculatedDutyCycle = ((float)windowTxTime/(float)dutyCycleWindow)/10.0;		//TX time is in micros so divided by 1000, then multiplied by 100 to get percentage
+	uint32_t sinceLastRefill = millis() - transport[transportId].lastTokenRefill;
+	if(sinceLastRefill > slotLength)
+	{
+		sinceLastRefill = slotLength;																		//The bucket will be full anyway, this avoids overflow
+	}
+	transport[transportId].airtimeTokens += (int32_t)(sinceLastRefill * transport[transportId].maximumDutyCycle * 10.0);	//1ms at 1% duty cycle refills 10us of TX time
+	if(transport[transportId].airtimeTokens > airtimeTokenBucketSize(transportId))
+	{
+		transport[transportId].airtimeTokens = airtimeTokenBucketSize(transportId);
+	}
+	transport[transportId].lastTokenRefill = millis();
 }
-*/
-/*
- *
- *	Node status functions
- *
- */
-bool treacleClass::online(uint8_t id)
+void treacleClass::recordTxTime(uint8_t transportId, uint32_t time)
 {
-	uint8_t nodeIndex = nodeIndexFromId(id);
-	if(nodeIndex != maximumNumberOfNodes)
+	#if defined(ESP32)
+		portENTER_CRITICAL(&txTimeLock);													//This may be called from a callback in another task
+	#endif
+	transport[transportId].pendingTxTime += time;												//Only added to the duty cycle window in calculateDutyCycle(), this may be called from an ISR
+	#if defined(ESP32)
+		portEXIT_CRITICAL(&txTimeLock);
+	#endif
+}
+int32_t treacleClass::airtimeTokenBucketSize(uint8_t transportId)
+{
+	return (int32_t)(transport[transportId].maximumDutyCycle * (dutyCycleWindow/dutyCycleSlots) * 10.0);	//One slot's worth of TX time in micros
+}
+bool treacleClass::dutyCycleAllowsTx(uint8_t transportId, uint32_t txTime)
+{
+	if(transport[transportId].calculatedDutyCycle >= transport[transportId].maximumDutyCycle || transport[transportId].airtimeTokens <= 0)
 	{
-		for(uint8_t transportIndex = 0; transportIndex < numberOfActiveTransports; transportIndex++)
+		return false;
+	}
+	if(txTime > 0)
+	{
+		if(txTime > (uint32_t)airtimeTokenBucketSize(transportId))					//Larger than the bucket can ever hold, so just wait for it to be full
 		{
-			if(online(nodeIndex, transportIndex))
+			if(transport[transportId].airtimeTokens < airtimeTokenBucketSize(transportId))
 			{
-				return true;
+				return false;
 			}
 		}
+		else if(txTime > (uint32_t)transport[transportId].airtimeTokens)
+		{
+			return false;
+		}
+		if(txTime > (transport[transportId].maximumDutyCycle - transport[transportId].calculatedDutyCycle) * dutyCycleWindow * 10.0)	//Would go over the limit for the whole window
+		{
+			return false;
+		}
 	}
-	return false;
-}
-bool treacleClass::online(uint8_t index, uint8_t transport)
-{
-	return (node[index].txReliability[transport] >= 0x8000 || node[index].rxReliability[transport] >= 0x8000 || countBits(node[index].txReliability[transport]) > 8 || countBits(node[index].rxReliability[transport]) > 8);
+	return true;
 }
-/*
-uint32_t treacleClass::rxAge(uint8_t id)
+uint8_t treacleClass::packetSizeOnAir(uint8_t transportId, uint8_t packetLength)
 {
-	uint8_t nodeIndex = nodeIndexFromId(id);
-	if(nodeIndex != maximumNumberOfNodes)
+	uint8_t packetSize = packetLength + 2;																	//Checksum
+	if(transport[transportId].encrypted == true)
 	{
-		return millis() - node[nodeIndex].lastSeen;
+		packetSize += (encryptionBlockSize - (packetSize - (uint8_t)headerPosition::blockIndex)%encryptionBlockSize)%encryptionBlockSize;	//Padding
 	}
+	return packetSize;
+}
+uint32_t treacleClass::expectedTxTime(uint8_t transportId, uint8_t packetSize)
+{
+	#if defined(TREACLE_SUPPORT_LORA)
+		if(transportId == loRaTransportId)
+		{
+			return loRaTimeOnAir(packetSize);
+		}
+	#endif
+	#if defined(TREACLE_SUPPORT_COBS)
+		if(transportId == cobsTransportId)
+		{
+			return ((uint32_t)packetSize + 2) * 10000000UL / cobsNominalBaudrate;			//Roughly one byte of COBS overhead and the trailing zero, at 10 bits per byte
+		}
+	#endif
 	return 0;
 }
-*/
-/*
- *
- *	Status functions
- *
- */
-uint8_t treacleClass::nodes()
+float treacleClass::deliveryProbability(uint8_t nodeIndex, uint8_t transportId)
 {
-	return numberOfNodes;
+	return deliveryChance(nodeIndex, transportId)/16.0;
 }
-bool treacleClass::nodesChanged()
+uint8_t treacleClass::deliveryChance(uint8_t nodeIndex, uint8_t transportId)
 {
-	if(numberOfNodesChanged == true)
+	if(online(nodeIndex, transportId) == false)
 	{
-		numberOfNodesChanged = false;
-		return true;
+		return 0;
 	}
-	return false;
-}
-uint8_t treacleClass::reachableNodes()
-{
-	return numberOfReachableNodes;
-}
-bool treacleClass::reachableNodesChanged()
-{
-	if(numberOfReachableNodesChanged == true)
+	if(node[nodeIndex].txReliability[transportId] != 0)
 	{
-		numberOfReachableNodesChanged = false;
-		return true;
+		return countBits(node[nodeIndex].txReliability[transportId]);		//How many of this node's recent ticks the other node reports hearing
 	}
-	return false;
-}
-bool treacleClass::online()
-{
-	return currentState == state::online;
+	return countBits(node[nodeIndex].rxReliability[transportId]);			//Nothing reported yet, so assume the link is symmetric
 }
-void treacleClass::forceOffline()
+uint32_t treacleClass::transportCost(uint8_t transportId, uint8_t packetSize, bool onTick)
 {
-	if(currentState != state::forcedOffline)
+	uint32_t airtime = expectedTxTime(transportId, packetSize);
+	if(airtime == 0 && transport[transportId].txPackets > 0)
 	{
-		currentState = state::forcedOffline;
+		airtime = transport[transportId].txTime/transport[transportId].txPackets;		//Use the average measured TX time if it can't be predicted. This is approximate as txTime rolls over
+	}
+	float remainingDutyCycle = transport[transportId].maximumDutyCycle - transport[transportId].calculatedDutyCycle;
+	if(remainingDutyCycle <= 0)
+	{
+		return 0xffffffff;
+	}
+	uint32_t cost = transport[transportId].fixedCost + 1;
+	cost += (airtime * (transport[transportId].maximumDutyCycle/remainingDutyCycle))/100;	//Airtime in 100us units, which gets more expensive as the duty cycle budget is used up
+	if(onTick == true)
+	{
+		cost += timeToNextTick(transportId)/100;										//Waiting for the next tick, in 100ms units
+	}
+	else
+	{
+		if(transport[transportId].acknowledgement != nullptr)
+		{
+			cost += transport[transportId].acknowledgement->roundTripTime/100;							//Sent straight away, so just the time to get there
+		}
+	}
+	return cost;
+}
+uint8_t treacleClass::selectTransports(uint8_t available, uint32_t* recipients, uint8_t packetLength, bool onTick)
+{
+	uint8_t failure[absoluteMaximumNumberOfNodes];									//Chance each recipient has not received the message on any transport chosen so far, where 255 is certain
+	for(uint8_t nodeIndex = 0; nodeIndex < numberOfNodes; nodeIndex++)
+	{
+		failure[nodeIndex] = (recipients[nodeIndex/32] & (0x00000001UL << (nodeIndex%32))) ? 255 : 0;
+	}
+	const uint8_t failureTarget = (1 - targetDeliveryProbability) * 255;
+	for(uint8_t transportId = 0; transportId < numberOfActiveTransports; transportId++)
+	{
+		transport[transportId].selectionCost = 0;
+		if(available & (0x01 << transportId))
+		{
+			transport[transportId].selectionCost = transportCost(transportId, packetSizeOnAir(transportId, packetLength), onTick);
+			for(uint8_t nodeIndex = 0; nodeIndex < numberOfNodes; nodeIndex++)
+			{
+				deliveryChances[transportId * maximumNumberOfNodes + nodeIndex] = deliveryChance(nodeIndex, transportId);	//This doesn't change while choosing
+			}
+		}
+	}
+	uint8_t selected = 0;
+	while(true)
+	{
+		uint8_t bestTransport = numberOfActiveTransports;
+		float bestValue = 0;
+		for(uint8_t transportId = 0; transportId < numberOfActiveTransports; transportId++)
+		{
+			if((available & (0x01 << transportId)) && (selected & (0x01 << transportId)) == 0)
+			{
+				uint32_t expectedDeliveries = 0;										//Additional recipients expected to get the message with this transport, scaled by 255*16
+				for(uint8_t nodeIndex = 0; nodeIndex < numberOfNodes; nodeIndex++)
+				{
+					expectedDeliveries += (uint16_t)failure[nodeIndex] * deliveryChances[transportId * maximumNumberOfNodes + nodeIndex];
+				}
+				if((float)expectedDeliveries/transport[transportId].selectionCost > bestValue)
+				{
+					bestValue = (float)expectedDeliveries/transport[transportId].selectionCost;
+					bestTransport = transportId;
+				}
+			}
+		}
+		if(bestTransport == numberOfActiveTransports)
+		{
+			break;																		//Nothing else helps
+		}
+		selected |= (0x01 << bestTransport);
+		bool targetMet = true;
+		for(uint8_t nodeIndex = 0; nodeIndex < numberOfNodes; nodeIndex++)
+		{
+			failure[nodeIndex] = ((uint16_t)failure[nodeIndex] * (16 - deliveryChances[bestTransport * maximumNumberOfNodes + nodeIndex]) + 8)/16;	//Rounded to the nearest
+			if(failure[nodeIndex] > failureTarget)
+			{
+				targetMet = false;
+			}
+		}
+		if(targetMet == true)
+		{
+			break;
+		}
+	}
+	#if defined(TREACLE_DEBUG)
+		debugPrint(treacleDebugString_treacleSpace);
+		for(uint8_t transportId = 0; transportId < numberOfActiveTransports; transportId++)
+		{
+			debugPrintTransportName(transportId);
+			debugPrint(' ');
+			debugPrint(treacleDebugString_cost);
+			debugPrint(':');
+			debugPrint(transport[transportId].selectionCost);
+			if(selected & (0x01 << transportId))
+			{
+				debugPrint(' ');
+				debugPrint(treacleDebugString_selected);
+			}
+			debugPrint(' ');
+		}
+		debugPrintln();
+	#endif
+	lastTransportSelection = selected;
+	return selected;
+}
+/*
+ *
+ *	Node status functions
+ *
+ */
+bool treacleClass::online(uint8_t id)
+{
+	uint8_t nodeIndex = nodeIndexFromId(id);
+	if(nodeIndex != maximumNumberOfNodes)
+	{
+		for(uint8_t transportIndex = 0; transportIndex < numberOfActiveTransports; transportIndex++)
+		{
+			if(online(nodeIndex, transportIndex))
+			{
+				return true;
+			}
+		}
+	}
+	return false;
+}
+bool treacleClass::online(uint8_t index, uint8_t transportId)
+{
+	return transport[transportId].reachableNodes[index/32] & (0x00000001UL << (index%32));	//Bitmask is maintained by updateNodeReachability()
+}
+void treacleClass::updateNodeReachability(uint8_t nodeIndex, uint8_t transportId)
+{
+	if(node[nodeIndex].txReliability[transportId] >= 0x8000 || node[nodeIndex].rxReliability[transportId] >= 0x8000 || countBits(node[nodeIndex].txReliability[transportId]) > 8 || countBits(node[nodeIndex].rxReliability[transportId]) > 8)
+	{
+		transport[transportId].reachableNodes[nodeIndex/32] |= (0x00000001UL << (nodeIndex%32));		//Set the bit for this node
+	}
+	else
+	{
+		transport[transportId].reachableNodes[nodeIndex/32] &= ~(0x00000001UL << (nodeIndex%32));		//Clear the bit for this node
+	}
+	remoteTicksChanged = true;																				//Reliability and tick timing change together, so reschedule time outs
+}
+/*
+uint32_t treacleClass::rxAge(uint8_t id)
+{
+	uint8_t nodeIndex = nodeIndexFromId(id);
+	if(nodeIndex != maximumNumberOfNodes)
+	{
+		return millis() - node[nodeIndex].lastSeen;
+	}
+	return 0;
+}
+*/
+/*
+ *
+ *	Status functions
+ *
+ */
+uint8_t treacleClass::nodes()
+{
+	return numberOfNodes;
+}
+bool treacleClass::nodesChanged()
+{
+	if(numberOfNodesChanged == true)
+	{
+		numberOfNodesChanged = false;
+		return true;
+	}
+	return false;
+}
+uint8_t treacleClass::reachableNodes()
+{
+	return numberOfReachableNodes;
+}
+bool treacleClass::reachableNodesChanged()
+{
+	if(numberOfReachableNodesChanged == true)
+	{
+		numberOfReachableNodesChanged = false;
+		return true;
+	}
+	return false;
+}
+bool treacleClass::online()
+{
+	return currentState == state::online;
+}
+void treacleClass::forceOffline()
+{
+	if(currentState != state::forcedOffline)
+	{
+		currentState = state::forcedOffline;
 	}
 }
 void goOnline()
@@ -1721,245 +2813,2050 @@ uint32_t treacleClass::messageWaiting()
 		{
 			if(!mqtt->connected())
 			{
-				connectToMQTTserver();
+				connectToMQTTserver();
+			}
+			else
+			{
+				mqtt->loop();
+			}
+		}
+	#endif
+	#if defined(TREACLE_SUPPORT_LORA)
+		if(loRaTransportId != 255 && transport[loRaTransportId].initialised == true)	//Polling method for loRa packets, must be enabled and initialised, with an IRQ pin this only empties the queue
+		{
+			receiveLoRa();
+		}
+	#endif
+	#if defined(TREACLE_SUPPORT_ESPNOW)
+		if(espNowTransportId != 255 && transport[espNowTransportId].initialised == true)	//Follow channel changes, and search for other nodes if enabled
+		{
+			checkEspNowChannel();
+		}
+	#endif
+	#if defined(TREACLE_ESPNOW_LARGE_FRAMES)
+		if(espNowTransportId != 255 && transport[espNowTransportId].initialised == true)	//Packets from a received large frame are passed on one at a time
+		{
+			receiveEspNow();
+		}
+	#endif
+	#if defined(TREACLE_SUPPORT_UDP)
+		if(UDPTransportId != 255 && transport[UDPTransportId].initialised == true)	//Polling method for UDP packets, must be enabled and initialised, on ESP32 this only empties the queue
+		{
+			receiveUDP();
+		}
+	#endif
+	#if defined(TREACLE_SUPPORT_COBS)
+		if(cobsTransportId != 255 && transport[cobsTransportId].initialised == true)	//Polling method for COBS packets, must be enabled and initialised
+		{
+			receiveCobs();
+		}
+	#endif
+	if(currentState == state::uninitialised || currentState == state::starting || currentState == state::stopped)
+	{
+		return 0;						//Nothing can be sent or received in these states
+	}
+	else if(packetReceived() && receiveBufferCrcChecked == false)	//Only unpack a packet once
+	{
+		unpackPacket();					//Handle unpacking of an incoming packet
+	}
+	else if(sendPacketOnTick() == true)	//Send a packet if it needs to happen now
+	{
+		return 0;						//A tick has been sent, so the application can wait until next time for any data
+	}
+	else if(sendParityPacket() == true)			//Parity packets follow the application packets they protect, between ticks
+	{
+		return 0;
+	}
+	else if(sendAcknowledgement() == true)		//Acknowledgements are sent between ticks so round trip times are short
+	{
+		return 0;
+	}
+	else if(sendAcknowledgedMessage() == true)	//Acknowledged messages are sent and retransmitted between ticks
+	{
+		return 0;
+	}
+	else if(sendRelayedPacket() == true)		//Relays are sent between ticks
+	{
+		return 0;
+	}
+	else if(sendBridgedPacket() == true)		//Bridged packets are forwarded between ticks
+	{
+		return 0;
+	}
+	else if(sendLargeMessageAck() == true)		//Acknowledgements of large messages are sent between ticks
+	{
+		return 0;
+	}
+	else if(sendLargeMessageFragment() == true)	//Large messages are sent between ticks, as fast as the duty cycle allows
+	{
+		return 0;
+	}
+	timeOutTicks();						//Potentially time out ticks from other nodes if they are not responding or the application is slow calling this
+	#if defined(TREACLE_SUPPORT_LORA)
+		if(loRaAdaptiveDataRate == true && loRaTransportId != 255 && transport[loRaTransportId].initialised == true && loRaTransmitting() == false)
+		{
+			updateLoRaDataRate();		//Spreading factor changes happen at set network times, but not part way through sending a packet
+		}
+	#endif
+	if(currentState == state::selectingId)
+	{
+		if(applicationDataPacketReceived())
+		{
+			clearReceiveBuffer();		//Any incoming application data is binned in this state
+		}
+		else if(millis() - lastStateChange > maximumTickTime)
+		{
+			if(selectNodeId())
+			{
+				changeCurrentState(state::selectedId);	//Need to inform other nodes of this node's presence
+			}
+			else
+			{
+				changeCurrentState(state::stopped);		//Nothing can be sent or received
+			}
+		}
+		return 0;	//Nothing can be sent or received, only IDs collected
+	}
+	else if(currentState == state::selectedId || currentState == state::online || currentState == state::offline)	//Normal active states
+	{
+		if(applicationDataPacketReceived() && receiveBufferCrcChecked == true)
+		{
+			return receiveBuffer[(uint8_t)headerPosition::packetLength] - (uint8_t)headerPosition::payload;
+		}
+		else if(largeMessageComplete == true)
+		{
+			return largeMessageReceiveLength;
+		}
+	}
+	return 0;
+}
+uint32_t treacleClass::nextEventInMs()
+{
+	if(currentState == state::uninitialised || currentState == state::stopped)
+	{
+		return maximumTickTime;										//Nothing will happen in these states
+	}
+	if(packetReceived() || remoteTicksChanged == true || largeMessageData != nullptr)
+	{
+		return 0;													//There is something to unpack, pick up, reschedule or fragment now
+	}
+	#if defined(TREACLE_SUPPORT_LORA) && !defined(AVR)
+		if(loRaRxQueueHead != loRaRxQueueTail)
+		{
+			return 0;												//LoRa packets are queued to unpack
+		}
+	#endif
+	#if defined(TREACLE_SUPPORT_UDP) && defined(ESP32)
+		if(udpRxQueueHead != udpRxQueueTail)
+		{
+			return 0;												//UDP packets are queued to unpack
+		}
+	#endif
+	#if defined(TREACLE_ESPNOW_LARGE_FRAMES)
+		if(espNowRxFrameLength > 0 || espNowTxFrameLength > 0)
+		{
+			return 0;												//A large frame has packets to unpack or send
+		}
+	#endif
+	uint32_t nextEvent = maximumTickTime;
+	uint8_t backingOff = 0;											//Transports where nothing can be sent between ticks for now
+	for(uint8_t transportId = 0; transportId < numberOfActiveTransports; transportId++)
+	{
+		uint32_t nextTransportTick = timeToNextTick(transportId);
+		#if defined(TREACLE_SUPPORT_LORA)
+			if(transportId == loRaTransportId && transport[transportId].txStartTime != 0)	//Nothing more can be sent until the packet on air finishes
+			{
+				uint32_t elapsed = (micros() - transport[transportId].txStartTime)/1000;
+				if(elapsed < loRaTxDuration/1000 && loRaTxDuration/1000 - elapsed > nextTransportTick)
+				{
+					nextTransportTick = loRaTxDuration/1000 - elapsed;
+				}
+			}
+		#endif
+		if(nextTransportTick < nextEvent)
+		{
+			nextEvent = nextTransportTick;
+		}
+		#if defined(TREACLE_SUPPORT_LORA)
+			if(transportId == loRaTransportId && timeToLoRaBackoffEnd() > 0)			//The channel was busy, so anything sent between ticks waits for the backoff
+			{
+				backingOff |= (0x01 << transportId);
+				if(timeToLoRaBackoffEnd() < nextEvent)
+				{
+					nextEvent = timeToLoRaBackoffEnd();
+				}
+				continue;
+			}
+		#endif
+		if(transport[transportId].fec != nullptr && transport[transportId].fec->parityDue == true && packetInQueue(transportId) == false)
+		{
+			return 0;																//A parity packet can be sent now
+		}
+		if(transport[transportId].bridge != nullptr && transport[transportId].bridge->length > 0 && packetInQueue(transportId) == false)
+		{
+			return 0;																//A bridged packet can be forwarded now
+		}
+		if(transport[transportId].relay != nullptr && transport[transportId].relay->length > 0)	//Relays are sent between ticks
+		{
+			if((int32_t)(millis() - transport[transportId].relay->time) >= 0)
+			{
+				return 0;
+			}
+			else if(transport[transportId].relay->time - millis() < nextEvent)
+			{
+				nextEvent = transport[transportId].relay->time - millis();
+			}
+		}
+		if(transport[transportId].acknowledgement != nullptr && transport[transportId].acknowledgement->due == true)	//Acknowledgements are sent between ticks
+		{
+			if((int32_t)(millis() - transport[transportId].acknowledgement->time) >= 0)
+			{
+				return 0;
+			}
+			else if(transport[transportId].acknowledgement->time - millis() < nextEvent)
+			{
+				nextEvent = transport[transportId].acknowledgement->time - millis();
+			}
+		}
+		if(transport[transportId].largeMessage != nullptr && transport[transportId].largeMessage->ackDue == true)	//Large message acknowledgements are sent between ticks
+		{
+			if((int32_t)(millis() - transport[transportId].largeMessage->ackTime) >= 0)
+			{
+				return 0;
+			}
+			else if(transport[transportId].largeMessage->ackTime - millis() < nextEvent)
+			{
+				nextEvent = transport[transportId].largeMessage->ackTime - millis();
+			}
+		}
+	}
+	#if defined(TREACLE_SUPPORT_ESPNOW)
+		if(espNowScanning == true && espNowScanDwellTime < nextEvent)
+		{
+			nextEvent = espNowScanDwellTime;						//Searching for other nodes moves on a channel at a time
+		}
+	#endif
+	if(acknowledgedMessageHandle != 0)
+	{
+		if((acknowledgedMessagePending & ~backingOff) != 0 ||
+			(acknowledgedMessagePending == 0 && millis() - acknowledgedMessageAttemptTime >= acknowledgedMessageTimeout))
+		{
+			return 0;													//The acknowledged message needs sending or has timed out
+		}
+		else if(acknowledgedMessagePending == 0 && acknowledgedMessageTimeout - (millis() - acknowledgedMessageAttemptTime) < nextEvent)
+		{
+			nextEvent = acknowledgedMessageTimeout - (millis() - acknowledgedMessageAttemptTime);
+		}
+	}
+	if((int32_t)(nextRemoteTimeOut - millis()) <= 0)
+	{
+		return 0;
+	}
+	else if(nextRemoteTimeOut - millis() < nextEvent)
+	{
+		nextEvent = nextRemoteTimeOut - millis();
+	}
+	if(currentState == state::selectingId)
+	{
+		uint32_t sinceStateChange = millis() - lastStateChange;
+		if(sinceStateChange > maximumTickTime)
+		{
+			return 0;
+		}
+		else if(maximumTickTime - sinceStateChange + 1 < nextEvent)
+		{
+			nextEvent = maximumTickTime - sinceStateChange + 1;
+		}
+	}
+	return nextEvent;												//Note polled transports (LoRa without an IRQ pin, COBS etc.) will only receive while messageWaiting() is called
+}
+void treacleClass::clearWaitingMessage()
+{
+	if(applicationDataPacketReceived() == false && largeMessageComplete == true)
+	{
+		clearLargeMessage();
+	}
+	else
+	{
+		clearReceiveBuffer();
+	}
+	#if defined(TREACLE_DEBUG)
+		debugPrint(treacleDebugString_treacleSpace);
+		debugPrint(treacleDebugString_message);
+		debugPrint(' ');
+		debugPrintln(treacleDebugString_cleared);
+	#endif
+}
+void treacleClass::calculateNumberOfReachableNodes()
+{
+	uint8_t startingNumber = numberOfReachableNodes;
+	uint32_t nodeReachable[nodeBitmaskSize] = {};	//Used to track which nodes _can_ be reached
+	//OR together ALL options to get the total reachable nodes
+	for (uint8_t transportId = 0; transportId < numberOfActiveTransports; transportId++)
+	{
+		if(transport[transportId].initialised == true)	//It's initialised
+		{
+			for(uint8_t word = 0; word < nodeBitmaskSize; word++)
+			{
+				nodeReachable[word] |= transport[transportId].reachableNodes[word];
+			}
+		}
+	}
+	numberOfReachableNodes = countNodeBits(nodeReachable);
+	if(numberOfReachableNodes != startingNumber)
+	{
+		numberOfReachableNodesChanged = true;													//Inform the application
+	}
+}
+
+uint32_t treacleClass::suggestedQueueInterval()
+{
+	uint8_t numberOfNodesReached = 0;
+	if(numberOfActiveTransports > 1)
+	{
+		uint32_t nodeReached[nodeBitmaskSize] = {};	//Used to track which nodes _should_ have been reached, in transport priority order and avoid sending using lower priority transports, if possible
+		//Iterate and stop once the nodes _should_ all be reachable to determine a reasonable queue interval
+		for (uint8_t transportId = 0; transportId < numberOfActiveTransports; transportId++)
+		{
+			if(transport[transportId].initialised == true)	//It's initialised
+			{
+				for(uint8_t word = 0; word < nodeBitmaskSize; word++)
+				{
+					nodeReached[word] |= transport[transportId].reachableNodes[word];
+				}
+				numberOfNodesReached = countNodeBits(nodeReached);
+			}
+			if(numberOfNodesReached == numberOfReachableNodes)
+			{
+				#if defined(TREACLE_DEBUG)
+					debugPrint(treacleDebugString_treacleSpace);
+					debugPrint(treacleDebugString_suggested_message_interval);
+					debugPrint(' ');
+					debugPrint((transport[transportId].nextTick * 2)/1000);
+					debugPrintln('s');
+				#endif
+				return transport[transportId].nextTick * 2;
+			}
+		}
+	}
+	else if(numberOfActiveTransports == 1)
+	{
+		#if defined(TREACLE_DEBUG)
+			debugPrint(treacleDebugString_treacleSpace);
+			debugPrint(treacleDebugString_suggested_message_interval);
+			debugPrint(' ');
+			debugPrint((transport[0].nextTick * 2)/1000);
+			debugPrintln('s');
+		#endif
+		return transport[0].nextTick * 2;
+	}
+	#if defined(TREACLE_DEBUG)
+		debugPrint(treacleDebugString_treacleSpace);
+		debugPrint(treacleDebugString_suggested_message_interval);
+		debugPrint(' ');
+		debugPrint((maximumTickTime * 2)/1000);
+		debugPrintln('s');
+	#endif
+	return maximumTickTime * 2;
+}
+uint8_t treacleClass::messageSender()
+{
+	if(applicationDataPacketReceived() == false && largeMessageComplete == true)
+	{
+		return largeMessageReceiveSender;
+	}
+	return receiveBuffer[(uint8_t)headerPosition::sender];
+}
+bool treacleClass::queueMessage(char* data)
+{
+	return queueMessage((uint8_t*)data, strlen(data)+1);
+}
+bool treacleClass::queueMessage(const unsigned char* data, uint8_t length)
+{
+	return queueMessage((uint8_t*)data, (uint8_t)length);
+}
+bool treacleClass::queueMessage(uint8_t* data, uint8_t length)
+{
+	return queueMessage((uint8_t)nodeId::allNodes, data, length);
+}
+bool treacleClass::queueMessage(uint8_t destinationId, char* data)
+{
+	return queueMessage(destinationId, (uint8_t*)data, strlen(data)+1);
+}
+bool treacleClass::queueMessage(uint8_t destinationId, uint8_t* data, uint8_t length)
+{
+	uint32_t recipients[nodeBitmaskSize] = {};			//Nodes the message is intended for
+	uint8_t destinationIndex = maximumNumberOfNodes;	//Stays at maximumNumberOfNodes for messages to all nodes
+	if(destinationId != (uint8_t)nodeId::allNodes)
+	{
+		destinationIndex = nodeIndexFromId(destinationId);
+		if(destinationIndex == maximumNumberOfNodes)
+		{
+			return false;								//Unknown node, so it can't be online with any transport
+		}
+		recipients[destinationIndex/32] = (0x00000001UL << (destinationIndex%32));
+	}
+	else
+	{
+		for(uint8_t transportId = 0; transportId < numberOfActiveTransports; transportId++)
+		{
+			for(uint8_t word = 0; word < nodeBitmaskSize; word++)
+			{
+				recipients[word] |= transport[transportId].reachableNodes[word];
+			}
+		}
+	}
+	if(length < maximumPayloadSize)
+	{
+		bool relayable = destinationIndex == maximumNumberOfNodes && relayHops > 0 &&	//Messages to all nodes can be relayed, if there is room
+			length + relayHeaderSize < maximumPayloadSize;
+		uint8_t packetLength = (uint8_t)headerPosition::payload + length + (relayable ? relayHeaderSize : 0);
+		uint8_t available = 0;
+		for (uint8_t transportId = 0; transportId < numberOfActiveTransports; transportId++)
+		{
+			if(transport[transportId].initialised == true &&	//It's initialised
+				packetInQueue(transportId) == false) 			//It's got nothing waiting to go
+			{
+				calculateDutyCycle(transportId);
+				if(dutyCycleAllowsTx(transportId, expectedTxTime(transportId, packetSizeOnAir(transportId, packetLength))))	//It can be sent within the duty cycle
+				{
+					available |= (0x01 << transportId);
+				}
+			}
+		}
+		uint8_t selected = selectTransports(available, recipients, packetLength, true);
+		if(selected == 0)
+		{
+			if(destinationIndex != maximumNumberOfNodes)
+			{
+				return false;							//The node isn't online with any transport that can take it
+			}
+			selected = available;						//Nobody is known to be reachable, so send it on everything to find them
+			if(selected == 0)
+			{
+				return false;							//Every transport is busy or out of duty cycle, so the application must try again
+			}
+		}
+		if(relayable)
+		{
+			relaySequenceNumber++;						//One number for the message on every transport
+		}
+		for (uint8_t transportId = 0; transportId < numberOfActiveTransports; transportId++)
+		{
+			if(selected & (0x01 << transportId))
+			{
+				if(transport[transportId].fec != nullptr && transport[transportId].fec->parityDue == true && sendParityPacket(transportId) == false)
+				{
+					resetParity(transportId);															//The parity packet for the previous group can't be sent first, so give up on it
+				}
+				buildPacketHeader(transportId, destinationId, relayable ? payloadType::relayableApplicationData : payloadType::shortApplicationData);	//Make an application data packet
+				if(relayable)
+				{
+					transport[transportId].transmitBuffer[transport[transportId].transmitPacketSize++] = currentNodeId;	//This node is the origin
+					transport[transportId].transmitBuffer[transport[transportId].transmitPacketSize++] = relaySequenceNumber;	//So copies can be recognised after relaying, whichever transport they arrive on
+					transport[transportId].transmitBuffer[transport[transportId].transmitPacketSize++] = relayHops;		//Hops remaining
+				}
+				memcpy(&transport[transportId].transmitBuffer[transport[transportId].transmitPacketSize], data, length);	//Copy the data after the header
+				transport[transportId].transmitPacketSize += length;													//Update the length of the transmit buffer
+				transport[transportId].transmitBuffer[(uint8_t)headerPosition::packetLength] = 							//Update packetLength field
+				transport[transportId].transmitPacketSize;
+				processPacketBeforeTransmission(transportId);															//Do CRC and encryption if needed
+				if(destinationIndex == maximumNumberOfNodes && relayable == false)
+				{
+					addPacketToParity(transportId, data, length);														//Only messages to all nodes can be recovered by every receiver, relaying covers losses otherwise
+				}
+			}
+		}
+		return true;
+	}
+	return false;
+}
+bool treacleClass::sendMessage(char* data)
+{
+	bringForwardNextTick();
+	return queueMessage((uint8_t*)data, strlen(data)+1);
+}
+bool treacleClass::sendMessage(const unsigned char* data, uint8_t length)
+{
+	bringForwardNextTick();
+	return queueMessage((uint8_t*)data, (uint8_t)length);
+}
+bool treacleClass::sendMessage(uint8_t* data, uint8_t length)
+{
+	bringForwardNextTick();
+	return queueMessage(data, length);
+}
+bool treacleClass::sendMessage(uint8_t destinationId, char* data)
+{
+	bringForwardNextTick();
+	return queueMessage(destinationId, (uint8_t*)data, strlen(data)+1);
+}
+bool treacleClass::sendMessage(uint8_t destinationId, uint8_t* data, uint8_t length)
+{
+	bringForwardNextTick();
+	return queueMessage(destinationId, data, length);
+}
+bool treacleClass::retrieveWaitingMessage(uint8_t* destination)
+{
+	if(applicationDataPacketReceived())
+	{
+		memcpy(destination, &receiveBuffer[(uint8_t)headerPosition::payload], receiveBuffer[(uint8_t)headerPosition::packetLength] - (uint8_t)headerPosition::payload);
+		return true;
+	}
+	else if(largeMessageComplete == true)
+	{
+		memcpy(destination, largeMessageReceiveBuffer, largeMessageReceiveLength);
+		return true;
+	}
+	return false;
+}
+uint8_t treacleClass::maxPayloadSize()
+{
+	return maximumPayloadSize;
+}
+/*
+ *
+ *	Forward error correction functions
+ *
+ */
+void treacleClass::addPacketToParity(uint8_t transportId, uint8_t* data, uint8_t length)
+{
+	if(transport[transportId].fecGroupSize > 0 && length <= fecMaximumPayloadSize)
+	{
+		transport[transportId].fec->groupPayloadNumbers[transport[transportId].fec->groupCount++] = transport[transportId].transmitBuffer[(uint8_t)headerPosition::payloadNumber];
+		for(uint8_t index = 0; index < length; index++)
+		{
+			transport[transportId].fec->parity[index] ^= data[index];
+		}
+		transport[transportId].fec->lengthParity ^= length;
+		if(length > transport[transportId].fec->parityLength)
+		{
+			transport[transportId].fec->parityLength = length;
+		}
+		if(transport[transportId].fec->groupCount == transport[transportId].fecGroupSize)
+		{
+			transport[transportId].fec->parityDue = true;								//Send the parity once the last packet in the group has gone
+		}
+	}
+}
+void treacleClass::resetParity(uint8_t transportId)
+{
+	if(transport[transportId].fec != nullptr)
+	{
+		transport[transportId].fec->groupCount = 0;
+		transport[transportId].fec->lengthParity = 0;
+		transport[transportId].fec->parityLength = 0;
+		transport[transportId].fec->parityDue = false;
+		memset(transport[transportId].fec->parity, 0, fecMaximumPayloadSize);
+	}
+}
+bool treacleClass::sendParityPacket()
+{
+	for(uint8_t transportId = 0; transportId < numberOfActiveTransports; transportId++)
+	{
+		if(sendParityPacket(transportId))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+bool treacleClass::sendParityPacket(uint8_t transportId)
+{
+	if(transport[transportId].fec != nullptr && transport[transportId].fec->parityDue == true &&
+		packetInQueue(transportId) == false &&			//The last packet in the group has been sent
+		transport[transportId].txStartTime == 0 &&		//And has finished sending
+		sendBackingOff(transportId) == false)
+	{
+		calculateDutyCycle(transportId);
+		if(dutyCycleAllowsTx(transportId, expectedTxTime(transportId, packetSizeOnAir(transportId, (uint8_t)headerPosition::payload + 2 +
+			transport[transportId].fec->groupCount + transport[transportId].fec->parityLength))))
+		{
+			buildParityPacket(transportId);
+			transport[transportId].bufferSent = true;
+			if(sendBuffer(transportId, transport[transportId].transmitBuffer, transport[transportId].transmitPacketSize))
+			{
+				#if defined(TREACLE_DEBUG)
+					debugPrint(treacleDebugString_treacleSpace);
+					debugPrintTransportName(transportId);
+					debugPrint(' ');
+					debugPrint(treacleDebugString_parity);
+					debugPrint(':');
+					debugPrint(transport[transportId].transmitPacketSize);
+					debugPrint(' ');
+					debugPrint(treacleDebugString_bytes);
+					debugPrint(' ');
+					debugPrintln(treacleDebugString_sent);
+				#endif
+				resetParity(transportId);
+				return true;
+			}
+			backOffAfterBusyChannel(transportId);		//The parity packet stays due
+		}
+	}
+	return false;
+}
+/*
+ *
+ *	Acknowledged message functions
+ *
+ */
+uint8_t treacleClass::queueAcknowledgedMessage(uint8_t destinationId, uint8_t* data, uint8_t length, uint8_t quorum)
+{
+	if(acknowledgedMessageHandle != 0 || length >= maximumPayloadSize || currentState != state::online)	//Only one at a time, and it needs a byte for the handle
+	{
+		return 0;
+	}
+	uint32_t reachable[nodeBitmaskSize] = {};
+	for(uint8_t transportId = 0; transportId < numberOfActiveTransports; transportId++)
+	{
+		for(uint8_t word = 0; word < nodeBitmaskSize; word++)
+		{
+			reachable[word] |= transport[transportId].reachableNodes[word];
+		}
+	}
+	if(destinationId == (uint8_t)nodeId::allNodes)
+	{
+		if(quorum == 0 || quorum > countNodeBits(reachable))
+		{
+			quorum = countNodeBits(reachable);								//Every reachable node, or as many as there are
+		}
+		if(quorum == 0)
+		{
+			return 0;														//Nobody to acknowledge it
+		}
+	}
+	else
+	{
+		uint8_t nodeIndex = nodeIndexFromId(destinationId);
+		if(nodeIndex == maximumNumberOfNodes || (reachable[nodeIndex/32] & (0x00000001UL << (nodeIndex%32))) == 0)
+		{
+			return 0;														//Unknown or not online with any transport
+		}
+		quorum = 1;
+	}
+	if(acknowledgedMessageData == nullptr)
+	{
+		acknowledgedMessageData = new uint8_t[maximumPayloadSize];
+		lastAcknowledgedMessageHandle = random(0,256);						//Start at a random handle so a restart isn't mistaken for a retransmission
+	}
+	for(uint8_t transportId = 0; transportId < numberOfActiveTransports; transportId++)
+	{
+		if(transport[transportId].acknowledgement == nullptr)
+		{
+			transport[transportId].acknowledgement = new acknowledgementTransportData;	//Round trip times are measured on every transport it might be sent on
+		}
+	}
+	memcpy(acknowledgedMessageData, data, length);
+	acknowledgedMessageLength = length;
+	acknowledgedMessageRecipient = destinationId;
+	acknowledgedMessageQuorum = quorum;
+	if(++lastAcknowledgedMessageHandle == 0)
+	{
+		lastAcknowledgedMessageHandle = 1;
+	}
+	acknowledgedMessageHandle = lastAcknowledgedMessageHandle;
+	acknowledgedMessageAttempts = 0;
+	memset(acknowledgedMessageAcked, 0, sizeof(acknowledgedMessageAcked));
+	acknowledgedMessageQueueTime = millis();
+	startAcknowledgedMessageAttempt();
+	return acknowledgedMessageHandle;
+}
+bool treacleClass::acknowledgedMessageInProgress()
+{
+	return acknowledgedMessageHandle != 0;
+}
+void treacleClass::setDeliveryCallback(void (*function)(uint8_t, bool, uint32_t))
+{
+	deliveryCallback = function;
+}
+uint16_t treacleClass::getRoundTripTime(uint8_t index)
+{
+	if(index < numberOfActiveTransports && transport[index].acknowledgement != nullptr)
+	{
+		return transport[index].acknowledgement->roundTripTime;
+	}
+	return 0;
+}
+uint32_t treacleClass::getRetransmissionTimeout(uint8_t index)
+{
+	if(index < numberOfActiveTransports)
+	{
+		return retransmissionTimeout(index);
+	}
+	return 0;
+}
+void treacleClass::startAcknowledgedMessageAttempt()
+{
+	acknowledgedMessageAttempts++;
+	acknowledgedMessagePending = 0;
+	uint32_t recipients[nodeBitmaskSize] = {};
+	uint8_t nodeIndex = nodeIndexFromId(acknowledgedMessageRecipient);
+	if(nodeIndex != maximumNumberOfNodes)
+	{
+		recipients[nodeIndex/32] = (0x00000001UL << (nodeIndex%32));
+	}
+	uint8_t available = 0;
+	for(uint8_t transportId = 0; transportId < numberOfActiveTransports; transportId++)
+	{
+		if(transport[transportId].initialised == true)
+		{
+			available |= (0x01 << transportId);
+			calculateDutyCycle(transportId);
+			if(acknowledgedMessageRecipient == (uint8_t)nodeId::allNodes)
+			{
+				for(uint8_t word = 0; word < nodeBitmaskSize; word++)
+				{
+					recipients[word] |= transport[transportId].reachableNodes[word] & ~acknowledgedMessageAcked[word];	//Reachable nodes that have not acknowledged
+				}
+			}
+		}
+	}
+	if(acknowledgedMessageAttempts <= 2)
+	{
+		acknowledgedMessagePending = selectTransports(available, recipients, (uint8_t)headerPosition::payload + 1 + acknowledgedMessageLength, false);	//The cheapest transports likely to get it there
+	}
+	else
+	{
+		for(uint8_t transportId = 0; transportId < numberOfActiveTransports; transportId++)
+		{
+			for(uint8_t word = 0; word < nodeBitmaskSize; word++)
+			{
+				if(transport[transportId].reachableNodes[word] & recipients[word])
+				{
+					acknowledgedMessagePending |= (0x01 << transportId);			//After repeated failures use every transport a recipient is online with
+				}
+			}
+		}
+	}
+	if(acknowledgedMessagePending == 0)												//Nothing looks reachable, so try every transport
+	{
+		for(uint8_t transportId = 0; transportId < numberOfActiveTransports; transportId++)
+		{
+			if(transport[transportId].initialised == true)
+			{
+				acknowledgedMessagePending |= (0x01 << transportId);
+			}
+		}
+	}
+	acknowledgedMessageTimeout = 0;
+	for(uint8_t transportId = 0; transportId < numberOfActiveTransports; transportId++)
+	{
+		if((acknowledgedMessagePending & (0x01 << transportId)) && retransmissionTimeout(transportId) > acknowledgedMessageTimeout)
+		{
+			acknowledgedMessageTimeout = retransmissionTimeout(transportId);			//Wait for the slowest transport used
+		}
+	}
+	acknowledgedMessageTimeout = acknowledgedMessageTimeout << (acknowledgedMessageAttempts - 1);	//Back off with each retry
+	if(acknowledgedMessageTimeout > maximumTickTime)
+	{
+		acknowledgedMessageTimeout = maximumTickTime;
+	}
+}
+bool treacleClass::sendAcknowledgedMessage()
+{
+	if(acknowledgedMessageHandle == 0)
+	{
+		return false;
+	}
+	if(acknowledgedMessagePending == 0)
+	{
+		if(millis() - acknowledgedMessageAttemptTime >= acknowledgedMessageTimeout)
+		{
+			if(acknowledgedMessageAttempts > acknowledgedMessageMaximumRetries)
+			{
+				finishAcknowledgedMessage(false);
+				return false;
+			}
+			startAcknowledgedMessageAttempt();
+		}
+		else
+		{
+			return false;
+		}
+	}
+	for(uint8_t transportId = 0; transportId < numberOfActiveTransports; transportId++)
+	{
+		if((acknowledgedMessagePending & (0x01 << transportId)) &&
+			packetInQueue(transportId) == false &&
+			transport[transportId].txStartTime == 0 &&
+			sendBackingOff(transportId) == false)
+		{
+			calculateDutyCycle(transportId);
+			if(dutyCycleAllowsTx(transportId, expectedTxTime(transportId, packetSizeOnAir(transportId, (uint8_t)headerPosition::payload + 1 + acknowledgedMessageLength))))
+			{
+				buildAcknowledgedMessagePacket(transportId);
+				transport[transportId].bufferSent = true;
+				acknowledgedMessagePending &= ~(0x01 << transportId);
+				if(sendBuffer(transportId, transport[transportId].transmitBuffer, transport[transportId].transmitPacketSize))
+				{
+					transport[transportId].acknowledgement->sentTime = millis();
+					#if defined(TREACLE_DEBUG)
+						debugPrint(treacleDebugString_treacleSpace);
+						debugPrintTransportName(transportId);
+						debugPrint(' ');
+						debugPrint(treacleDebugString_acknowledged_application_data);
+						debugPrint(':');
+						debugPrint(acknowledgedMessageHandle);
+						debugPrint(' ');
+						debugPrintln(treacleDebugString_sent);
+					#endif
+				}
+				else if(backOffAfterBusyChannel(transportId))
+				{
+					acknowledgedMessagePending |= (0x01 << transportId);				//Try again after the backoff
+					continue;
+				}
+				if(acknowledgedMessagePending == 0)
+				{
+					acknowledgedMessageAttemptTime = millis();							//The time out starts once the last copy has gone
+				}
+				return true;
+			}
+		}
+	}
+	return false;
+}
+void treacleClass::finishAcknowledgedMessage(bool delivered)
+{
+	uint8_t handle = acknowledgedMessageHandle;
+	uint32_t latency = millis() - acknowledgedMessageQueueTime;
+	acknowledgedMessageHandle = 0;
+	acknowledgedMessagePending = 0;
+	#if defined(TREACLE_DEBUG)
+		debugPrint(treacleDebugString_treacleSpace);
+		debugPrint(treacleDebugString_acknowledged_application_data);
+		debugPrint(':');
+		debugPrint(handle);
+		debugPrint(' ');
+		debugPrint(delivered ? treacleDebugString_delivered : treacleDebugString_failed);
+		debugPrint(' ');
+		debugPrint(latency);
+		debugPrintln(treacleDebugString_ms);
+	#endif
+	if(deliveryCallback != nullptr)
+	{
+		deliveryCallback(handle, delivered, latency);
+	}
+}
+void treacleClass::buildAcknowledgedMessagePacket(uint8_t transportId)
+{
+	buildPacketHeader(transportId, acknowledgedMessageRecipient, payloadType::acknowledgedApplicationData, false);				//Set payloadType, this is not sent on a tick
+	transport[transportId].transmitBuffer[transport[transportId].transmitPacketSize++] = acknowledgedMessageHandle;				//Add the handle
+	memcpy(&transport[transportId].transmitBuffer[transport[transportId].transmitPacketSize], acknowledgedMessageData, acknowledgedMessageLength);	//Add the data
+	transport[transportId].transmitPacketSize += acknowledgedMessageLength;
+	transport[transportId].transmitBuffer[(uint8_t)headerPosition::packetLength] = transport[transportId].transmitPacketSize;	//Update packetLength field
+	processPacketBeforeTransmission(transportId);																				//Do CRC and encryption if needed
+}
+bool treacleClass::sendAcknowledgement()
+{
+	for(uint8_t transportId = 0; transportId < numberOfActiveTransports; transportId++)
+	{
+		if(transport[transportId].acknowledgement != nullptr &&
+			transport[transportId].acknowledgement->due == true &&
+			(int32_t)(millis() - transport[transportId].acknowledgement->time) >= 0 &&
+			packetInQueue(transportId) == false &&
+			transport[transportId].txStartTime == 0 &&
+			sendBackingOff(transportId) == false)
+		{
+			calculateDutyCycle(transportId);
+			if(dutyCycleAllowsTx(transportId))
+			{
+				transport[transportId].acknowledgement->due = false;
+				buildAcknowledgementPacket(transportId);
+				transport[transportId].bufferSent = true;
+				if(sendBuffer(transportId, transport[transportId].transmitBuffer, transport[transportId].transmitPacketSize))
+				{
+					#if defined(TREACLE_DEBUG)
+						debugPrint(treacleDebugString_treacleSpace);
+						debugPrintTransportName(transportId);
+						debugPrint(' ');
+						debugPrint(treacleDebugString_acknowledged_application_data_ack);
+						debugPrint(' ');
+						debugPrint(treacleDebugString_sent);
+						debugPrint(' ');
+						debugPrint(treacleDebugString_toSpace);
+						debugPrint(treacleDebugString_nodeId);
+						debugPrint(':');
+						debugPrintln(transport[transportId].acknowledgement->recipient);
+					#endif
+					return true;
+				}
+				else if(backOffAfterBusyChannel(transportId))
+				{
+					transport[transportId].acknowledgement->due = true;				//Try again after the backoff
+				}
+			}
+		}
+	}
+	return false;
+}
+void treacleClass::buildAcknowledgementPacket(uint8_t transportId)
+{
+	buildPacketHeader(transportId, transport[transportId].acknowledgement->recipient, payloadType::acknowledgedApplicationDataAck, false);	//Set payloadType, this is not sent on a tick
+	transport[transportId].transmitBuffer[transport[transportId].transmitPacketSize++] = transport[transportId].acknowledgement->handle;	//Add the handle
+	transport[transportId].transmitBuffer[(uint8_t)headerPosition::packetLength] = transport[transportId].transmitPacketSize;	//Update packetLength field
+	processPacketBeforeTransmission(transportId);																				//Do CRC and encryption if needed
+}
+void treacleClass::unpackAcknowledgedMessagePacket(uint8_t transportId, uint8_t senderId)
+{
+	uint8_t nodeIndex = nodeIndexFromId(senderId);
+	if(nodeIndex == maximumNumberOfNodes || receiveBuffer[(uint8_t)headerPosition::packetLength] <= (uint8_t)headerPosition::payload)
+	{
+		#if defined(TREACLE_DEBUG)
+			debugPrintln(treacleDebugString_dropped);
+		#endif
+		clearReceiveBuffer();
+		return;
+	}
+	uint8_t handle = receiveBuffer[(uint8_t)headerPosition::payload];
+	if(transport[transportId].acknowledgement == nullptr)
+	{
+		transport[transportId].acknowledgement = new acknowledgementTransportData;
+	}
+	transport[transportId].acknowledgement->due = true;				//Acknowledge it, even if it's a retransmission, as the last acknowledgement may have been lost
+	transport[transportId].acknowledgement->recipient = senderId;
+	transport[transportId].acknowledgement->handle = handle;
+	transport[transportId].acknowledgement->time = millis();
+	if(receiveBuffer[(uint8_t)headerPosition::recipient] == (uint8_t)nodeId::allNodes)
+	{
+		transport[transportId].acknowledgement->time += random(0, transport[transportId].minimumTick/4);	//Spread out the replies from every node
+	}
+	if(node[nodeIndex].lastAcknowledgedMessageHandle == handle)
+	{
+		#if defined(TREACLE_DEBUG)
+			debugPrintln(treacleDebugString_duplicate);
+		#endif
+		clearReceiveBuffer();										//Already delivered to the application
+		return;
+	}
+	node[nodeIndex].lastAcknowledgedMessageHandle = handle;
+	#if defined(TREACLE_DEBUG)
+		debugPrintln();
+	#endif
+	memmove(&receiveBuffer[(uint8_t)headerPosition::payload], &receiveBuffer[(uint8_t)headerPosition::payload + 1],
+		receiveBuffer[(uint8_t)headerPosition::packetLength] - (uint8_t)headerPosition::payload - 1);	//Remove the handle
+	receiveBuffer[(uint8_t)headerPosition::packetLength]--;
+	receiveBufferSize--;
+	receiveBuffer[(uint8_t)headerPosition::payloadType] = (uint8_t)payloadType::shortApplicationData;	//The application picks it up like any other message
+}
+void treacleClass::unpackAcknowledgementPacket(uint8_t transportId, uint8_t senderId)
+{
+	uint8_t nodeIndex = nodeIndexFromId(senderId);
+	if(acknowledgedMessageHandle != 0 && nodeIndex != maximumNumberOfNodes &&
+		receiveBuffer[(uint8_t)headerPosition::packetLength] > (uint8_t)headerPosition::payload &&
+		receiveBuffer[(uint8_t)headerPosition::payload] == acknowledgedMessageHandle)
+	{
+		if(acknowledgedMessageAttempts == 1 && transport[transportId].acknowledgement->sentTime != 0)
+		{
+			updateRoundTripTime(transportId, millis() - transport[transportId].acknowledgement->sentTime);	//Only first attempts give unambiguous round trip times
+		}
+		acknowledgedMessageAcked[nodeIndex/32] |= (0x00000001UL << (nodeIndex%32));
+		#if defined(TREACLE_DEBUG)
+			debugPrint(' ');
+			debugPrint(transport[transportId].acknowledgement->roundTripTime);
+			debugPrintln(treacleDebugString_ms);
+		#endif
+		if(countNodeBits(acknowledgedMessageAcked) >= acknowledgedMessageQuorum)
+		{
+			finishAcknowledgedMessage(true);
+		}
+		return;
+	}
+	#if defined(TREACLE_DEBUG)
+		debugPrintln();								//Stale or for another message
+	#endif
+}
+void treacleClass::updateRoundTripTime(uint8_t transportId, uint32_t sample)
+{
+	if(sample > 0xffff)
+	{
+		sample = 0xffff;
+	}
+	if(transport[transportId].acknowledgement->roundTripTime == 0)
+	{
+		transport[transportId].acknowledgement->roundTripTime = sample;															//First sample
+		transport[transportId].acknowledgement->roundTripTimeVariance = sample/2;
+	}
+	else
+	{
+		uint16_t difference = sample > transport[transportId].acknowledgement->roundTripTime ? sample - transport[transportId].acknowledgement->roundTripTime : transport[transportId].acknowledgement->roundTripTime - sample;
+		transport[transportId].acknowledgement->roundTripTimeVariance = (3 * (uint32_t)transport[transportId].acknowledgement->roundTripTimeVariance + difference)/4;	//Smooth as in TCP
+		transport[transportId].acknowledgement->roundTripTime = (7 * (uint32_t)transport[transportId].acknowledgement->roundTripTime + sample)/8;
+	}
+}
+uint32_t treacleClass::retransmissionTimeout(uint8_t transportId)
+{
+	if(transport[transportId].acknowledgement == nullptr || transport[transportId].acknowledgement->roundTripTime == 0)
+	{
+		return transport[transportId].minimumTick;																//No measurement yet, so be conservative
+	}
+	uint32_t timeout = transport[transportId].acknowledgement->roundTripTime + 4 * (uint32_t)transport[transportId].acknowledgement->roundTripTimeVariance;
+	if(timeout < minimumRetransmissionTimeout)
+	{
+		timeout = minimumRetransmissionTimeout;
+	}
+	return timeout;
+}
+/*
+ *
+ *	Relaying functions
+ *
+ */
+void treacleClass::enableRelaying(uint8_t hops, uint8_t suppression)
+{
+	relaying = true;
+	relayHops = hops;
+	relaySuppressionThreshold = suppression;
+	if(transport != nullptr)								//Otherwise this happens in begin()
+	{
+		allocateRelaying();
+	}
+}
+void treacleClass::disableRelaying()
+{
+	relaying = false;
+	relayHops = 0;
+	for(uint8_t transportId = 0; transportId < numberOfActiveTransports; transportId++)
+	{
+		if(transport[transportId].relay != nullptr)
+		{
+			transport[transportId].relay->length = 0;
+		}
+	}
+}
+uint32_t treacleClass::getRelayedPackets(uint8_t index)
+{
+	if(index < numberOfActiveTransports && transport[index].relay != nullptr)
+	{
+		return transport[index].relay->packets;
+	}
+	return 0;
+}
+uint32_t treacleClass::getRelaysSuppressed(uint8_t index)
+{
+	if(index < numberOfActiveTransports && transport[index].relay != nullptr)
+	{
+		return transport[index].relay->suppressed;
+	}
+	return 0;
+}
+bool treacleClass::relayPacketSeen(uint8_t origin, uint8_t originPayloadNumber)
+{
+	uint16_t key = (uint16_t)origin << 8 | originPayloadNumber;
+	for(uint8_t index = 0; index < relayHistorySize; index++)
+	{
+		if(relayHistory[index] == key)
+		{
+			return true;
+		}
+	}
+	relayHistory[relayHistoryIndex] = key;
+	relayHistoryIndex = (relayHistoryIndex + 1) % relayHistorySize;
+	return false;
+}
+void treacleClass::unpackRelayablePacket(uint8_t transportId)
+{
+	uint8_t payloadLength = receiveBuffer[(uint8_t)headerPosition::packetLength] - (uint8_t)headerPosition::payload;
+	uint8_t origin = receiveBuffer[(uint8_t)headerPosition::payload];
+	uint8_t originPayloadNumber = receiveBuffer[(uint8_t)headerPosition::payload + 1];
+	uint8_t hopsRemaining = receiveBuffer[(uint8_t)headerPosition::payload + 2];
+	if(payloadLength < relayHeaderSize || origin == currentNodeId)	//Invalid, or this node's own message coming back
+	{
+		#if defined(TREACLE_DEBUG)
+			debugPrintln(treacleDebugString_dropped);
+		#endif
+		clearReceiveBuffer();
+		return;
+	}
+	if(relayPacketSeen(origin, originPayloadNumber))				//Copies are dropped whichever transport they arrive on
+	{
+		if(transport[transportId].relay != nullptr &&
+			transport[transportId].relay->length > 0 &&
+			transport[transportId].relay->buffer[0] == origin &&
+			transport[transportId].relay->buffer[1] == originPayloadNumber &&
+			++transport[transportId].relay->copiesHeard >= relaySuppressionThreshold)
+		{
+			transport[transportId].relay->length = 0;				//Enough nodes have relayed it already
+			transport[transportId].relay->suppressed++;
+			#if defined(TREACLE_DEBUG)
+				debugPrint(treacleDebugString_relayed);
+				debugPrint(' ');
+				debugPrint(treacleDebugString_suppressed);
+				debugPrint(' ');
+			#endif
+		}
+		#if defined(TREACLE_DEBUG)
+			debugPrintln(treacleDebugString_duplicate);
+		#endif
+		clearReceiveBuffer();
+		return;
+	}
+	if(relaying == true && hopsRemaining > 0 && receiveBuffer[(uint8_t)headerPosition::recipient] == (uint8_t)nodeId::allNodes &&
+		transport[transportId].relay != nullptr && transport[transportId].relay->length == 0)	//Only one relay can wait at a time
+	{
+		memcpy(transport[transportId].relay->buffer, &receiveBuffer[(uint8_t)headerPosition::payload], payloadLength);
+		transport[transportId].relay->buffer[2] = hopsRemaining - 1;
+		transport[transportId].relay->length = payloadLength;
+		transport[transportId].relay->copiesHeard = 1;
+		transport[transportId].relay->time = millis() + random(0, transport[transportId].minimumTick/4);	//Spread out the relays from every node that heard it
+	}
+	#if defined(TREACLE_DEBUG)
+		debugPrint(' ');
+		debugPrint(treacleDebugString_fromSpace);
+		debugPrint(treacleDebugString_nodeId);
+		debugPrint(':');
+		debugPrintln(origin);
+	#endif
+	receiveBuffer[(uint8_t)headerPosition::sender] = origin;										//Present it to the application as a message from its origin
+	receiveBuffer[(uint8_t)headerPosition::payloadNumber] = originPayloadNumber;
+	memmove(&receiveBuffer[(uint8_t)headerPosition::payload], &receiveBuffer[(uint8_t)headerPosition::payload + relayHeaderSize],
+		payloadLength - relayHeaderSize);															//Remove the relay header
+	receiveBuffer[(uint8_t)headerPosition::packetLength] -= relayHeaderSize;
+	receiveBufferSize -= relayHeaderSize;
+	receiveBuffer[(uint8_t)headerPosition::payloadType] = (uint8_t)payloadType::shortApplicationData;
+}
+bool treacleClass::sendRelayedPacket()
+{
+	for(uint8_t transportId = 0; transportId < numberOfActiveTransports; transportId++)
+	{
+		if(transport[transportId].relay != nullptr &&
+			transport[transportId].relay->length > 0 &&
+			(int32_t)(millis() - transport[transportId].relay->time) >= 0 &&
+			packetInQueue(transportId) == false &&
+			transport[transportId].txStartTime == 0 &&
+			sendBackingOff(transportId) == false)
+		{
+			calculateDutyCycle(transportId);
+			if(dutyCycleAllowsTx(transportId, expectedTxTime(transportId, packetSizeOnAir(transportId, (uint8_t)headerPosition::payload + transport[transportId].relay->length))))
+			{
+				buildRelayedPacket(transportId);
+				uint8_t relayLength = transport[transportId].relay->length;
+				transport[transportId].relay->length = 0;
+				transport[transportId].bufferSent = true;
+				if(sendBuffer(transportId, transport[transportId].transmitBuffer, transport[transportId].transmitPacketSize))
+				{
+					transport[transportId].relay->packets++;
+					#if defined(TREACLE_DEBUG)
+						debugPrint(treacleDebugString_treacleSpace);
+						debugPrintTransportName(transportId);
+						debugPrint(' ');
+						debugPrint(treacleDebugString_relayable_application_data);
+						debugPrint(' ');
+						debugPrint(treacleDebugString_fromSpace);
+						debugPrint(treacleDebugString_nodeId);
+						debugPrint(':');
+						debugPrint(transport[transportId].relay->buffer[0]);
+						debugPrint(' ');
+						debugPrintln(treacleDebugString_relayed);
+					#endif
+					return true;
+				}
+				else if(backOffAfterBusyChannel(transportId))
+				{
+					transport[transportId].relay->length = relayLength;				//Try again after the backoff, still listening for copies
+				}
+			}
+		}
+	}
+	return false;
+}
+void treacleClass::allocateRelaying()
+{
+	for(uint8_t transportId = 0; transportId < numberOfActiveTransports; transportId++)
+	{
+		if(transport[transportId].relay == nullptr)
+		{
+			transport[transportId].relay = new relayTransportData;
+		}
+	}
+}
+void treacleClass::buildRelayedPacket(uint8_t transportId)
+{
+	buildPacketHeader(transportId, (uint8_t)nodeId::allNodes, payloadType::relayableApplicationData, false);					//Set payloadType, this is not sent on a tick
+	memcpy(&transport[transportId].transmitBuffer[transport[transportId].transmitPacketSize], transport[transportId].relay->buffer, transport[transportId].relay->length);	//Add the relay header and data
+	transport[transportId].transmitPacketSize += transport[transportId].relay->length;
+	transport[transportId].transmitBuffer[(uint8_t)headerPosition::packetLength] = transport[transportId].transmitPacketSize;	//Update packetLength field
+	processPacketBeforeTransmission(transportId);																				//Do CRC and encryption if needed
+}
+/*
+ *
+ *	Bridging functions
+ *
+ */
+uint8_t treacleClass::addBridge(uint8_t from, uint8_t to, uint16_t payloadTypes)
+{
+	if(numberOfBridges < maximumNumberOfBridges && from != to && from < numberOfActiveTransports && to < numberOfActiveTransports)
+	{
+		bridges[numberOfBridges].from = from;
+		bridges[numberOfBridges].to = to;
+		bridges[numberOfBridges].payloadTypes = (payloadTypes == 0 ? defaultBridgePayloadTypes : payloadTypes) & 0xfffe;	//Keepalives describe one link so are never forwarded
+		bridges[numberOfBridges].startTime = millis();
+		if(bridgeStagingBuffer == nullptr)
+		{
+			bridgeStagingBuffer = new uint8_t[maximumBufferSize];
+		}
+		numberOfBridges++;
+		if(transport != nullptr)							//Otherwise this happens in begin()
+		{
+			allocateBridging();
+		}
+		return numberOfBridges - 1;
+	}
+	return 255;
+}
+void treacleClass::allocateBridging()
+{
+	for(uint8_t bridgeIndex = 0; bridgeIndex < numberOfBridges; bridgeIndex++)
+	{
+		if(transport[bridges[bridgeIndex].to].bridge == nullptr)
+		{
+			transport[bridges[bridgeIndex].to].bridge = new bridgeTransportData;	//Only transports that are bridged to need somewhere to queue a packet
+		}
+	}
+}
+uint32_t treacleClass::getBridgedPackets(uint8_t bridgeIndex)
+{
+	if(bridgeIndex < numberOfBridges)
+	{
+		return bridges[bridgeIndex].packets;
+	}
+	return 0;
+}
+uint32_t treacleClass::getBridgedBytes(uint8_t bridgeIndex)
+{
+	if(bridgeIndex < numberOfBridges)
+	{
+		return bridges[bridgeIndex].bytes;
+	}
+	return 0;
+}
+uint32_t treacleClass::getBridgeDrops(uint8_t bridgeIndex)
+{
+	if(bridgeIndex < numberOfBridges)
+	{
+		return bridges[bridgeIndex].drops;
+	}
+	return 0;
+}
+uint32_t treacleClass::getBridgeThroughput(uint8_t bridgeIndex)
+{
+	if(bridgeIndex < numberOfBridges && millis() - bridges[bridgeIndex].startTime > 0)
+	{
+		return (uint64_t)bridges[bridgeIndex].bytes * 1000 / (millis() - bridges[bridgeIndex].startTime);
+	}
+	return 0;
+}
+bool treacleClass::unpackBridgeMarker()
+{
+	uint8_t packetSize = receiveBuffer[(uint8_t)headerPosition::packetLength] + 2;					//Checksum
+	if(receiveBuffer[(uint8_t)headerPosition::payloadType] & (uint8_t)payloadType::encrypted)
+	{
+		packetSize += (encryptionBlockSize - (packetSize - (uint8_t)headerPosition::blockIndex)%encryptionBlockSize)%encryptionBlockSize;	//Padding
+	}
+	if(receiveBufferSize == packetSize + 1 && receiveBuffer[packetSize] == bridgeMarker)
+	{
+		receiveBufferSize--;																		//Remove the marker, the packet is as the sender made it
+		return true;
+	}
+	return false;
+}
+void treacleClass::stagePacketForBridging()
+{
+	bridgeStagingSize = 0;
+	if(numberOfBridges > 0 && receiveBuffer[(uint8_t)headerPosition::recipient] == (uint8_t)nodeId::allNodes)	//Only packets for all nodes are forwarded
+	{
+		for(uint8_t bridgeIndex = 0; bridgeIndex < numberOfBridges; bridgeIndex++)
+		{
+			if(bridges[bridgeIndex].from == receiveTransport)
+			{
+				memcpy(bridgeStagingBuffer, receiveBuffer, receiveBufferSize);
+				bridgeStagingSize = receiveBufferSize;
+				return;
+			}
+		}
+	}
+}
+bool treacleClass::bridgePacket(bool fromBridge)
+{
+	if(receiveBuffer[(uint8_t)headerPosition::recipient] != (uint8_t)nodeId::allNodes ||			//Only packets for all nodes are forwarded
+		(receiveBuffer[(uint8_t)headerPosition::payloadType] & 0x0f) == (uint8_t)payloadType::keepalive)	//Keepalives describe one link so are never forwarded
+	{
+		return false;
+	}
+	uint32_t key = (uint32_t)receiveBuffer[(uint8_t)headerPosition::sender] << 24 |
+		(uint32_t)receiveBuffer[(uint8_t)headerPosition::payloadNumber] << 16 |
+		(uint32_t)receiveBuffer[(uint8_t)headerPosition::blockIndex] << 8 |
+		receiveBuffer[(uint8_t)headerPosition::blockIndex + 1];									//The block index is random for most packets, which makes this fairly unique
+	for(uint8_t index = 0; index < bridgeHistorySize; index++)								//A copy may arrive directly and through a bridge in either order
+	{
+		if(bridgeHistory[index] == key)
+		{
+			return true;
+		}
+	}
+	bridgeHistory[bridgeHistoryIndex] = key;
+	bridgeHistoryIndex = (bridgeHistoryIndex + 1) % bridgeHistorySize;
+	for(uint8_t bridgeIndex = 0; bridgeIndex < numberOfBridges; bridgeIndex++)
+	{
+		uint8_t to = bridges[bridgeIndex].to;
+		if(bridges[bridgeIndex].from == receiveTransport &&
+			(bridges[bridgeIndex].payloadTypes & (0x0001 << (receiveBuffer[(uint8_t)headerPosition::payloadType] & 0x0f))))
+		{
+			if(transport[to].initialised == false || transport[to].bridge == nullptr || transport[to].bridge->length > 0)	//Only one packet can wait at a time
+			{
+				bridges[bridgeIndex].drops++;
+				continue;
+			}
+			uint8_t packetSize = 0;
+			if(transport[receiveTransport].encrypted == transport[to].encrypted && bridgeStagingSize > 0)
+			{
+				packetSize = bridgeStagingSize;
+				memcpy(transport[to].bridge->buffer, bridgeStagingBuffer, packetSize);		//Forward it exactly as it arrived, the key is shared
+			}
+			else
+			{
+				packetSize = receiveBuffer[(uint8_t)headerPosition::packetLength];
+				memcpy(transport[to].bridge->buffer, receiveBuffer, packetSize);					//Start from the decrypted packet
+				appendChecksumToPacket(transport[to].bridge->buffer, packetSize);
+				if(transport[to].encrypted == true)
+				{
+					encryptPayload(transport[to].bridge->buffer, packetSize);
+				}
+			}
+			if(packetSize < maximumBufferSize)
+			{
+				transport[to].bridge->buffer[packetSize++] = bridgeMarker;					//Mark it so receivers don't take it as coming directly from the sender, a full size packet relies on the history alone
+			}
+			transport[to].bridge->length = packetSize;
+			transport[to].bridge->index = bridgeIndex;
+		}
+	}
+	return false;
+}
+bool treacleClass::sendBridgedPacket()
+{
+	for(uint8_t transportId = 0; transportId < numberOfActiveTransports; transportId++)
+	{
+		if(transport[transportId].bridge != nullptr &&
+			transport[transportId].bridge->length > 0 &&
+			packetInQueue(transportId) == false &&
+			transport[transportId].txStartTime == 0 &&
+			sendBackingOff(transportId) == false)
+		{
+			calculateDutyCycle(transportId);
+			if(dutyCycleAllowsTx(transportId, expectedTxTime(transportId, transport[transportId].bridge->length)))
+			{
+				uint8_t packetSize = transport[transportId].bridge->length;
+				transport[transportId].bridge->length = 0;
+				if(sendBuffer(transportId, transport[transportId].bridge->buffer, packetSize))
+				{
+					bridges[transport[transportId].bridge->index].packets++;
+					bridges[transport[transportId].bridge->index].bytes += packetSize;
+					#if defined(TREACLE_DEBUG)
+						debugPrint(treacleDebugString_treacleSpace);
+						debugPrintTransportName(bridges[transport[transportId].bridge->index].from);
+						debugPrint("->");
+						debugPrintTransportName(transportId);
+						debugPrint(' ');
+						debugPrint(packetSize);
+						debugPrint(' ');
+						debugPrint(treacleDebugString_bytes);
+						debugPrint(' ');
+						debugPrintln(treacleDebugString_bridged);
+					#endif
+				}
+				else if(backOffAfterBusyChannel(transportId))
+				{
+					transport[transportId].bridge->length = packetSize;				//Try again after the backoff
+				}
+				else
+				{
+					bridges[transport[transportId].bridge->index].drops++;
+				}
+				return true;
+			}
+		}
+	}
+	return false;
+}
+/*
+ *
+ *	Time synchronisation functions
+ *
+ */
+void treacleClass::enableTimeSync()
+{
+	if(timeSync == false)
+	{
+		timeSync = true;
+		timeSyncReference = currentNodeId;									//Start as the reference until a node with a lower ID is heard
+		timeSyncParent = currentNodeId;
+		timeSyncSamples = 0;
+	}
+}
+void treacleClass::disableTimeSync()
+{
+	timeSync = false;
+}
+uint32_t treacleClass::networkMillis()
+{
+	uint32_t now = millis();
+	return now + timeSyncOffset + (int32_t)(timeSyncDrift * (int32_t)(now - timeSyncLastSample));
+}
+uint16_t treacleClass::networkTimeAccuracy()
+{
+	if(timeSync == false)
+	{
+		return 0xffff;
+	}
+	checkTimeSyncReference();
+	if(timeSyncReference == currentNodeId)
+	{
+		return 0;															//This node's clock is the network time
+	}
+	else if(timeSyncSamples == 0)
+	{
+		return 0xffff;
+	}
+	uint32_t accuracy = (uint32_t)timeSyncParentAccuracy + timeSyncJitter + 1 +
+		(millis() - timeSyncLastSample)/10000;								//Allow for 100ppm of drift since the last sample
+	return accuracy < 0xffff ? accuracy : 0xfffe;
+}
+bool treacleClass::networkTimeSynchronised()
+{
+	if(timeSync == true)
+	{
+		checkTimeSyncReference();
+		return timeSyncReference == currentNodeId || timeSyncSamples > 1;	//Drift is only known after two samples
+	}
+	return false;
+}
+uint8_t treacleClass::getTimeReference()
+{
+	if(timeSync == true)
+	{
+		checkTimeSyncReference();
+		return timeSyncReference;
+	}
+	return (uint8_t)nodeId::unknownNode;
+}
+void treacleClass::checkTimeSyncReference()
+{
+	if(currentNodeId == (uint8_t)nodeId::unknownNode || timeSyncReference == currentNodeId)
+	{
+		return;
+	}
+	if(timeSyncReference == (uint8_t)nodeId::unknownNode ||
+		currentNodeId < timeSyncReference ||
+		millis() - timeSyncLastSample > 3 * (uint32_t)maximumTickTime ||		//The neighbour has gone quiet
+		millis() - timeSyncReferenceHeard > timeSyncMaximumAge * 1000UL)	//The reference has gone, even if neighbours are still passing on its time
+	{
+		timeSyncOffset = networkMillis() - millis();						//Carry on from the current network time, so it doesn't jump
+		timeSyncLastMeasuredOffset = timeSyncOffset;
+		timeSyncDrift = 0;
+		timeSyncLastSample = millis();
+		timeSyncReference = currentNodeId;
+		timeSyncParent = currentNodeId;
+		timeSyncSamples = 0;
+		timeSyncJitter = 0;
+	}
+}
+void treacleClass::addTimeSyncToPacket(uint8_t transportId)
+{
+	if(timeSync == true && currentNodeId != (uint8_t)nodeId::unknownNode &&
+		transport[transportId].transmitPacketSize + timeSyncSize <= maximumPayloadSize)
+	{
+		checkTimeSyncReference();
+		uint32_t now = networkMillis();
+		uint16_t accuracy = networkTimeAccuracy();
+		transport[transportId].transmitBuffer[transport[transportId].transmitPacketSize++] = timeSyncReference;
+		transport[transportId].transmitBuffer[transport[transportId].transmitPacketSize++] = (now & 0xff000000) >> 24;
+		transport[transportId].transmitBuffer[transport[transportId].transmitPacketSize++] = (now & 0x00ff0000) >> 16;
+		transport[transportId].transmitBuffer[transport[transportId].transmitPacketSize++] = (now & 0x0000ff00) >> 8;
+		transport[transportId].transmitBuffer[transport[transportId].transmitPacketSize++] = (now & 0x000000ff);
+		transport[transportId].transmitBuffer[transport[transportId].transmitPacketSize++] = (accuracy & 0xff00) >> 8;
+		transport[transportId].transmitBuffer[transport[transportId].transmitPacketSize++] = (accuracy & 0x00ff);
+		uint32_t age = timeSyncReference == currentNodeId ? 0 : (millis() - timeSyncReferenceHeard + 999)/1000;	//Rounded up, so passing it round a loop of nodes only ever makes it older
+		transport[transportId].transmitBuffer[transport[transportId].transmitPacketSize++] = age < 255 ? age : 255;
+		transport[transportId].transmitBuffer[(uint8_t)headerPosition::payloadType] |= (uint8_t)payloadType::timeSync;	//Flag the time at the end of the payload
+	}
+}
+void treacleClass::unpackTimeSync(uint8_t nodeIndex)
+{
+	receiveBuffer[(uint8_t)headerPosition::payloadType] &= (0xff ^ (uint8_t)payloadType::timeSync);	//Remove the flag, whatever happens the rest of the packet is handled as normal
+	uint8_t packetLength = receiveBuffer[(uint8_t)headerPosition::packetLength];
+	if(packetLength < (uint8_t)headerPosition::payload + timeSyncSize)
+	{
+		return;
+	}
+	packetLength -= timeSyncSize;
+	receiveBuffer[(uint8_t)headerPosition::packetLength] = packetLength;		//Remove the time from the payload
+	if(timeSync == false || currentNodeId == (uint8_t)nodeId::unknownNode)
+	{
+		return;
+	}
+	uint8_t reference = receiveBuffer[packetLength];
+	uint32_t senderTime = ((uint32_t)receiveBuffer[packetLength + 1]) << 24 |
+		((uint32_t)receiveBuffer[packetLength + 2]) << 16 |
+		((uint32_t)receiveBuffer[packetLength + 3]) << 8 |
+		((uint32_t)receiveBuffer[packetLength + 4]);
+	uint16_t senderAccuracy = ((uint16_t)receiveBuffer[packetLength + 5]) << 8 | receiveBuffer[packetLength + 6];
+	uint8_t referenceAge = receiveBuffer[packetLength + 7];
+	uint8_t senderId = node[nodeIndex].id;
+	if(reference == (uint8_t)nodeId::unknownNode || reference >= currentNodeId || senderAccuracy == 0xffff || referenceAge >= timeSyncMaximumAge)
+	{
+		return;																	//This node has a better claim to be the reference, the sender isn't synchronised or its reference has gone
+	}
+	uint32_t now = millis();
+	uint32_t referenceHeard = now - referenceAge * 1000UL;
+	senderTime += expectedTxTime(receiveTransport, receiveBufferSize)/1000;	//Allow for the time on air
+	int32_t measuredOffset = (int32_t)(senderTime - now);
+	checkTimeSyncReference();
+	if(reference == timeSyncReference && (int32_t)(referenceHeard - timeSyncReferenceHeard) > 0)
+	{
+		timeSyncReferenceHeard = referenceHeard;									//Any neighbour can show the reference is still there
+	}
+	if(reference < timeSyncReference ||																			//A better reference
+		(senderId == timeSyncParent && reference != timeSyncReference) ||										//The neighbour has changed reference, follow it
+		(reference == timeSyncReference && senderId != timeSyncParent &&
+			(uint32_t)senderAccuracy + timeSyncJitter + 1 < timeSyncParentAccuracy))							//A neighbour clearly closer to the reference
+	{
+		timeSyncReference = reference;
+		timeSyncReferenceHeard = referenceHeard;
+		timeSyncParent = senderId;
+		timeSyncOffset = measuredOffset;
+		timeSyncLastMeasuredOffset = measuredOffset;
+		timeSyncDrift = 0;
+		timeSyncLastSample = now;
+		timeSyncJitter = 0;
+		timeSyncSamples = 1;
+	}
+	else if(reference == timeSyncReference && senderId == timeSyncParent)
+	{
+		int32_t elapsed = now - timeSyncLastSample;
+		int32_t predictedOffset = timeSyncOffset + (int32_t)(timeSyncDrift * elapsed);
+		int32_t error = measuredOffset - predictedOffset;
+		if(error > (int32_t)maximumTickTime || error < -(int32_t)maximumTickTime)	//The neighbour's time has jumped, start again
+		{
+			timeSyncOffset = measuredOffset;
+			timeSyncDrift = 0;
+			timeSyncJitter = 0;
+			timeSyncSamples = 1;
+		}
+		else
+		{
+			if(elapsed > 0)
+			{
+				float driftSample = (float)(measuredOffset - timeSyncLastMeasuredOffset) / elapsed;
+				timeSyncDrift = timeSyncSamples == 1 ? driftSample : (timeSyncDrift * 3 + driftSample) / 4;	//Smooth the drift between neighbouring samples
+			}
+			timeSyncOffset = predictedOffset + error/2;														//Move halfway to the new sample
+			timeSyncJitter = (timeSyncJitter * 3 + (uint16_t)(error < 0 ? -error : error)) / 4;
+			if(timeSyncSamples < 255)
+			{
+				timeSyncSamples++;
+			}
+		}
+		timeSyncLastMeasuredOffset = measuredOffset;
+		timeSyncLastSample = now;
+	}
+	else
+	{
+		return;																	//Not a neighbour this node follows
+	}
+	timeSyncParentAccuracy = senderAccuracy;
+	#if defined(TREACLE_DEBUG)
+		debugPrint(treacleDebugString_network_time);
+		debugPrint(':');
+		debugPrint(timeSyncOffset);
+		debugPrint(' ');
+		debugPrint(networkTimeAccuracy());
+		debugPrint(treacleDebugString_ms);
+		debugPrint(' ');
+	#endif
+}
+void treacleClass::unpackLoRaSlots(uint8_t nodeIndex)
+{
+	receiveBuffer[(uint8_t)headerPosition::payloadType] &= (0xff ^ (uint8_t)payloadType::loRaSlots);	//Remove the flag, whatever happens the rest of the packet is handled as normal
+	uint8_t packetLength = receiveBuffer[(uint8_t)headerPosition::packetLength];
+	if(packetLength < (uint8_t)headerPosition::payload + 2)
+	{
+		return;
+	}
+	uint8_t numberOfNeighbours = receiveBuffer[packetLength - 2];
+	uint8_t slotsSize = 2 + 2 * numberOfNeighbours;
+	if(packetLength < (uint8_t)headerPosition::payload + slotsSize)
+	{
+		return;
+	}
+	packetLength -= slotsSize;
+	#if defined(TREACLE_SUPPORT_LORA)
+		if(receiveTransport == loRaTransportId)
+		{
+			recordLoRaSlots(nodeIndex, packetLength, numberOfNeighbours);
+		}
+	#endif
+	receiveBuffer[(uint8_t)headerPosition::packetLength] = packetLength;		//Remove the slots from the payload
+}
+void treacleClass::unpackLoRaLinkData(uint8_t nodeIndex)
+{
+	receiveBuffer[(uint8_t)headerPosition::payloadType] &= (0xff ^ (uint8_t)payloadType::loRaLinkData);	//Remove the flag, whatever happens the rest of the packet is handled as normal
+	uint8_t packetLength = receiveBuffer[(uint8_t)headerPosition::packetLength];
+	if(packetLength < (uint8_t)headerPosition::payload + 7)
+	{
+		return;
+	}
+	uint8_t numberOfNeighbours = receiveBuffer[packetLength - 7];
+	uint8_t linkDataSize = 7 + 2 * numberOfNeighbours;
+	if(packetLength < (uint8_t)headerPosition::payload + linkDataSize)
+	{
+		return;
+	}
+	packetLength -= linkDataSize;
+	#if defined(TREACLE_SUPPORT_LORA)
+		if(receiveTransport == loRaTransportId)
+		{
+			recordLoRaLinkData(nodeIndex, packetLength, numberOfNeighbours);
+		}
+	#endif
+	receiveBuffer[(uint8_t)headerPosition::packetLength] = packetLength;		//Remove the link data from the payload
+}
+/*
+ *
+ *	Large message functions
+ *
+ */
+bool treacleClass::queueLargeMessage(uint8_t* data, uint32_t length, bool acknowledged)
+{
+	if(transport == nullptr || largeMessageInProgress() == true || length == 0 || length > 0xffffff)	//Only one at a time and the offset is 24-bit
+	{
+		return false;
+	}
+	uint32_t nodeReached[nodeBitmaskSize] = {};	//Used to track which nodes _should_ have been reached, in transport priority order and avoid sending using lower priority transports, if possible
+	uint8_t numberOfNodesReached = 0;
+	uint32_t fragments = largeMessageFragments(length);
+	for (uint8_t transportId = 0; transportId < numberOfActiveTransports; transportId++)
+	{
+		if(transport[transportId].largeMessage != nullptr)
+		{
+			finishLargeMessage(transportId);						//Clear up after any previous message
+			transport[transportId].largeMessage->fragmentsPending = 0;
+			transport[transportId].largeMessage->retransmissions = 0;
+			memset(transport[transportId].largeMessage->delivered, 0, sizeof(transport[transportId].largeMessage->delivered));
+		}
+	}
+	largeMessageData = data;
+	largeMessageLength = length;
+	largeMessageAcknowledged = acknowledged;
+	largeMessageId++;
+	for (uint8_t transportId = 0; transportId < numberOfActiveTransports; transportId++)
+	{
+		if(transport[transportId].initialised == true)
+		{
+			if(transport[transportId].largeMessage == nullptr)
+			{
+				transport[transportId].largeMessage = new largeMessageTransportData;
+			}
+			transport[transportId].largeMessage->pending = new (std::nothrow) uint8_t[(fragments + 7)/8];	//The message can be large, so allow for the bitmap not fitting in memory
+			if(transport[transportId].largeMessage->pending == nullptr)
+			{
+				continue;
+			}
+			memset(transport[transportId].largeMessage->pending, 0xff, (fragments + 7)/8);		//Everything is to be sent, surplus bits past the end are never looked at
+			transport[transportId].largeMessage->fragmentsPending = fragments;
+			transport[transportId].largeMessage->highestSent = 0;
+			transport[transportId].largeMessage->inFlight = 0;
+			transport[transportId].largeMessage->awaitingAck = false;
+			transport[transportId].largeMessage->ackRetries = 0;
+			transport[transportId].largeMessage->startTime = millis();
+			transport[transportId].largeMessage->lastSent = millis();
+			memcpy(transport[transportId].largeMessage->receivers, transport[transportId].reachableNodes, sizeof(transport[transportId].largeMessage->receivers));	//Nodes online now are expected to acknowledge
+			transport[transportId].largeMessage->sending = true;
+			for(uint8_t word = 0; word < nodeBitmaskSize; word++)
+			{
+				nodeReached[word] |= transport[transportId].reachableNodes[word];
 			}
-			else
+			numberOfNodesReached = countNodeBits(nodeReached);
+			if(numberOfNodesReached == numberOfNodes)
 			{
-				mqtt->loop();
+				break;	//We have almost certainly reached all the nodes with this transport, do not send the message over lower priority (or higher cost) transports
 			}
 		}
+	}
+	if(largeMessageInProgress() == false)
+	{
+		largeMessageData = nullptr;	//No transports are available
+		return false;
+	}
+	#if defined(TREACLE_DEBUG)
+		debugPrint(treacleDebugString_treacleSpace);
+		debugPrint(treacleDebugString_large_application_data);
+		debugPrint(' ');
+		debugPrint(largeMessageLength);
+		debugPrint(' ');
+		debugPrintln(treacleDebugString_bytes);
 	#endif
-	#if defined(TREACLE_SUPPORT_LORA)
-		if(loRaTransportId != 255 && transport[loRaTransportId].initialised == true && loRaIrqPin == -1)	//Polling method for loRa packets, must be enabled and initialised
+	return true;
+}
+bool treacleClass::sendLargeMessageFragment()
+{
+	if(largeMessageData == nullptr || currentState == state::selectingId)
+	{
+		return false;
+	}
+	for(uint8_t transportId = 0; transportId < numberOfActiveTransports; transportId++)
+	{
+		if(transport[transportId].largeMessage != nullptr && transport[transportId].largeMessage->sending == true)
 		{
-			receiveLoRa();
+			if(transport[transportId].largeMessage->awaitingAck == true)
+			{
+				checkLargeMessageAcks(transportId);
+			}
+			else if(transport[transportId].largeMessage->fragmentsPending > 0 &&
+				packetInQueue(transportId) == false &&			//Anything the application queued goes first, on the next tick
+				transport[transportId].txStartTime == 0 &&		//Not still sending the previous fragment
+				sendBackingOff(transportId) == false)
+			{
+				uint32_t fragmentIndex = nextPendingLargeMessageFragment(transportId);
+				uint8_t packetSize = packetSizeOnAir(transportId, (uint8_t)headerPosition::payload + largeMessageFragmentHeaderSize + largeMessageFragmentLength(largeMessageLength, fragmentIndex));	//Work out the size before building to avoid encrypting fragments that can't be sent yet
+				calculateDutyCycle(transportId);
+				if(dutyCycleAllowsTx(transportId, expectedTxTime(transportId, packetSize)))
+				{
+					bool ackRequest = largeMessageAcknowledged == true &&
+						countNodeBits(transport[transportId].largeMessage->receivers) > 0 &&		//Somebody is expected to acknowledge
+						(transport[transportId].largeMessage->inFlight + 1 >= largeMessageWindowSize(transportId, packetSize) ||	//End of the window
+						transport[transportId].largeMessage->fragmentsPending == 1);				//Or the last fragment to send
+					buildLargeMessageFragmentPacket(transportId, fragmentIndex, ackRequest);
+					transport[transportId].bufferSent = true;	//Whatever happens this packet is done with, a failed fragment is rebuilt and sent again
+					bool held = false;
+					#if defined(TREACLE_ESPNOW_LARGE_FRAMES)
+						if(transportId == espNowTransportId && ackRequest == false &&
+							transport[transportId].largeMessage->fragmentsPending > 1 && espNowLargeFramesUsable())
+						{
+							held = addToEspNowFrame(transport[transportId].transmitBuffer, transport[transportId].transmitPacketSize);	//Sent with the fragments after it in one large frame
+						}
+					#endif
+					if(held == true || sendBuffer(transportId, transport[transportId].transmitBuffer, transport[transportId].transmitPacketSize))
+					{
+						transport[transportId].largeMessage->pending[fragmentIndex/8] &= ~(0x01 << (fragmentIndex%8));
+						transport[transportId].largeMessage->fragmentsPending--;
+						transport[transportId].largeMessage->inFlight++;
+						transport[transportId].largeMessage->lastFragmentSent = fragmentIndex;
+						transport[transportId].largeMessage->lastSent = millis();
+						if(fragmentIndex >= transport[transportId].largeMessage->highestSent)
+						{
+							transport[transportId].largeMessage->highestSent = fragmentIndex + 1;
+						}
+						if(ackRequest == true)
+						{
+							transport[transportId].largeMessage->awaitingAck = true;
+							transport[transportId].largeMessage->ackRequestTime = millis();
+							transport[transportId].largeMessage->lossInWindow = false;
+							memset(transport[transportId].largeMessage->responded, 0, sizeof(transport[transportId].largeMessage->responded));
+						}
+						else if(transport[transportId].largeMessage->fragmentsPending == 0)
+						{
+							finishLargeMessage(transportId);	//Unacknowledged, so this is the end
+						}
+						return true;
+					}
+					backOffAfterBusyChannel(transportId);		//The fragment stays pending
+				}
+			}
 		}
-	#endif
-	#if defined(TREACLE_SUPPORT_UDP) && (defined(ESP8266) || defined(AVR))
-		if(UDPTransportId != 255 && transport[UDPTransportId].initialised == true)	//Polling method for UDP packets, must be enabled and initialised
+	}
+	#if defined(TREACLE_ESPNOW_LARGE_FRAMES)
+		if(espNowTxFrameLength > 0)
 		{
-			receiveUDP();
+			sendEspNowFrame();									//Nothing more is going in the large frame for now
 		}
 	#endif
-	#if defined(TREACLE_SUPPORT_COBS)
-		if(cobsTransportId != 255 && transport[cobsTransportId].initialised == true)	//Polling method for COBS packets, must be enabled and initialised
+	return false;
+}
+void treacleClass::checkLargeMessageAcks(uint8_t transportId)
+{
+	bool allResponded = true;
+	for(uint8_t word = 0; word < nodeBitmaskSize; word++)
+	{
+		if((transport[transportId].largeMessage->receivers[word] & ~transport[transportId].largeMessage->responded[word]) != 0)
 		{
-			receiveCobs();
+			allResponded = false;
 		}
-	#endif
-	if(currentState == state::uninitialised || currentState == state::starting || currentState == state::stopped)
+	}
+	if(allResponded == false && millis() - transport[transportId].largeMessage->ackRequestTime < transport[transportId].minimumTick)	//Wait up to the minimum tick for acknowledgements
 	{
-		return 0;						//Nothing can be sent or received in these states
+		return;
 	}
-	else if(packetReceived() && receiveBufferCrcChecked == false)	//Only unpack a packet once
+	transport[transportId].largeMessage->awaitingAck = false;
+	transport[transportId].largeMessage->inFlight = 0;
+	if(transport[transportId].largeMessage->lossInWindow == true)				//Multiplicative decrease on loss
 	{
-		unpackPacket();					//Handle unpacking of an incoming packet
+		transport[transportId].largeMessage->window = transport[transportId].largeMessage->window > 1 ? transport[transportId].largeMessage->window/2 : 1;
 	}
-	else if(sendPacketOnTick() == true)	//Send a packet if it needs to happen now
+	else if(allResponded == true)											//Additive increase on a clean window
 	{
-		return 0;						//A tick has been sent, so the application can wait until next time for any data
+		transport[transportId].largeMessage->window = transport[transportId].largeMessage->window + 2 < largeMessageMaximumWindow ? transport[transportId].largeMessage->window + 2 : largeMessageMaximumWindow;
 	}
-	timeOutTicks();						//Potentially time out ticks from other nodes if they are not responding or the application is slow calling this
-	if(currentState == state::selectingId)
+	if(allResponded == true)
 	{
-		if(applicationDataPacketReceived())
-		{
-			clearReceiveBuffer();		//Any incoming application data is binned in this state
-		}
-		else if(millis() - lastStateChange > maximumTickTime)
+		transport[transportId].largeMessage->ackRetries = 0;
+	}
+	else
+	{
+		transport[transportId].largeMessage->ackRetries++;
+	}
+	if(transport[transportId].largeMessage->fragmentsPending == 0)
+	{
+		bool allDelivered = true;
+		for(uint8_t word = 0; word < nodeBitmaskSize; word++)
 		{
-			if(selectNodeId())
-			{
-				changeCurrentState(state::selectedId);	//Need to inform other nodes of this node's presence
-			}
-			else
+			if((transport[transportId].largeMessage->receivers[word] & ~transport[transportId].largeMessage->delivered[word]) != 0)
 			{
-				changeCurrentState(state::stopped);		//Nothing can be sent or received
+				allDelivered = false;
 			}
 		}
-		return 0;	//Nothing can be sent or received, only IDs collected
-	}
-	else if(currentState == state::selectedId || currentState == state::online || currentState == state::offline)	//Normal active states
-	{
-		if(applicationDataPacketReceived() && receiveBufferCrcChecked == true)
+		if(allDelivered == true || transport[transportId].largeMessage->ackRetries > largeMessageMaximumAckRetries)	//Done, or give up on receivers that don't reply
 		{
-			return receiveBuffer[(uint8_t)headerPosition::packetLength] - (uint8_t)headerPosition::payload;
+			#if defined(TREACLE_DEBUG)
+				debugPrint(treacleDebugString_treacleSpace);
+				debugPrintTransportName(transportId);
+				debugPrint(' ');
+				debugPrint(treacleDebugString_large_application_data);
+				debugPrint(' ');
+				debugPrint(allDelivered ? treacleDebugString_complete : treacleDebugString_abandoned);
+				debugPrint(' ');
+				debugPrint(getLargeMessageThroughput(transportId));
+				debugPrintln(F("B/s"));
+			#endif
+			finishLargeMessage(transportId);
+		}
+		else
+		{
+			uint32_t fragmentIndex = transport[transportId].largeMessage->lastFragmentSent;	//Send the last fragment again, to ask for acknowledgement again
+			transport[transportId].largeMessage->pending[fragmentIndex/8] |= (0x01 << (fragmentIndex%8));
+			transport[transportId].largeMessage->fragmentsPending++;
 		}
 	}
-	return 0;
 }
-void treacleClass::clearWaitingMessage()
+void treacleClass::finishLargeMessage(uint8_t transportId)
 {
-	clearReceiveBuffer();
-	#if defined(TREACLE_DEBUG)
-		debugPrint(treacleDebugString_treacleSpace);
-		debugPrint(treacleDebugString_message);
-		debugPrint(' ');
-		debugPrintln(treacleDebugString_cleared);
-	#endif
+	if(transport[transportId].largeMessage != nullptr)
+	{
+		transport[transportId].largeMessage->sending = false;
+		transport[transportId].largeMessage->awaitingAck = false;
+		if(transport[transportId].largeMessage->pending != nullptr)
+		{
+			delete[] transport[transportId].largeMessage->pending;
+			transport[transportId].largeMessage->pending = nullptr;
+		}
+	}
+	if(largeMessageInProgress() == false)
+	{
+		largeMessageData = nullptr;	//Hand the data back to the application
+	}
 }
-void treacleClass::calculateNumberOfReachableNodes()
+uint32_t treacleClass::nextPendingLargeMessageFragment(uint8_t transportId)
 {
-	uint8_t startingNumber = numberOfReachableNodes;
-	bool nodeReachable[numberOfNodes] = {};	//Used to track which nodes _can_ have be reached, in transport priority order
-	numberOfReachableNodes = 0;
-	//Iterate ALL options to get the total reachable nodes
-	for (uint8_t transportId = 0; transportId < numberOfActiveTransports; transportId++)
+	uint32_t fragments = largeMessageFragments(largeMessageLength);
+	for(uint32_t bitmapByte = 0; bitmapByte < (fragments + 7)/8; bitmapByte++)
 	{
-		if(transport[transportId].initialised == true)	//It's initialised
+		if(transport[transportId].largeMessage->pending[bitmapByte] != 0)	//Skip whole bytes of sent fragments
 		{
-			for(uint8_t nodeIndex = 0; nodeIndex < numberOfNodes; nodeIndex++)
+			for(uint8_t bit = 0; bit < 8; bit++)
 			{
-				if(nodeReachable[nodeIndex] == false)
+				if(transport[transportId].largeMessage->pending[bitmapByte] & (0x01 << bit))
 				{
-					if(online(nodeIndex, transportId))
-					{
-						nodeReachable[nodeIndex] = true;
-						numberOfReachableNodes++;
-					}
+					return bitmapByte*8 + bit;
 				}
 			}
 		}
 	}
-	if(numberOfReachableNodes != startingNumber)
+	return fragments;
+}
+uint8_t treacleClass::largeMessageFragmentLength(uint32_t length, uint32_t fragmentIndex)
+{
+	uint32_t remaining = length - fragmentIndex * largeMessageFragmentSize;
+	return remaining < largeMessageFragmentSize ? remaining : largeMessageFragmentSize;
+}
+uint8_t treacleClass::largeMessageWindowSize(uint8_t transportId, uint8_t packetSize)
+{
+	uint8_t window = transport[transportId].largeMessage->window;
+	uint32_t fragmentTxTime = expectedTxTime(transportId, packetSize);
+	if(fragmentTxTime > 0 && airtimeTokenBucketSize(transportId) / fragmentTxTime < window)	//Don't ask for more than the duty cycle can send in one go, or the acknowledgements will time out
 	{
-		numberOfReachableNodesChanged = true;													//Inform the application
+		window = airtimeTokenBucketSize(transportId) / fragmentTxTime > 0 ? airtimeTokenBucketSize(transportId) / fragmentTxTime : 1;
 	}
+	return window;
 }
-
-uint32_t treacleClass::suggestedQueueInterval()
+bool treacleClass::sendLargeMessageAck()
 {
-	uint8_t numberOfNodesReached = 0;
-	if(numberOfActiveTransports > 1)
+	for(uint8_t transportId = 0; transportId < numberOfActiveTransports; transportId++)
 	{
-		bool nodeReached[numberOfNodes] = {};	//Used to track which nodes _should_ have been reached, in transport priority order and avoid sending using lower priority transports, if possible
-		//Iterate and stop once the nodes _should_ all be reachable to determine a reasonable queue interval
-		for (uint8_t transportId = 0; transportId < numberOfActiveTransports; transportId++)
+		if(transport[transportId].largeMessage != nullptr &&
+			transport[transportId].largeMessage->ackDue == true &&
+			(int32_t)(millis() - transport[transportId].largeMessage->ackTime) >= 0 &&
+			packetInQueue(transportId) == false &&
+			sendBackingOff(transportId) == false)
 		{
-			if(transport[transportId].initialised == true)	//It's initialised
+			calculateDutyCycle(transportId);
+			if(dutyCycleAllowsTx(transportId))
 			{
-				for(uint8_t nodeIndex = 0; nodeIndex < numberOfNodes; nodeIndex++)
+				transport[transportId].largeMessage->ackDue = false;
+				if(buildLargeMessageAckPacket(transportId))
 				{
-					if(nodeReached[nodeIndex] == false)
+					transport[transportId].bufferSent = true;
+					if(sendBuffer(transportId, transport[transportId].transmitBuffer, transport[transportId].transmitPacketSize))
 					{
-						if(online(nodeIndex, transportId))
-						{
-							nodeReached[nodeIndex] = true;
-							numberOfNodesReached++;
-						}
+						#if defined(TREACLE_DEBUG)
+							debugPrint(treacleDebugString_treacleSpace);
+							debugPrintTransportName(transportId);
+							debugPrint(' ');
+							debugPrint(treacleDebugString_large_application_data_ack);
+							debugPrint(' ');
+							debugPrint(treacleDebugString_sent);
+							debugPrint(' ');
+							debugPrint(treacleDebugString_toSpace);
+							debugPrint(treacleDebugString_nodeId);
+							debugPrint(':');
+							debugPrintln(transport[transportId].largeMessage->ackRecipient);
+						#endif
+						return true;
+					}
+					else if(backOffAfterBusyChannel(transportId))
+					{
+						transport[transportId].largeMessage->ackDue = true;			//Try again after the backoff
 					}
 				}
 			}
-			if(numberOfNodesReached == numberOfReachableNodes)
+		}
+	}
+	return false;
+}
+bool treacleClass::largeMessageInProgress()
+{
+	if(largeMessageData != nullptr)
+	{
+		for(uint8_t transportId = 0; transportId < numberOfActiveTransports; transportId++)
+		{
+			if(transport[transportId].largeMessage != nullptr && transport[transportId].largeMessage->sending == true)
 			{
-				#if defined(TREACLE_DEBUG)
-					debugPrint(treacleDebugString_treacleSpace);
-					debugPrint(treacleDebugString_suggested_message_interval);
-					debugPrint(' ');
-					debugPrint((transport[transportId].nextTick * 2)/1000);
-					debugPrintln('s');
-				#endif
-				return transport[transportId].nextTick * 2;
+				return true;
 			}
 		}
 	}
-	else if(numberOfActiveTransports == 1)
+	return false;
+}
+void treacleClass::cancelLargeMessage()
+{
+	for(uint8_t transportId = 0; transportId < numberOfActiveTransports; transportId++)
 	{
-		#if defined(TREACLE_DEBUG)
-			debugPrint(treacleDebugString_treacleSpace);
-			debugPrint(treacleDebugString_suggested_message_interval);
-			debugPrint(' ');
-			debugPrint((transport[0].nextTick * 2)/1000);
-			debugPrintln('s');
-		#endif
-		return transport[0].nextTick * 2;
+		finishLargeMessage(transportId);
 	}
-	#if defined(TREACLE_DEBUG)
-		debugPrint(treacleDebugString_treacleSpace);
-		debugPrint(treacleDebugString_suggested_message_interval);
-		debugPrint(' ');
-		debugPrint((maximumTickTime * 2)/1000);
-		debugPrintln('s');
-	#endif
-	return maximumTickTime * 2;
 }
-uint8_t treacleClass::messageSender()
+float treacleClass::largeMessageProgress()
 {
-	return receiveBuffer[(uint8_t)headerPosition::sender];
+	if(largeMessageLength == 0)
+	{
+		return 0;
+	}
+	uint32_t fragments = largeMessageFragments(largeMessageLength);
+	uint32_t mostPending = 0;
+	for(uint8_t transportId = 0; transportId < numberOfActiveTransports; transportId++)
+	{
+		if(transport[transportId].largeMessage != nullptr && transport[transportId].largeMessage->sending == true &&
+			transport[transportId].largeMessage->fragmentsPending > mostPending)
+		{
+			mostPending = transport[transportId].largeMessage->fragmentsPending;
+		}
+	}
+	return (100.0 * (fragments - mostPending)) / fragments;
 }
-bool treacleClass::queueMessage(char* data)
+float treacleClass::largeMessageReceiveProgress()
 {
-	return queueMessage((uint8_t*)data, strlen(data)+1);
+	if(largeMessageReceiveBuffer == nullptr)
+	{
+		return 0;
+	}
+	uint32_t fragments = largeMessageFragments(largeMessageReceiveLength);
+	return (100.0 * (fragments - largeMessageFragmentsRemaining)) / fragments;
 }
-bool treacleClass::queueMessage(const unsigned char* data, uint8_t length)
+uint32_t treacleClass::getLargeMessageThroughput(uint8_t index)
 {
-	return queueMessage((uint8_t*)data, (uint8_t)length);
+	if(index < numberOfActiveTransports && transport[index].largeMessage != nullptr &&
+		transport[index].largeMessage->lastSent - transport[index].largeMessage->startTime > 0)
+	{
+		uint32_t bytesSent = (largeMessageFragments(largeMessageLength) - transport[index].largeMessage->fragmentsPending) * largeMessageFragmentSize;	//Fragments sent and not reported missing
+		if(bytesSent > largeMessageLength)
+		{
+			bytesSent = largeMessageLength;			//The last fragment is usually short
+		}
+		return ((uint64_t)bytesSent * 1000) / (transport[index].largeMessage->lastSent - transport[index].largeMessage->startTime);
+	}
+	return 0;
 }
-bool treacleClass::queueMessage(uint8_t* data, uint8_t length)
+uint32_t treacleClass::getLargeMessageRetransmissions(uint8_t index)
 {
-	bool nodeReached[numberOfNodes] = {};	//Used to track which nodes _should_ have been reached, in transport priority order and avoid sending using lower priority transports, if possible
-	uint8_t numberOfNodesReached = 0;
-	if(length < maximumPayloadSize)
+	if(index < numberOfActiveTransports && transport[index].largeMessage != nullptr)
 	{
-		for (uint8_t transportId = 0; transportId < numberOfActiveTransports; transportId++)
+		return transport[index].largeMessage->retransmissions;
+	}
+	return 0;
+}
+uint8_t treacleClass::getLargeMessageWindow(uint8_t index)
+{
+	if(index < numberOfActiveTransports)
+	{
+		if(transport[index].largeMessage == nullptr)
 		{
-			if(transport[transportId].initialised == true &&	//It's initialised
-				packetInQueue(transportId) == false) 			//It's got nothing waiting to go
-			{
-				buildPacketHeader(transportId, (uint8_t)nodeId::allNodes, payloadType::shortApplicationData);			//Make an application data packet
-				memcpy(&transport[transportId].transmitBuffer[(uint8_t)headerPosition::payload], data, length);			//Copy the data starting at headerPosition::payload
-				transport[transportId].transmitBuffer[(uint8_t)headerPosition::packetLength] = 							//Update packetLength field
-				(uint8_t)headerPosition::payload + length;
-				transport[transportId].transmitPacketSize += length;													//Update the length of the transmit buffer
-				processPacketBeforeTransmission(transportId);															//Do CRC and encryption if needed
-				for(uint8_t nodeIndex = 0; nodeIndex < numberOfNodes; nodeIndex++)
-				{
-					if(nodeReached[nodeIndex] == false)
-					{
-						if(online(nodeIndex, transportId))
-						{
-							nodeReached[nodeIndex] = true;
-							numberOfNodesReached++;
-						}
-					}
-				}
-			}
-			if(numberOfNodesReached == numberOfNodes)
+			return largeMessageInitialWindow;		//Nothing has been sent on this transport yet
+		}
+		return transport[index].largeMessage->window;
+	}
+	return 0;
+}
+uint8_t treacleClass::largeMessageNodesDelivered()
+{
+	uint32_t nodeDelivered[nodeBitmaskSize] = {};
+	for(uint8_t transportId = 0; transportId < numberOfActiveTransports; transportId++)
+	{
+		if(transport[transportId].largeMessage != nullptr)
+		{
+			for(uint8_t word = 0; word < nodeBitmaskSize; word++)
 			{
-				return true;	//We have almost certainly reached all the nodes with this transport, do not queue the message for lower priority (or higher cost) transports
+				nodeDelivered[word] |= transport[transportId].largeMessage->delivered[word];
 			}
 		}
-		return true;
 	}
-	return false;
+	return countNodeBits(nodeDelivered);
 }
-bool treacleClass::sendMessage(char* data)
+void treacleClass::setMaximumLargeMessageSize(uint32_t size)
 {
-	bringForwardNextTick();
-	return queueMessage((uint8_t*)data, strlen(data)+1);
+	maximumLargeMessageSize = size;
 }
-bool treacleClass::sendMessage(const unsigned char* data, uint8_t length)
+uint32_t treacleClass::largeMessageFragments(uint32_t length)
 {
-	bringForwardNextTick();
-	return queueMessage((uint8_t*)data, (uint8_t)length);
+	return (length + largeMessageFragmentSize - 1) / largeMessageFragmentSize;
 }
-bool treacleClass::sendMessage(uint8_t* data, uint8_t length)
+bool treacleClass::largeMessageFragmentReceived(uint32_t fragmentIndex)
 {
-	bringForwardNextTick();
-	return queueMessage(data, length);
+	return largeMessageFragmentsReceived[fragmentIndex/8] & (0x01 << (fragmentIndex%8));
 }
-bool treacleClass::retrieveWaitingMessage(uint8_t* destination)
+void treacleClass::clearLargeMessage()
 {
-	if(applicationDataPacketReceived())
+	if(largeMessageReceiveBuffer != nullptr)
 	{
-		memcpy(destination, &receiveBuffer[(uint8_t)headerPosition::payload], receiveBuffer[(uint8_t)headerPosition::packetLength] - (uint8_t)headerPosition::payload);
-		return true;
+		delete[] largeMessageReceiveBuffer;
+		largeMessageReceiveBuffer = nullptr;
 	}
-	return false;
-}
-uint8_t treacleClass::maxPayloadSize()
-{
-	return maximumPayloadSize;
+	if(largeMessageFragmentsReceived != nullptr)
+	{
+		delete[] largeMessageFragmentsReceived;
+		largeMessageFragmentsReceived = nullptr;
+	}
+	largeMessageReceiveLength = 0;
+	largeMessageFragmentsRemaining = 0;
+	largeMessageComplete = false;
 }
 /*
  *
@@ -2073,12 +4970,16 @@ float treacleClass::reliabilityPercentage(uint16_t bitmask)
  */
 uint8_t treacleClass::countBits(uint32_t thingToCount)
 {
-  uint8_t result = 0;
-  for(uint8_t i = 0; i < 32 ; i++)
-  {
-    result+=(0x00000001 << i) & thingToCount ? 1 : 0;
-  }
-  return result;
+	return __builtin_popcountl(thingToCount);	//Compiler builtin, which uses a hardware instruction where the MCU has one
+}
+uint8_t treacleClass::countNodeBits(uint32_t* bitmask)
+{
+	uint8_t result = 0;
+	for(uint8_t word = 0; word < nodeBitmaskSize; word++)
+	{
+		result += countBits(bitmask[word]);
+	}
+	return result;
 }
 treacleClass treacle;	//Create an instance of the class, as only one is practically usable at a time
 #endif
@@ -60,6 +60,9 @@
 		{
 			#include <esp_now.h>
 		}
+		#if defined(ESP_NOW_MAX_DATA_LEN_V2)
+			#define TREACLE_ESPNOW_LARGE_FRAMES		//ESP-IDF 5.4 onwards can send ESP-Now v2 frames of up to 1470 bytes
+		#endif
 	#endif
 #endif
 
@@ -132,6 +135,28 @@
 	const char treacleDebugString_tick[] PROGMEM = "tick";
 	const char treacleDebugString_keepalive[] PROGMEM = "keepalive";
 	const char treacleDebugString_short_application_data[] PROGMEM = "short application data";
+	const char treacleDebugString_large_application_data[] PROGMEM = "large application data";
+	const char treacleDebugString_complete[] PROGMEM = "complete";
+	const char treacleDebugString_abandoned[] PROGMEM = "abandoned";
+	const char treacleDebugString_large_application_data_ack[] PROGMEM = "large application data ack";
+	const char treacleDebugString_missing[] PROGMEM = "missing";
+	const char treacleDebugString_parity[] PROGMEM = "parity";
+	const char treacleDebugString_acknowledged_application_data[] PROGMEM = "acknowledged application data";
+	const char treacleDebugString_acknowledged_application_data_ack[] PROGMEM = "acknowledged application data ack";
+	const char treacleDebugString_delivered[] PROGMEM = "delivered";
+	const char treacleDebugString_relayable_application_data[] PROGMEM = "relayable application data";
+	const char treacleDebugString_relayed[] PROGMEM = "relayed";
+	const char treacleDebugString_suppressed[] PROGMEM = "suppressed";
+	const char treacleDebugString_cost[] PROGMEM = "cost";
+	const char treacleDebugString_bridged[] PROGMEM = "bridged";
+	const char treacleDebugString_network_time[] PROGMEM = "network time";
+	const char treacleDebugString_slot[] PROGMEM = "slot";
+	const char treacleDebugString_channel_busy[] PROGMEM = "channel busy";
+	const char treacleDebugString_spreading_factor[] PROGMEM = "spreading factor";
+	const char treacleDebugString_fallback[] PROGMEM = "fallback";
+	const char treacleDebugString_selected[] PROGMEM = "selected";
+	const char treacleDebugString_ms[] PROGMEM = "ms";
+	const char treacleDebugString_recovered[] PROGMEM = "recovered";
 	const char treacleDebugString_sent[] PROGMEM = "sent";
 	const char treacleDebugString_received[] PROGMEM = "received";
 	const char treacleDebugString_toSpace[] PROGMEM = "to ";
@@ -221,6 +246,10 @@ class treacleClass	{
 			bool espNowInitialised();						//Is ESP-Now radio correctly initialised?
 			void setEspNowChannel(uint8_t);					//Set the WiFi channel used for ESP-Now
 			bool espNowChannelChanged();					//Check if the ESP-Now channel changed, resets on read if true
+			void enableEspNowChannelDiscovery();			//Look for the other nodes on every channel if contact is lost, unless WiFi fixes the channel
+			void disableEspNowChannelDiscovery();			//Stay on the channel set
+			uint32_t getEspNowRejoinTime();					//Get the time in ms it took to hear another node after the last channel change or loss of contact
+			uint32_t getEspNowRejoins();					//Get the number of times contact was regained
 			uint8_t getEspNowChannel();						//Get the WiFi channel used for ESP-Now
 			void setEspNowTickInterval(uint16_t tick);		//Set the ESP-Now tick interval
 			uint32_t getEspNowRxPackets();					//Get packet stats
@@ -232,6 +261,11 @@ class treacleClass	{
 			uint16_t getEspNowTickInterval();				//Get time between packets
 			uint16_t espNowRxReliability(uint8_t);
 			uint16_t espNowTxReliability(uint8_t);
+			uint8_t getEspNowPeers();						//Get the number of nodes currently added as unicast peers
+			uint32_t getEspNowPeerEvictions();				//Get the number of peers removed to make room for another
+			void enableEspNowLargeFrames();					//Use ESP-Now v2 frames for large messages, if every reachable node has also enabled them
+			void disableEspNowLargeFrames();				//Go back to single frames, which nodes on older releases need
+			uint32_t getEspNowLargeFrames();				//Get the number of large frames sent, each carrying several packets
 			#if defined(ESP8266)
 			void esp8266sendCallback(uint8_t* macAddress,	//ESP-Now send callback is used to measure airtime for duty cycle calculations
 				uint8_t status);
@@ -262,6 +296,22 @@ class treacleClass	{
 			void setLoRaSpreadingFactor(uint8_t);			//LoRa spreading factor
 			void setLoRaSignalBandwidth(uint32_t);			//Supported values are 7.8E3, 10.4E3, 15.6E3, 20.8E3, 31.25E3, 41.7E3, 62.5E3, 125E3(default), 250E3, and 500E3.
 			void setLoRaRxGain(uint8_t);					//0-6, 0 = auto
+			void setLoRaCodingRate(uint8_t);				//LoRa coding rate denominator 5-8, ie. 4/5 to 4/8
+			uint8_t getLoRaCodingRate();					//LoRa coding rate denominator
+			void setLoRaPreambleLength(uint16_t);			//LoRa preamble length in symbols, default 8
+			uint16_t getLoRaPreambleLength();				//LoRa preamble length in symbols
+			uint32_t loRaTimeOnAir(uint8_t packetSize);		//Calculated time on air for a LoRa packet of this size with the current settings, in micros
+			void enableLoRaSlots(uint8_t slots = 16);		//Send LoRa ticks in a time slot not used by other nodes within two hops, up to 32 slots
+			void disableLoRaSlots();						//Go back to randomised LoRa ticks
+			uint8_t getLoRaSlot();							//Current LoRa slot, 255 if there isn't one
+			uint32_t getLoRaSlotChanges();					//Times the LoRa slot has been changed to avoid another node
+			void enableLoRaListenBeforeTalk();				//Check the channel is clear before each LoRa transmission, backing off ticks if it is busy
+			void disableLoRaListenBeforeTalk();				//Transmit LoRa packets without checking the channel
+			uint32_t getLoRaDeferrals();					//LoRa ticks and packets put back because the channel was busy
+			uint32_t getLoRaChannelBusy();					//Channel checks that found activity
+			void enableLoRaAdaptiveDataRate(uint8_t margin = 10);	//Lower the spreading factor and TX power while every LoRa link that is needed keeps this SNR margin in dB
+			void disableLoRaAdaptiveDataRate();				//Go back to the configured spreading factor and TX power
+			uint32_t getLoRaDataRateFallbacks();			//Times a spreading factor change lost contact with a node and was reverted
 			uint16_t loRaRxReliability(uint8_t);
 			uint16_t loRaTxReliability(uint8_t);
 			int16_t  loRaRSSI(uint8_t);
@@ -307,6 +357,11 @@ class treacleClass	{
 			uint32_t getUDPDutyCycleExceptions();			//Get packet stats
 			void setUDPTickInterval(uint16_t tick);			//Set the interval between packets
 			uint16_t getUDPTickInterval();					//Get interval between packets
+			void enableUDPUnicast();						//Send messages for a single node straight to its IP address, learned from the packets it sends
+			void disableUDPUnicast();						//Send everything by multicast
+			bool addUDPUnicastPeer(IPAddress);				//Also send keepalives straight to this address, eg. a node multicast doesn't reach
+			uint32_t getUDPPeerTxPackets(uint8_t);			//Get the number of packets sent straight to a node
+			uint32_t getUDPUnicastPeerTxPackets(IPAddress);	//Get the number of packets sent straight to an address added with addUDPUnicastPeer()
 		#endif
 		//COBS/Serial
 		#if defined(TREACLE_SUPPORT_COBS)
@@ -326,6 +381,10 @@ class treacleClass	{
 		bool reachableNodesChanged();						//Inform application if number of reachable nodes has changed, resets on read if true
 		uint8_t maxPayloadSize();							//Maximum single packet payload size
 		uint32_t messageWaiting();							//Is there a message waiting?
+		uint32_t nextEventInMs();							//Milliseconds until messageWaiting() next needs calling to send or time out ticks, so the application can sleep
+		//Low power
+		uint32_t nextMandatoryTickInMs();					//Milliseconds until this node must next send a tick on any transport, the longest it can sleep
+		void catchUp(uint32_t sleptFor = 0);				//Catch up sends and time outs after waking, supply the sleep time if millis() stopped while asleep
 		void clearWaitingMessage();							//Trash an incoming message
 		uint8_t messageSender();							//The sender of the waiting message
 		uint32_t suggestedQueueInterval();					//Suggest a delay before the next message
@@ -333,11 +392,54 @@ class treacleClass	{
 		bool queueMessage(uint8_t*, uint8_t);				//Queue a short message
 		bool queueMessage(const unsigned char*,				//Queue a short message
 			uint8_t);
+		bool queueMessage(uint8_t, char*);					//Queue a short message for a single node
+		bool queueMessage(uint8_t, uint8_t*, uint8_t);		//Queue a short message for a single node, only on transports it is online with
 		bool sendMessage(char*);							//Send a short message ASAP
 		bool sendMessage(uint8_t*, uint8_t);				//Send a short message ASAP
 		bool sendMessage(const unsigned char*,				//Send a short message ASAP
 			uint8_t);
+		bool sendMessage(uint8_t, char*);					//Send a short message to a single node ASAP
+		bool sendMessage(uint8_t, uint8_t*, uint8_t);		//Send a short message to a single node ASAP
 		bool retrieveWaitingMessage(uint8_t*);				//Retrieve a message. The buffer must be large enough for it, no checking can be done
+		//Large messages
+		bool queueLargeMessage(uint8_t*, uint32_t,			//Queue a large message, which is sent in fragments. The data must not change until largeMessageInProgress() is false
+			bool acknowledged = false);						//Acknowledged messages are a bulk transfer, where receivers reply with the fragments they are missing
+		bool largeMessageInProgress();						//Is a large message still being sent?
+		void cancelLargeMessage();							//Stop sending a large message
+		float largeMessageProgress();						//Percentage of a large message sent, on the slowest transport carrying it
+		float largeMessageReceiveProgress();				//Percentage of an incoming large message received
+		uint32_t getLargeMessageThroughput(uint8_t index);	//Large message goodput on a transport, in bytes/s, retransmissions are not counted
+		uint32_t getLargeMessageRetransmissions(uint8_t index);	//Fragments of the current large message retransmitted on a transport
+		uint8_t getLargeMessageWindow(uint8_t index);		//Fragments sent on a transport before asking for acknowledgement
+		uint8_t largeMessageNodesDelivered();				//Nodes that have acknowledged the whole of the current large message
+		void setMaximumLargeMessageSize(uint32_t);			//Largest message that will be reassembled, the buffer is allocated from heap when needed. 0, the default, ignores large messages
+		//Acknowledged messages
+		uint8_t queueAcknowledgedMessage(uint8_t, uint8_t*,	//Queue a short message that is retransmitted until acknowledged, returns a handle or 0 if it can't be queued
+			uint8_t, uint8_t quorum = 0);					//For messages to all nodes, the acknowledgements needed. 0 means every reachable node
+		bool acknowledgedMessageInProgress();				//Is an acknowledged message still waiting for acknowledgement? Only one can be in progress
+		void setDeliveryCallback(void (*)(uint8_t, bool, uint32_t));	//Called with the handle, whether it was delivered and the latency in ms when an acknowledged message finishes
+		uint16_t getRoundTripTime(uint8_t index);			//Smoothed round trip time of acknowledged messages on a transport, in ms
+		uint32_t getRetransmissionTimeout(uint8_t index);	//Current wait for an acknowledgement on a transport before retransmitting, in ms
+		//Relaying
+		void enableRelaying(uint8_t hops = 3,				//Rebroadcast messages from other nodes and make messages from this node relayable, with a hop limit
+			uint8_t suppression = 2);						//Skip relaying a message once this many copies of it have been heard
+		void disableRelaying();								//Stop relaying
+		uint32_t getRelayedPackets(uint8_t index);			//Messages relayed on a transport
+		uint32_t getRelaysSuppressed(uint8_t index);		//Relays skipped on a transport because enough other nodes relayed the message
+		//Bridging
+		uint8_t addBridge(uint8_t from, uint8_t to,			//Forward packets for all nodes received on one transport to another, returns the bridge number or 255 if it can't be added
+			uint16_t payloadTypes = 0);						//Bitmask of payload types to forward, where bit n is payload type n. 0 forwards application data
+		uint32_t getBridgedPackets(uint8_t bridgeIndex);	//Packets forwarded by a bridge
+		uint32_t getBridgedBytes(uint8_t bridgeIndex);		//Bytes forwarded by a bridge
+		uint32_t getBridgeDrops(uint8_t bridgeIndex);		//Packets a bridge couldn't forward because the destination transport was busy
+		uint32_t getBridgeThroughput(uint8_t bridgeIndex);	//Average bytes/s forwarded by a bridge since it was added
+		//Time synchronisation
+		void enableTimeSync();								//Share a network time in keepalives, following the node with the lowest ID that can be heard
+		void disableTimeSync();								//Stop sharing and following the network time
+		uint32_t networkMillis();							//Milliseconds on the shared network clock, the same as millis() until synchronised
+		uint16_t networkTimeAccuracy();						//Estimated error of networkMillis() in ms compared with the reference node, 65535 if unknown
+		bool networkTimeSynchronised();						//Is networkMillis() following a reference node, or is this node the reference?
+		uint8_t getTimeReference();							//ID of the node whose clock is the network time
 		//Encryption
 		void setEncryptionKey(uint8_t* key);				//Set the encryption key
 		//General
@@ -359,6 +461,18 @@ class treacleClass	{
 		uint32_t getTxPacketsDropped(uint8_t index);		//Get transport stats
 		float getDutyCycle(uint8_t index);					//Get transport stats
 		float getMaxDutyCycle(uint8_t index);				//Get transport stats
+		void setMaxDutyCycle(uint8_t index, float);			//Set the maximum duty cycle for a transport, as a percentage
+		uint32_t getAirtimeBudget(uint8_t index);			//Remaining TX time available to a transport before it hits the duty cycle limit, in ms
+		void setForwardErrorCorrection(uint8_t index,		//Send a parity packet after every few application packets on a transport, so receivers can recover one lost packet. 0 disables it, receivers must enable it too, after begin()
+			uint8_t groupSize);
+		uint8_t getForwardErrorCorrection(uint8_t index);	//Application packets in each parity group on a transport, 0 if disabled
+		uint32_t getRecoveredPackets(uint8_t index);		//Application packets recovered using parity packets on a transport
+		void setTransportCost(uint8_t index, uint16_t);		//Fixed extra cost of using a transport, eg. for a metered connection, added to the airtime and latency costs
+		void setTargetDeliveryProbability(float);			//Keep choosing transports for a message until each recipient should get it with at least this probability, as a percentage
+		uint8_t getLastTransportSelection();				//Bitmask of the transports chosen for the last message
+		uint32_t getTransportCost(uint8_t index);			//Cost of a transport worked out for the last message, 0 if it couldn't be used
+		float getDeliveryProbability(uint8_t id,			//Estimated chance a node receives a packet from this node on a transport, as a percentage
+			uint8_t index);
 		//Node status & stats
 		bool online(uint8_t);								//Is a specific treacle node online? ie. has this node heard from it recently
 		//uint32_t rxAge(uint8_t);
@@ -371,7 +485,7 @@ class treacleClass	{
 		uint16_t nodeRxReliability(uint8_t index, uint8_t transport);		//Get node stats
 		uint8_t  nodeLastPayloadNumber(uint8_t index, uint8_t transport);	//Get node stats
 		//Start, stop and debug
-		bool begin(uint8_t maxNodes = 8);					//Start treacle, optionally specify a max number of nodes
+		bool begin(uint8_t maxNodes = 8);					//Start treacle, optionally specify a max number of nodes, which is capped at absoluteMaximumNumberOfNodes
 		void end();											//Stop treacle
 		void enableDebug(Stream &);							//Start debugging on a stream
 		void disableDebug();								//Stop debugging
@@ -400,8 +514,30 @@ class treacleClass	{
 		static const uint8_t maximumBufferSize= 250;		//Maximum buffer size, which is based off ESP-Now max size
 		static const uint8_t maximumPayloadSize = 238;		//Maximum application payload size, which is based off ESP-Now max size
 		
+		//Node bitmasks
+		static const uint8_t absoluteMaximumNumberOfNodes = 80;	//Absolute max number of nodes
+		static const uint8_t nodeBitmaskSize =				//Number of uint32_t needed to hold one bit per node
+			(absoluteMaximumNumberOfNodes + 31)/32;
+		
+		//Forward error correction
+		static const uint8_t fecMaximumGroupSize = 8;		//Most application packets protected by one parity packet
+		static const uint8_t fecMaximumPayloadSize =		//Largest application payload that can be protected, leaving room in the parity packet for the group size, payload numbers and length parity once padded for encryption
+			maximumPayloadSize - fecMaximumGroupSize - 7;
+		static const uint8_t fecHistorySize =				//Received application packets kept to recover a lost one, enough for the groups of two senders at the largest group size
+			fecMaximumGroupSize * 2;
+		static const uint8_t relayHistorySize = 16;			//Recent relayable messages remembered, to drop copies arriving by any transport
+		
+		//Large message window
+		static const uint8_t largeMessageInitialWindow = 4;	//Fragments sent before asking for acknowledgement at the start
+		
 		//Ticks
 		static const uint16_t maximumTickTime = 60E3;		//Absolute longest time something can be scheduled in the future
+		//Duty cycle window
+		static const uint32_t dutyCycleWindow = 3600E3;		//Duty cycle is measured over a sliding one hour window, as for EU868 LoRa
+		static const uint8_t dutyCycleSlots = 12;			//The window is split into this many slots, which expire one at a time
+		#if defined(ESP32)
+			portMUX_TYPE txTimeLock = portMUX_INITIALIZER_UNLOCKED;	//TX time is recorded from callbacks in other tasks, so it is handed over inside this
+		#endif
 		//Tick functions
 		void setNextTickTime();								//Set a next tick time for all transports, done at startup
 		void setNextTickTime(uint8_t);						//Set a next tick time immediately before sending for a specific transport
@@ -409,7 +545,73 @@ class treacleClass	{
 		void bringForwardNextTick();						//Hurry up the tick time for urgent things
 		bool sendPacketOnTick();							//Send a single packet if it is due, returns true if this happens
 		void timeOutTicks();								//Potentially time out ticks from other nodes if they stop responding
+		uint32_t timeToNextTick(uint8_t);					//Milliseconds until the next tick is due for a specific transport
+		uint32_t nextRemoteTimeOut = 0;						//millis() at which the earliest expected tick from another node will be considered missed
+		bool remoteTicksChanged = true;						//Set whenever tick/reliability information from other nodes changes, forcing nextRemoteTimeOut to be recalculated
 
+		//Per transport state for optional features, allocated only when they are used so transportData stays small
+		struct largeMessageTransportData
+		{
+			bool sending = false;							//Is this transport carrying the current large message?
+			uint8_t* pending = nullptr;						//Bitmap of large message fragments still to send on this transport, lost fragments are added back
+			uint32_t fragmentsPending = 0;					//Number of fragments still to send
+			uint32_t highestSent = 0;						//One past the highest fragment sent, anything below that not pending has been sent
+			uint32_t lastFragmentSent = 0;					//Last fragment sent, which is sent again if acknowledgements need asking for again
+			uint32_t retransmissions = 0;					//Fragments sent again after being reported missing
+			uint32_t startTime = 0;							//millis() when this transport started sending the large message, for throughput
+			uint32_t lastSent = 0;							//millis() when this transport last sent a large message fragment, for throughput
+			uint8_t window = largeMessageInitialWindow;		//Fragments sent before asking for acknowledgement, which grows while there is no loss and halves when there is
+			uint8_t inFlight = 0;							//Fragments sent in the current window
+			bool awaitingAck = false;						//Waiting for receivers to report missing fragments
+			uint32_t ackRequestTime = 0;					//millis() when acknowledgement was last asked for
+			uint8_t ackRetries = 0;							//Times in a row acknowledgement was asked for without all receivers replying
+			bool lossInWindow = false;						//Did any receiver report missing fragments from this window?
+			uint32_t receivers[nodeBitmaskSize] = {};		//Nodes expected to acknowledge the large message on this transport
+			uint32_t responded[nodeBitmaskSize] = {};		//Nodes that have acknowledged the current window
+			uint32_t delivered[nodeBitmaskSize] = {};		//Nodes that have acknowledged the whole message
+			bool ackDue = false;							//This node owes a large message sender an acknowledgement on this transport
+			uint32_t ackTime = 0;							//millis() at which to send it, randomised so receivers don't all reply at once
+			uint8_t ackRecipient = 0;						//The large message sender
+			uint8_t ackId = 0;								//The large message ID
+			uint32_t ackFragments = 0;						//Number of fragments in the large message
+		};
+		struct fecTransportData
+		{
+			uint8_t groupCount = 0;							//Application packets in the current parity group
+			uint8_t groupPayloadNumbers[fecMaximumGroupSize] = {};	//Payload numbers of the packets in the current parity group
+			uint8_t lengthParity = 0;						//XOR of the payload lengths in the current parity group
+			uint8_t parityLength = 0;						//Longest payload in the current parity group
+			uint8_t parity[fecMaximumPayloadSize] = {};		//XOR of the payloads in the current parity group
+			bool parityDue = false;							//The parity group is complete and the parity packet is waiting to be sent
+			uint8_t* history = nullptr;						//The last few application packets received from any sender, to recover a lost one from a parity packet
+			uint8_t historyIndex = 0;						//Next slot to fill in the history
+			uint32_t recovered = 0;							//Application packets recovered from parity packets
+		};
+		struct acknowledgementTransportData
+		{
+			uint16_t roundTripTime = 0;						//Smoothed round trip time of acknowledged messages, in ms, 0 until measured
+			uint16_t roundTripTimeVariance = 0;				//Smoothed variation in the round trip time, in ms
+			uint32_t sentTime = 0;							//millis() when the current acknowledged message attempt was sent on this transport
+			bool due = false;								//This node owes an acknowledgement of an acknowledged message on this transport
+			uint32_t time = 0;								//millis() at which to send it, randomised for messages to all nodes so they don't all reply at once
+			uint8_t recipient = 0;							//The acknowledged message sender
+			uint8_t handle = 0;								//The acknowledged message handle
+		};
+		struct relayTransportData
+		{
+			uint8_t buffer[maximumPayloadSize];				//Payload of a message waiting to be relayed
+			uint8_t length = 0;								//Length of the payload waiting to be relayed, 0 if there isn't one
+			uint32_t time = 0;								//millis() at which to relay it, randomised so nodes hearing the same message don't all relay at once
+			uint8_t copiesHeard = 0;						//Copies of the message heard while waiting, to suppress the relay
+			uint32_t packets = 0;							//Messages relayed
+			uint32_t suppressed = 0;						//Relays skipped as enough copies were heard
+		};
+		struct bridgeTransportData
+		{
+			uint8_t buffer[maximumBufferSize];				//Packet waiting to be forwarded on to this transport by a bridge
+			uint8_t length = 0;								//Size of the packet waiting, 0 if there isn't one
+			uint8_t index = 0;								//The bridge it came through, for the counters
+		};
 		struct transportData
 		{
 			bool initialised = false;						//Has the transport initialised OK?
@@ -422,25 +624,40 @@ class treacleClass	{
 			uint32_t rxPacketsIgnored = 0;					//Simple stats for received packets that were ignored, probably due to being for another node
 			uint32_t rxPacketsInvalid = 0;					//Simple stats for received packets that were invalid, probably due to a wrong encryption key
 			uint32_t txStartTime = 0;						//Used to calculate TX time for each packet using micros()
-			uint32_t txTime = 0;							//Total time in micros() spent transmitting
-			float calculatedDutyCycle = 0;					//Calculated from txTime and millis()
+			uint32_t txTime = 0;							//Total time in micros() spent transmitting, this rolls over so is only informational
+			volatile uint32_t pendingTxTime = 0;			//TX time in micros() recorded by callbacks, added to the duty cycle window in calculateDutyCycle()
+			float calculatedDutyCycle = 0;					//Calculated from TX time in the sliding duty cycle window
 			float maximumDutyCycle = 1;						//Used as a hard brake on TX if exceeded
+			uint32_t dutyCycleSlotTxTime[dutyCycleSlots] = {};	//TX time in micros() for each slot of the duty cycle window
+			uint8_t currentDutyCycleSlot = 0;				//Slot of the duty cycle window currently being filled
+			uint32_t dutyCycleSlotStart = 0;				//millis() at the start of the current slot
+			int32_t airtimeTokens = 0;						//Token bucket of TX time in micros(), refilled at the maximum duty cycle rate so TX can't all happen in one burst
+			uint32_t lastTokenRefill = 0;					//millis() when the token bucket was last refilled
 			uint32_t dutyCycleExceptions = 0;				//Count any time it goes over duty cycle
 			uint32_t lastTick = 0;							//Track this node's ticks
 			uint16_t defaultTick = maximumTickTime;			//Frequency of ticks for each transport, which is important
 			uint16_t minimumTick = maximumTickTime/2;		//Minimum frequency of ticks for each transport, which is important
 			uint16_t nextTick = 0;							//How long until the next tick for each transport, which is important. This varies slightly from the default.
 			uint8_t transmitBuffer[maximumBufferSize];		//General transmit buffer
+			uint16_t maximumFrameSize = maximumBufferSize;	//Largest frame the transport can send, which may carry several packets
 			uint8_t transmitPacketSize = 0;					//Current transmit packet size
 			bool bufferSent = true;							//Per transport marker for when something is sent
 			uint8_t payloadNumber = 0;						//Sequence number for payloads, this will overflow regularly
+			uint32_t reachableNodes[nodeBitmaskSize] = {};	//Bitmask of node indexes online via this transport, kept up to date as reliability changes
+			largeMessageTransportData* largeMessage = nullptr;	//Large message sending and acknowledgement state, allocated when first needed
+			uint8_t fecGroupSize = 0;						//Application packets protected by each parity packet, 0 disables forward error correction
+			fecTransportData* fec = nullptr;				//Forward error correction state, allocated when enabled
+			acknowledgementTransportData* acknowledgement = nullptr;	//Acknowledged message state, allocated when first needed
+			relayTransportData* relay = nullptr;			//Relay state, allocated when relaying is enabled
+			bridgeTransportData* bridge = nullptr;			//Bridged packet waiting to be forwarded on to this transport, allocated when a bridge to it is added
+			uint16_t fixedCost = 0;							//Extra cost of using this transport, set by the application
+			uint32_t selectionCost = 0;						//Cost worked out the last time transports were chosen, 0 if it wasn't available
 		};
 		transportData* transport = nullptr;					//This will be allocated from heap during begin()
 		
 		
 		//Node information
 		uint8_t maximumNumberOfNodes = 8;					//Expected max number of nodes
-		static const uint8_t absoluteMaximumNumberOfNodes = 80;	//Absolute max number of nodes
 		uint8_t numberOfNodes = 0;							//Track number of nodes
 		bool numberOfNodesChanged = false;					//Flag to show application if nodes have changed, resets on read if true
 		uint8_t numberOfReachableNodes = 0;					//Track number of reachable nodes
@@ -455,6 +672,9 @@ class treacleClass	{
 			uint16_t* txReliability = nullptr;				//This is per transport
 			uint16_t* rxReliability = nullptr;				//This is per transport
 			uint8_t* lastPayloadNumber = nullptr;			//This is per transport
+			uint8_t* newestPayloadNumber = nullptr;			//Newest payload number received, which differs from lastPayloadNumber if packets arrive out of order. This is per transport
+			uint32_t* recentPayloadNumbers = nullptr;		//Bitmask of the payload numbers received up to newestPayloadNumber, which is bit 0. This is per transport
+			uint8_t lastAcknowledgedMessageHandle = 0;		//Last acknowledged message delivered from this node, so retransmissions are only acknowledged
 		};
 		nodeInfo* node;										//Chunky struct could overwhelm a small microcontroller, so be careful with maxNodes
 		//Node management functions
@@ -472,9 +692,17 @@ class treacleClass	{
 		static const uint8_t maximumNodeId = 126;			//Highest a node ID can be
 		bool selectNodeId();								//Select a node ID for this node
 		void calculateNumberOfReachableNodes();				//Track how many nodes are currently reachable
+		void updateNodeReachability(uint8_t nodeIndex,		//Update the reachability bitmask for a node on a transport, after its reliability changes
+			uint8_t transportId);
 		
 		//Duty cycle monitoring
-		void calculateDutyCycle(uint8_t);					//Calculate the duty cycle for a specific transport based off current txTime, done just before sending
+		void calculateDutyCycle(uint8_t);					//Calculate the duty cycle for a specific transport over the sliding window and refill its token bucket, done just before sending
+		void recordTxTime(uint8_t, uint32_t);				//Record time spent transmitting in micros(), against the duty cycle window and token bucket
+		int32_t airtimeTokenBucketSize(uint8_t);			//Maximum size of the token bucket, which is one slot's worth of the duty cycle
+		bool dutyCycleAllowsTx(uint8_t,						//Check the duty cycle window and token bucket both allow TX, optionally of a known length in micros
+			uint32_t txTime = 0);
+		uint32_t expectedTxTime(uint8_t, uint8_t);			//Predict how long a packet will take to send, in micros, or 0 if this can't be known in advance
+		uint8_t packetSizeOnAir(uint8_t, uint8_t);			//Size a packet of a given length will be once the checksum and any encryption padding are added, to check the duty cycle before building it
 		
 		//Receive packet buffers
 		uint8_t receiveBuffer[maximumBufferSize];			//General receive buffer
@@ -486,6 +714,150 @@ class treacleClass	{
 		bool packetReceived();								//Check for a packet in the buffer
 		bool applicationDataPacketReceived();				//Check for an application data packet in the buffer
 		void clearReceiveBuffer();							//Clear the receive buffer
+		
+		//Large messages
+		static const uint8_t largeMessageFragmentSize = 224;//Data in each large message fragment, which still fits in a packet once padded for encryption
+		static const uint8_t largeMessageFragmentHeaderSize = 5;	//Each fragment starts with a message ID, flags and the 24-bit total length
+		static const uint8_t largeMessageAckRequest = 0x01;	//Fragment flag asking receivers for an acknowledgement
+		static const uint8_t largeMessageMaximumWindow = 64;//Most fragments sent before asking for acknowledgement
+		static const uint8_t largeMessageMaximumAckBitmap = 32;	//Most bytes of received fragment bitmap in an acknowledgement, which must cover the maximum window
+		static const uint8_t largeMessageMaximumAckRetries = 3;	//Times acknowledgement is asked for before giving up on receivers that don't reply
+		bool largeMessageAcknowledged = false;				//Is the current large message a bulk transfer?
+		uint8_t* largeMessageData = nullptr;				//Large message being sent, which belongs to the application
+		uint32_t largeMessageLength = 0;					//Length of the large message being sent
+		uint8_t largeMessageId = 0;							//Identifies each large message, this will overflow regularly
+		bool sendLargeMessageFragment();					//Send the next fragment of a large message on the first transport able to, returns true if this happens
+		void checkLargeMessageAcks(uint8_t);				//Move on once all receivers have acknowledged the current window on a transport, or the wait times out
+		void finishLargeMessage(uint8_t);					//Stop sending the large message on a transport
+		uint32_t nextPendingLargeMessageFragment(uint8_t);	//Lowest fragment still to send on a transport, so retransmissions go first
+		uint8_t largeMessageFragmentLength(uint32_t,		//Length of a specific fragment of a message
+			uint32_t);
+		uint8_t largeMessageWindowSize(uint8_t, uint8_t);	//Current window, limited to what the duty cycle token bucket can send in one go
+		void buildLargeMessageFragmentPacket(uint8_t,		//Large message fragment packet
+			uint32_t, bool);
+		bool sendLargeMessageAck();							//Send any acknowledgement that is due, returns true if this happens
+		bool buildLargeMessageAckPacket(uint8_t);			//Acknowledgement of the fragments received, false if there is nothing to acknowledge
+		void unpackLargeMessageAckPacket(					//Unpack an acknowledgement and mark missing fragments for retransmission
+			uint8_t, uint8_t);
+
+		uint32_t maximumLargeMessageSize = 0;				//Largest large message that will be reassembled
+		uint8_t* largeMessageReceiveBuffer = nullptr;		//Reassembly buffer, allocated from heap for each incoming large message
+		uint8_t* largeMessageFragmentsReceived = nullptr;	//Bitmap of fragments received, so they can arrive out of order and duplicates can be ignored
+		uint32_t largeMessageReceiveLength = 0;				//Length of the incoming large message
+		uint32_t largeMessageFragmentsRemaining = 0;		//Fragments still needed to complete the incoming large message
+		uint8_t largeMessageReceiveSender = 0;				//Sender of the incoming large message
+		uint8_t largeMessageReceiveId = 0;					//ID of the incoming large message
+		uint32_t largeMessageLastFragment = 0;				//millis() when a fragment of the incoming large message was last received, to abandon incomplete messages
+		bool largeMessageComplete = false;					//Is the incoming large message complete and waiting for the application?
+		uint8_t lastLargeMessageSender = 0;					//Sender of the last complete large message, so copies arriving over other transports are ignored
+		uint8_t lastLargeMessageId = 0;						//ID of the last complete large message
+		uint32_t largeMessageFragments(uint32_t);			//Number of fragments needed for a large message of a given length
+		bool largeMessageFragmentReceived(uint32_t);		//Check the bitmap of fragments received
+		void scheduleLargeMessageAck(uint8_t, uint8_t,		//Schedule an acknowledgement for a large message sender
+			uint8_t, uint32_t);
+		void unpackLargeMessageFragment(					//Unpack a large message fragment into the reassembly buffer
+			uint8_t, uint8_t);
+		void clearLargeMessage();							//Free the reassembly buffer
+		
+		//Forward error correction
+		void addPacketToParity(uint8_t, uint8_t*, uint8_t);	//Add an application packet to the parity group for a transport, as it is queued
+		void resetParity(uint8_t);							//Start a new parity group for a transport
+		bool sendParityPacket();							//Send any parity packet that is due, returns true if this happens
+		bool sendParityPacket(uint8_t);						//Send the parity packet for a specific transport if it is due and possible
+		void buildParityPacket(uint8_t);					//Parity packet for the current group
+		void storePacketForParity(uint8_t);					//Keep a received application packet in case a parity packet is needed to recover another
+		void unpackParityPacket(uint8_t, uint8_t);			//Recover a lost application packet from a parity packet, if possible
+		void recordPayloadNumber(uint8_t, uint8_t, uint8_t);	//Track the payload numbers received from a node, so a packet that was received is never recovered again
+		bool payloadNumberMissed(uint8_t, uint8_t, uint8_t);	//Is a recent payload number known not to have been received from a node?
+		
+		//Acknowledged messages
+		static const uint8_t acknowledgedMessageMaximumRetries = 4;	//Retransmissions before an acknowledged message is given up on
+		static const uint8_t minimumRetransmissionTimeout = 10;	//Shortest wait for an acknowledgement, in ms
+		uint8_t* acknowledgedMessageData = nullptr;			//Copy of the acknowledged message being sent, allocated from heap when first needed
+		uint8_t acknowledgedMessageLength = 0;				//Length of the acknowledged message
+		uint8_t acknowledgedMessageRecipient = 0;			//Recipient of the acknowledged message, which may be all nodes
+		uint8_t acknowledgedMessageHandle = 0;				//Handle of the acknowledged message in progress, 0 if there isn't one
+		uint8_t lastAcknowledgedMessageHandle = 0;			//Handles roll over, skipping 0
+		uint8_t acknowledgedMessageQuorum = 0;				//Acknowledgements needed for delivery
+		uint8_t acknowledgedMessageAttempts = 0;			//Attempts to send the acknowledged message so far
+		uint8_t acknowledgedMessagePending = 0;				//Bitmask of transports the current attempt is still to be sent on
+		uint32_t acknowledgedMessageQueueTime = 0;			//millis() when the acknowledged message was queued, for the delivery latency
+		uint32_t acknowledgedMessageAttemptTime = 0;		//millis() when the current attempt finished sending
+		uint32_t acknowledgedMessageTimeout = 0;			//Wait for acknowledgement of the current attempt, which backs off with each retry
+		uint32_t acknowledgedMessageAcked[nodeBitmaskSize] = {};	//Nodes that have acknowledged the message
+		void (*deliveryCallback)(uint8_t, bool, uint32_t) = nullptr;	//Application callback for the outcome of acknowledged messages
+		bool sendAcknowledgedMessage();						//Send the current attempt of an acknowledged message, or retransmit/give up if it times out, returns true if a packet is sent
+		void startAcknowledgedMessageAttempt();				//Choose the transports for the next attempt and its time out
+		void finishAcknowledgedMessage(bool);				//Report the outcome to the application
+		void buildAcknowledgedMessagePacket(uint8_t);		//Acknowledged message packet
+		bool sendAcknowledgement();							//Send any acknowledgement of an acknowledged message that is due, returns true if this happens
+		void buildAcknowledgementPacket(uint8_t);			//Acknowledgement packet
+		void unpackAcknowledgedMessagePacket(uint8_t,		//Schedule an acknowledgement and turn the packet into normal application data, unless it is a retransmission already delivered
+			uint8_t);
+		void unpackAcknowledgementPacket(uint8_t, uint8_t);	//Record an acknowledgement and measure the round trip time
+		void updateRoundTripTime(uint8_t, uint32_t);		//Smooth a round trip time sample into the estimate for a transport
+		uint32_t retransmissionTimeout(uint8_t);			//Wait for an acknowledgement on a transport, derived from the round trip time
+		
+		//Relaying
+		static const uint8_t relayHeaderSize = 3;			//Relayable messages start with the origin node ID, origin payload number and hops remaining
+		bool relaying = false;								//Does this node relay messages from other nodes?
+		uint8_t relayHops = 0;								//Hop limit given to messages from this node, 0 if they are not relayable
+		uint8_t relaySuppressionThreshold = 2;				//Copies of a message heard before relaying it is skipped
+		uint8_t relaySequenceNumber = 0;					//Origin payload number for relayable messages from this node, the same on every transport so copies can be recognised whichever way they arrive
+		uint16_t relayHistory[relayHistorySize] = {};		//Origin node ID and origin payload number of recent relayable messages, from any transport
+		uint8_t relayHistoryIndex = 0;						//Next slot to fill in the history
+		bool relayPacketSeen(uint8_t, uint8_t);				//Check if a relayable message has been seen before on any transport, remembering it if not
+		void unpackRelayablePacket(uint8_t);				//Schedule or suppress a relay, then turn the packet into normal application data from its origin
+		bool sendRelayedPacket();							//Send any relay that is due, returns true if this happens
+		void buildRelayedPacket(uint8_t);					//Relayed packet, with one less hop remaining
+		void allocateRelaying();							//Storage for a relay waiting on each transport
+		
+		//Bridging
+		static const uint8_t maximumNumberOfBridges = 4;	//Most bridges between transports
+		static const uint8_t bridgeHistorySize = 16;		//Recent packets for all nodes, so copies arriving both directly and through a bridge, or round a loop of bridges, are dropped
+		static const uint8_t bridgeMarker = 0xb5;			//Byte after the checksum and any encryption padding of a packet forwarded by a bridge, so the packet itself is unchanged
+		static const uint16_t defaultBridgePayloadTypes = 0x4300;	//Short, large and relayable application data
+		struct bridgeData
+		{
+			uint8_t from = 0;								//Transport packets are received on
+			uint8_t to = 0;									//Transport they are forwarded to
+			uint16_t payloadTypes = 0;						//Bitmask of payload types forwarded
+			uint32_t packets = 0;							//Packets forwarded
+			uint32_t bytes = 0;								//Bytes forwarded
+			uint32_t drops = 0;								//Packets not forwarded as the destination was busy
+			uint32_t startTime = 0;							//millis() when the bridge was added, for throughput
+		};
+		bridgeData bridges[maximumNumberOfBridges];			//Bridges between transports
+		uint8_t numberOfBridges = 0;						//Number of bridges added
+		uint32_t bridgeHistory[bridgeHistorySize] = {};		//Sender, payload number and start of the block index of recent packets for all nodes, however they arrived
+		uint8_t bridgeHistoryIndex = 0;						//Next slot to fill in the history
+		uint8_t* bridgeStagingBuffer = nullptr;				//Copy of the received packet as it arrived, so it can be forwarded unchanged, allocated when a bridge is added
+		uint8_t bridgeStagingSize = 0;						//Size of the staged packet, 0 if there isn't one
+		bool unpackBridgeMarker();							//Check for and remove the marker a bridge adds to a packet, returns true if it was forwarded by a bridge
+		void stagePacketForBridging();						//Keep a copy of the received packet as it arrived, if a bridge might forward it
+		bool bridgePacket(bool);							//Check a valid received packet for all nodes against the history and queue it on any bridges from its transport, returns true if it is a copy and should be dropped
+		bool sendBridgedPacket();							//Send any bridged packet that is waiting, returns true if this happens
+		void allocateBridging();							//Storage for a bridged packet waiting on each transport that is bridged to
+		
+		//Time synchronisation
+		static const uint8_t timeSyncSize = 8;				//Keepalives carrying network time end with the reference ID, network time, accuracy and reference age
+		static const uint8_t timeSyncMaximumAge = 3 * maximumTickTime / 1000;	//A reference not heard from for this many seconds, directly or through neighbours, has gone
+		bool timeSync = false;								//Is time synchronisation enabled?
+		uint8_t timeSyncReference = 0;						//Node ID whose clock is the network time, this node if it has the lowest ID heard
+		uint8_t timeSyncParent = 0;							//Neighbour that samples of the network time are taken from
+		int32_t timeSyncOffset = 0;							//Network time minus millis() at the last sample
+		int32_t timeSyncLastMeasuredOffset = 0;				//Offset as measured at the last sample, before smoothing
+		float timeSyncDrift = 0;							//Rate the network clock gains on millis(), in ms/ms
+		uint32_t timeSyncLastSample = 0;					//millis() at the last sample
+		uint32_t timeSyncReferenceHeard = 0;				//millis() when the reference last sent its time, going by the age neighbours report
+		uint16_t timeSyncJitter = 0;						//Smoothed difference between samples and the predicted network time
+		uint16_t timeSyncParentAccuracy = 0;				//Accuracy advertised by the neighbour
+		uint8_t timeSyncSamples = 0;						//Samples taken from the current neighbour
+		void checkTimeSyncReference();						//Become the reference if the neighbour has gone quiet
+		void addTimeSyncToPacket(uint8_t);					//Append network time to a packet being built
+		void unpackTimeSync(uint8_t);						//Take a sample of network time from a received packet and remove it
+		void unpackLoRaSlots(uint8_t);						//Record LoRa slots from a received packet and remove them
+		void unpackLoRaLinkData(uint8_t);					//Record LoRa link data from a received packet and remove it
 
 		//Packet encoding/decoding
 		enum class payloadType:uint8_t{						//These are all a bit TBC
@@ -498,16 +870,19 @@ class treacleClass	{
 			//shortApplicationData =		0x06,
 			//idAndNameResolutionResponse =	0x07,
 			shortApplicationData =			0x08,
-			//idAndNameResolutionResponse =	0x09,
-			//idAndNameResolutionResponse =	0x0a,
-			//idAndNameResolutionResponse =	0x0b,
-			//idAndNameResolutionResponse =	0x0c,
-			//idAndNameResolutionResponse =	0x0d,
-			//idAndNameResolutionResponse =	0x0e,
+			largeApplicationData =			0x09,
+			largeApplicationDataAck =		0x0a,
+			applicationDataParity =			0x0b,
+			acknowledgedApplicationData =	0x0c,
+			acknowledgedApplicationDataAck =0x0d,
+			relayableApplicationData =		0x0e,
 			//idAndNameResolutionResponse =	0x0f,
 			//These below are bitmask flags
-			encrypted =						0x10
-			//encrypted =					0x20
+			encrypted =						0x10,
+			timeSync =						0x20,
+			loRaSlots =						0x40,
+			loRaLinkData =					0x80,
+			espNowLargeFrames =				0x40		//On ESP-Now keepalives the LoRa slots flag instead advertises large frame support
 			//encrypted =					0x40
 			//encrypted =					0x80
 			};
@@ -526,8 +901,8 @@ class treacleClass	{
 			payload =			10							//Payload starts here!
 			};
 		//Encoding/decoding functions
-		void buildPacketHeader(uint8_t,						//Put standard packet header in first X bytes
-			uint8_t, payloadType);
+		void buildPacketHeader(uint8_t,						//Put standard packet header in first X bytes, packets not sent on a tick give the time to the next one
+			uint8_t, payloadType, bool onTick = true);
 		void buildKeepalivePacket(uint8_t);					//Keepalive packet
 		void buildIdResolutionRequestPacket(				//ID resolution request - which ID has this name?
 			uint8_t, char*);
@@ -571,11 +946,23 @@ class treacleClass	{
 		bool validatePacketChecksum(uint8_t*,				//Check the checksum of a packet. Also decreases the payload size!
 			uint8_t&);
 					
+		//Transport selection
+		float targetDeliveryProbability = 0.95;				//Chance each recipient should get a message, across the transports chosen
+		uint8_t lastTransportSelection = 0;					//Transports chosen for the last message
+		uint8_t selectTransports(uint8_t, uint32_t*,		//Choose the cheapest set of the available transports that reaches each recipient with the target probability
+			uint8_t, bool);
+		uint32_t transportCost(uint8_t, uint8_t, bool);		//Cost of sending a packet on a transport from its airtime, remaining duty cycle, latency and fixed cost
+		float deliveryProbability(uint8_t, uint8_t);		//Chance a node receives a packet on a transport, from its reliability history
+		uint8_t deliveryChance(uint8_t, uint8_t);			//The same in sixteenths, which is how the reliability history counts it
+		uint8_t* deliveryChances = nullptr;					//Delivery chance of each node on each transport, worked out once per transport selection, allocated in begin()
+		
 		//Transport abstraction helpers
 		bool sendBuffer(uint8_t, uint8_t*,					//Picks the appropriate sendBuffer function based on transport
 			uint8_t payloadSize);
 		bool packetInQueue();								//Check queue for every transport
 		bool packetInQueue(uint8_t);						//Check queue for a specific transport
+		bool sendBackingOff(uint8_t);						//Is a transport waiting out a backoff after finding the channel busy, so nothing can be sent between ticks?
+		bool backOffAfterBusyChannel(uint8_t);				//After a failed send, back off if it failed because the channel was busy, returns true if so and the packet should stay pending
 		bool online(uint8_t, uint8_t);						//Is a specific treacle node online for a specific protocol? ie. has this node heard from it recently
 		
 		//ESP-Now specific settings
@@ -586,14 +973,79 @@ class treacleClass	{
 			uint8_t preferredespNowChannel = 1;				//It may not be possible to switch to the preferred channel if it is a WiFi client
 			uint8_t currentEspNowChannel = 0;				//Track this, as it's not fixed if the device is a WiFi client
 			bool currentEspNowChannelChanged = true;		//Flag to inform the application if the channel changes
+			uint8_t lastEspNowMacAddress[6] = {};			//MAC address the last ESP-Now packet was received from
+			uint8_t* espNowMacAddresses = nullptr;			//MAC address of each node, learned from the packets it sends, IF ESP-Now is enabled
+			static const uint8_t espNowMaximumPeers = 19;	//The radio allows 20 peers, one of which is the broadcast address
+			uint8_t espNowPeerNodeIndex[espNowMaximumPeers];//Node index of each unicast peer
+			uint32_t espNowPeerLastUsed[espNowMaximumPeers];//When each unicast peer was last sent to, so the least recently used can be removed
+			uint8_t numberOfEspNowPeers = 0;				//Unicast peers currently added
+			uint32_t espNowPeerEvictions = 0;				//Peers removed to make room for another
+			#if defined(ESP8266)
+				static const uint8_t espNowTxWindow = 2;	//Frames that can be waiting for the send callback, fewer on ESP8266 to save memory
+			#else
+				static const uint8_t espNowTxWindow = 4;	//Frames that can be waiting for the send callback
+			#endif
+			static const uint32_t espNowTxTimeout = 100E3;	//micros before a frame with no send callback is counted as dropped
+			static const uint8_t espNowTxRecords = 2 * espNowTxWindow;	//Frames remembered, including timed out ones whose send callback may still come
+			uint32_t espNowTxStartTimes[espNowTxRecords];	//When each frame was sent, in micros
+			uint8_t espNowTxMacAddresses[espNowTxRecords][6];	//Where each frame was sent, to match it with its send callback
+			volatile uint8_t espNowTxHead = 0;				//Count of frames sent, only changed when sending
+			volatile uint8_t espNowTxTail = 0;				//Count of frames completed, by the send callback or timing out
+			volatile uint8_t espNowTxTimedOutTail = 0;		//Count of frames no longer waiting for a send callback, behind the tail while timed out frames might still get one
+			#if defined(ESP32)
+				portMUX_TYPE espNowTxLock = portMUX_INITIALIZER_UNLOCKED;	//The send callback runs in the WiFi task, so changes to the frames in flight are made inside this
+			#endif
+			uint32_t espNowLastTxCompletion = 0;			//When the previous frame completed, frames sent back to back only start on air after it
+			bool espNowLargeFrames = false;					//Advertise and use large frames? Off by default as older releases take the flag for LoRa slots
+			uint32_t espNowLargeFrameNodes[nodeBitmaskSize] = {};	//Nodes that have said they can receive large frames
+			uint32_t espNowLargeFramesSent = 0;				//Large frames sent
+			uint8_t* espNowTxFrame = nullptr;				//Packets held to be sent together in one large frame, IF the radio supports them
+			uint16_t espNowTxFrameLength = 0;				//Amount of the large frame filled so far
+			uint8_t* espNowRxFrame = nullptr;				//Large frame received, handed on one packet at a time, IF the radio supports them
+			volatile uint16_t espNowRxFrameLength = 0;		//Size of the received large frame, 0 when it is free
+			uint16_t espNowRxFramePosition = 0;				//Next packet in the received large frame
+			uint8_t espNowRxFrameMacAddress[6] = {};		//MAC address the large frame was received from
+			//ESP-Now channel discovery
+			static const uint16_t espNowChannelCheckInterval = 100;	//ms between checks of the WiFi channel
+			static const uint16_t espNowScanDwellTime = 250;//ms spent on each channel waiting for a reply
+			static const uint8_t espNowMaximumChannel = 13;	//Channels searched, 14 is only allowed in Japan
+			bool espNowChannelDiscovery = false;			//Search other channels if contact is lost?
+			bool espNowScanning = false;					//Is a search in progress?
+			uint8_t espNowScanChannelsTried = 0;			//Channels tried in this search
+			uint32_t espNowScanStepTime = 0;				//millis() when the current channel was tried, or the last search finished
+			uint32_t espNowLastChannelCheck = 0;			//millis() when the WiFi channel was last checked
+			uint32_t espNowLastRx = 0;						//millis() when an ESP-Now packet was last received from another node
+			uint32_t espNowRejoinStart = 0;					//millis() when the channel changed or contact was lost, 0 if not rejoining
+			uint32_t espNowRejoinTime = 0;					//Time taken to hear another node the last time
+			uint32_t espNowRejoins = 0;						//Times contact was regained
+			bool espNowChannelLocked();						//Does a WiFi connection fix the channel?
+			void checkEspNowChannel();						//Follow channel changes by the access point and search for the other nodes if they are lost
+			void espNowChannelMoved();						//Add the peers back on the channel now in use
+			void espNowPacketReceived(uint8_t);				//Track contact with other nodes, and reply quickly to one that has just arrived
+			void bringForwardEspNowTick();					//Send an ESP-Now keepalive straight away
 			//ESP-Now specific functions
 			bool initialiseWiFi();							//Initialise WiFi and return result. Only changes things if WiFi is not already set up when treacle begins
 			bool changeWiFiChannel(uint8_t channel);		//Change the WiFi channel
 			bool initialiseEspNow();						//Initialise ESP-Now and return result
 			bool addEspNowPeer(uint8_t*);					//Add a peer, including relevant channel/interface for the time of addition
 			bool deleteEspNowPeer(uint8_t*);				//Delete a peer
+			uint8_t* espNowPeerMacAddress(uint8_t);			//Get the MAC address to send to a node, adding it as a peer if needed. Falls back to broadcast if the address is unknown
+			uint8_t espNowPeerIndex(uint8_t);				//Find a node in the unicast peer table, numberOfEspNowPeers if it is not there
+			void removeEspNowPeer(uint8_t);					//Delete a unicast peer from the radio and the peer table
+			void removeAllEspNowPeers();					//Delete every unicast peer, eg. when the channel changes
 			bool sendBufferByEspNow(uint8_t*,				//Send a buffer using ESP-Now
 				uint8_t);
+			bool sendEspNowData(uint8_t*, uint8_t*,			//Send a packet or large frame to a MAC address, within the window of frames in flight
+				uint16_t);
+			bool espNowTxWindowFull();						//Are too many frames waiting for the send callback?
+			void espNowSendComplete(const uint8_t*, bool);	//Match a send callback with the frame it is for, skipping timed out frames
+			void espNowTxComplete(bool);					//Record the airtime and result of the oldest frame in flight
+			void allocateEspNowLargeFrames();				//Storage for large frames, IF the radio supports them
+			bool espNowLargeFramesUsable();					//Can every node reachable by ESP-Now receive large frames?
+			bool addToEspNowFrame(uint8_t*, uint8_t);		//Hold a broadcast packet to send in a large frame, sending the frame first if it is full
+			bool sendEspNowFrame();							//Send the held packets as one large frame
+			bool receiveEspNow();							//Pass on the next packet from a received large frame
+			void unpackEspNowFlags(uint8_t);				//Record and remove the large frame flag from a keepalive
 		#endif
 		
 		//LoRa specific settings
@@ -607,16 +1059,113 @@ class treacleClass	{
 			uint8_t loRaSpreadingFactor = 9;				//LoRa spreading factor
 			uint32_t loRaSignalBandwidth= 62.5E3;			//Supported values are 7.8E3, 10.4E3, 15.6E3, 20.8E3, 31.25E3, 41.7E3, 62.5E3, 125E3(default), 250E3, and 500E3.
 			uint8_t loRaRxGain = 0;							//0-6, 0 = auto
+			uint8_t loRaCodingRate = 5;						//Coding rate denominator, 5-8 for 4/5 to 4/8
+			uint16_t loRaPreambleLength = 8;				//Preamble length in symbols
 			uint8_t loRaSyncWord = 0x12;					//Valid options are 0x12, 0x56, 0x78, don't use 0x34 as that is LoRaWAN
-			int16_t lastLoRaRssi = 0;						//Track RSSI as an extra indication of reachability
-			float lastLoRaSNR = 0;							//Track SNR as an extra indication of reachability
+			int16_t lastLoRaRssi = 0;						//RSSI of the LoRa packet being unpacked
+			float lastLoRaSNR = 0;							//SNR of the LoRa packet being unpacked
+			#if !defined(AVR)								//AVR doesn't have the memory for a pool, packets go straight into receiveBuffer
+				static const uint8_t loRaRxQueueLength = 4;	//Received packets that can wait to be unpacked
+				struct loRaRxSlot
+				{
+					uint8_t length = 0;						//Size of the packet
+					int16_t rssi = 0;						//RSSI it was received with
+					float snr = 0;							//SNR it was received with
+					uint8_t data[maximumBufferSize];		//The packet
+				};
+				loRaRxSlot* loRaRxQueue = nullptr;			//Pool of received packets, allocated during begin()
+				volatile uint8_t loRaRxQueueHead = 0;		//Count of packets added, only changed when receiving
+				volatile uint8_t loRaRxQueueTail = 0;		//Count of packets removed, only changed when unpacking
+			#endif
 			int16_t* rssi;									//Store last RSSI for each node, IF LoRa is enabled
 			float* snr;										//Store last SNR for each node, IF LoRa is enabled
 			//LoRa specific functions
 			bool initialiseLoRa();							//Initialise LoRa and return result
 			bool sendBufferByLoRa(uint8_t*,					//Send a buffer using ESP-Now
 				uint8_t);
-			bool receiveLoRa();								//Polling receive function
+			bool receiveLoRa();								//Poll the radio if needed, then pass on any queued packet
+			void queueLoRaPacket(int);						//Read a received packet from the radio into the queue, or receiveBuffer on AVR, from the IRQ or polling
+			void receiveMissedLoRaPacket();					//Read a packet whose IRQ edge was missed while powered down
+			//LoRa asynchronous transmit
+			static const uint32_t loRaTxTimeout = 100E3;	//micros allowed beyond twice the time on air before a missed TX done is assumed
+			volatile uint32_t loRaTxDuration = 0;			//Calculated time on air of the packet being sent, in micros
+			bool loRaTransmitting();						//Is a packet still being sent? Completes the send if it has finished
+			void loRaTransmitComplete();					//Update the counters once a packet has been sent, from the IRQ or polling
+			//LoRa slots
+			static const uint8_t loRaMaximumNumberOfSlots = 32;	//Slots are tracked in 32-bit bitmasks
+			static const uint8_t loRaSlotGuardTime = 20;	//ms added to each slot to allow for network time error
+			uint8_t loRaNumberOfSlots = 0;					//Slots in each frame, 0 if ticks are randomised instead
+			uint8_t loRaSlot = 255;							//Slot this node sends ticks in, 255 until one is chosen
+			uint32_t loRaSlotChanges = 0;					//Times the slot has been changed to avoid another node
+			uint8_t* loRaNodeSlot = nullptr;				//Slot each node says it uses, 255 if unknown
+			uint32_t* loRaNodeSlotNeighbours = nullptr;		//Bitmask of slots used by each node's neighbours, other than this node
+			void allocateLoRaSlots();						//Storage for the slots of other nodes
+			uint32_t loRaSlotLength();						//Long enough for the largest packet, in ms
+			void bringForwardLoRaTick();					//Make the LoRa tick due now, or in this node's next slot
+			uint16_t timeToLoRaSlot(uint16_t);				//Time to the start of this node's slot, at least some time in the future
+			uint16_t nextLoRaSlotTick();					//Choose the slot if needed, then give the next tick time
+			void selectLoRaSlot();							//Keep the slot, or move to a free one if it clashes with another node
+			void addLoRaSlotToPacket();						//Append the slots of this node and its neighbours to a packet being built
+			void recordLoRaSlots(uint8_t, uint8_t,			//Record the slots of a neighbour and its neighbours from a received packet
+				uint8_t);
+			//LoRa listen before talk
+			static const uint8_t loRaMaximumDeferrals = 6;	//Consecutive ticks put back before transmitting regardless
+			static const int16_t loRaBusyRssi = -90;		//RSSI above which the channel is busy, without an IRQ pin for channel activity detection
+			bool loRaListenBeforeTalk = false;				//Check the channel before transmitting?
+			volatile uint8_t loRaCadResult = 0;				//Channel activity detection result, 0 while waiting, 1 clear, 2 activity
+			bool loRaChannelWasBusy = false;				//Did the last transmission fail because the channel was busy?
+			uint8_t loRaConsecutiveDeferrals = 0;			//Ticks and packets put back in a row
+			uint32_t loRaDeferrals = 0;						//Ticks and packets put back because the channel was busy
+			uint32_t loRaBackoffStart = 0;					//millis() when the channel was last found busy
+			uint32_t loRaBackoffTime = 0;					//Packets sent between ticks wait this long after the channel was found busy, 0 if they don't
+			uint32_t loRaChannelBusyEvents = 0;				//Channel checks that found activity
+			bool loRaChannelClear();						//Check for activity on the channel
+			uint32_t loRaBackoff();							//Random backoff in ms, growing with each deferral, or the wait for this node's slot
+			uint32_t deferLoRaSend();						//Count a tick or packet put back because the channel was busy and start the backoff, returns its length in ms
+			uint32_t timeToLoRaBackoffEnd();				//ms until packets can be sent between ticks again, 0 if there is no backoff
+			//LoRa adaptive data rate
+			static const uint8_t loRaMinimumSpreadingFactor = 7;		//Lowest spreading factor used
+			static const uint32_t loRaDataRateSwitchInterval = 600E3;	//Spreading factor changes happen on boundaries of network time this far apart, so all nodes change together
+			static const uint32_t loRaDataRateExpiry = 1800E3;	//A node's requirement that isn't refreshed for this long is forgotten
+			static const uint32_t loRaDataRateHoldTime = 3600E3;//After losing contact, stay at the configured settings this long
+			static const uint16_t loRaBeaconGuardTime = 1000;	//ms at the configured spreading factor before a beacon, and added to the listen after it for replies
+			static const uint8_t loRaBeaconFlag = 0x80;		//Set on the spreading factor in the link data of a beacon, which is then the one the network is using
+			static const int8_t loRaUnknownSnr = 127;		//No SNR reported yet
+			bool loRaAdaptiveDataRate = false;				//Adapt the spreading factor and TX power?
+			uint8_t loRaDataRateMargin = 10;				//SNR margin in dB above the demodulation floor
+			uint8_t loRaBaseSpreadingFactor = 9;			//Configured spreading factor, which is the safe fallback
+			uint8_t loRaBaseTxPower = 17;					//Configured TX power, which is the most used
+			uint8_t loRaRequiredSpreadingFactor = 0;		//Highest spreading factor any node needs, as heard in keepalives
+			uint8_t loRaRequiredSpreadingFactorOrigin = 0;	//Node that needs it
+			uint32_t loRaRequiredSpreadingFactorTime = 0;	//Network time its need was last refreshed
+			uint8_t loRaPendingSpreadingFactor = 0;			//Requirement at the last boundary, which must be unchanged at the next for a switch
+			uint32_t loRaDataRatePeriod = 0;				//Network time divided by the switch interval
+			uint32_t loRaDataRateSwitchTime = 0;			//millis() of the last switch, 0 once contact has been confirmed
+			uint32_t loRaDataRateHoldStart = 0;				//millis() of the last fallback, 0 if not holding
+			uint32_t loRaDataRateFallbacks = 0;				//Switches reverted
+			uint8_t loRaBeaconSpreadingFactor = 0;			//Spreading factor to go back to after a beacon at the configured one, 0 if not beaconing
+			uint8_t loRaBeaconTxPower = 0;					//TX power to go back to after a beacon
+			uint32_t loRaBeaconTxPackets = 0;				//Packets sent before the beacon, so the start of the listen can be seen
+			uint32_t loRaLastBeacon = 0;					//millis() of the last beacon
+			uint32_t loRaBeaconListenStart = 0;				//millis() the beacon was sent, 0 until it has been
+			int8_t* loRaNodeReportedSnr = nullptr;			//SNR each node reports for packets from this node
+			bool* loRaNodeNeededAtSwitch = nullptr;			//Nodes heard just before a switch, which must still be heard afterwards
+			void allocateLoRaDataRate();					//Storage for the SNR other nodes report
+			bool loRaNodeNeedsLoRa(uint8_t);				//Is the node recently heard on LoRa and not reachable any other way?
+			int8_t loRaLinkSnr(uint8_t);					//SNR the node hears this node with, as if at full TX power
+			uint8_t loRaSpreadingFactorForSnr(int8_t);		//Lowest spreading factor that keeps the margin at this SNR
+			void considerLoRaSpreadingFactor(uint8_t,		//Keep the highest spreading factor needed, and who needs it
+				uint8_t, uint32_t);
+			void updateLoRaDataRate();						//Switch spreading factor at boundaries and fall back if contact is lost
+			void setLoRaDataRate(uint8_t, uint8_t);			//Change the radio's spreading factor and TX power
+			void loRaDataRateFallback();					//Go back to the configured settings and hold them
+			void updateLoRaBeacon();						//Send a keepalive at the configured spreading factor now and then, so nodes left there can find the network
+			void checkLoRaBeaconReply(uint8_t);				//Fall back if a node not heard at the current spreading factor answers a beacon
+			void recordLoRaBeacon(uint8_t);					//Join a network heard beaconing, or answer it if that has already failed
+			void adjustLoRaTxPower();						//Nudge TX power towards the margin needed
+			void addLoRaLinkDataToPacket();					//Append SNR of neighbours and spreading factor needed to a packet being built
+			void recordLoRaLinkData(uint8_t, uint8_t,		//Record the SNR and spreading factor needed from a received packet
+				uint8_t);
 		#endif
 		
 		//COBS/Serial specific settings
@@ -669,6 +1218,17 @@ class treacleClass	{
 				bool receiveUDP();							//Polling receiver
 			#elif defined(ESP32)
 				AsyncUDP* udp;								//UDP instance
+				bool receiveUDP();							//Pass on any packet queued by the receive callback
+				static const uint8_t udpRxQueueLength = 4;	//Received packets that can wait to be unpacked
+				struct udpRxSlot
+				{
+					uint8_t length = 0;						//Size of the packet
+					IPAddress address;						//Address it came from
+					uint8_t data[maximumBufferSize];		//The packet
+				};
+				udpRxSlot* udpRxQueue = nullptr;			//Pool of received packets, allocated during begin()
+				volatile uint8_t udpRxQueueHead = 0;		//Count of packets added, only changed by the receive callback
+				volatile uint8_t udpRxQueueTail = 0;		//Count of packets removed, only changed when unpacking
 			#elif defined(AVR)
 				EthernetUDP* udp;							//UDP instance
 				bool receiveUDP();							//Polling receiver
@@ -676,12 +1236,24 @@ class treacleClass	{
 			IPAddress udpMulticastAddress = {224,0,1,38};	//Multicast address
 			uint16_t udpPort = 47625;						//UDP port number
 			bool initialiseUDP();							//Initialise UDP
-			bool sendBufferByUDP(uint8_t*,					//Send a buffer using COBS
+			bool sendBufferByUDP(uint8_t*,					//Send a buffer using UDP, by multicast or straight to a node
 				uint8_t);
+			static const uint8_t udpMaximumUnicastPeers = 4;//Addresses that can be added to always receive keepalives
+			bool udpUnicast = false;						//Send messages for a single node straight to it?
+			IPAddress lastUDPAddress;						//Address the last UDP packet was received from
+			IPAddress* udpPeerAddresses = nullptr;			//Address of each node, learned from the packets it sends, IF unicast is enabled
+			uint32_t* udpPeerTxPackets = nullptr;			//Packets sent straight to each node, IF unicast is enabled
+			void allocateUDPPeerAddresses();				//Storage for the address of each node
+			IPAddress udpUnicastPeers[udpMaximumUnicastPeers];	//Addresses added to always receive keepalives
+			uint32_t udpUnicastPeerTxPackets[udpMaximumUnicastPeers] = {};	//Packets sent to each of these
+			uint8_t numberOfUDPUnicastPeers = 0;			//Addresses added
+			bool sendUDPDatagram(IPAddress,					//Send a buffer to a multicast or unicast address
+				uint8_t*, uint8_t);
 		#endif
 		
 		//Utility functions
 		uint8_t countBits(uint32_t thingToCount);			//Number of set bits in an uint32_t, or anything else
+		uint8_t countNodeBits(uint32_t* bitmask);			//Number of set bits in a node bitmask
 		float reliabilityPercentage(uint16_t);				//Turn an uint32_t bitmask into a printable reliability measure
 		/*
 		 *
@@ -760,12 +1332,18 @@ class treacleClass	{
 			void debugPrintPayloadTypeDescription(uint8_t type)
 			{
 				if(type & (uint8_t)payloadType::encrypted){debugPrint(treacleDebugString_encrypted);debugPrint(' ');}
-				type = type & (0xff ^ (uint8_t)payloadType::encrypted);	//Remove the encrypted flag!
+				type = type & 0x0f;	//Remove the encrypted, time and slot flags!
 				if(type == (uint8_t)payloadType::keepalive){debugPrint(treacleDebugString_keepalive);}
 				else if(type == (uint8_t)payloadType::idResolutionRequest){debugPrint(treacleDebugString_idResolutionRequest);}
 				else if(type == (uint8_t)payloadType::nameResolutionRequest){debugPrint(treacleDebugString_nameResolutionRequest);}
 				else if(type == (uint8_t)payloadType::idAndNameResolutionResponse){debugPrint(treacleDebugString_nameResolutionResponse);}
 				else if(type == (uint8_t)payloadType::shortApplicationData){debugPrint(treacleDebugString_short_application_data);}
+				else if(type == (uint8_t)payloadType::largeApplicationData){debugPrint(treacleDebugString_large_application_data);}
+				else if(type == (uint8_t)payloadType::largeApplicationDataAck){debugPrint(treacleDebugString_large_application_data_ack);}
+				else if(type == (uint8_t)payloadType::applicationDataParity){debugPrint(treacleDebugString_parity);}
+				else if(type == (uint8_t)payloadType::acknowledgedApplicationData){debugPrint(treacleDebugString_acknowledged_application_data);}
+				else if(type == (uint8_t)payloadType::acknowledgedApplicationDataAck){debugPrint(treacleDebugString_acknowledged_application_data_ack);}
+				else if(type == (uint8_t)payloadType::relayableApplicationData){debugPrint(treacleDebugString_relayable_application_data);}
 			}
 			void debugPrintState(state theState)
 			{
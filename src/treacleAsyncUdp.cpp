@@ -61,6 +61,7 @@ bool treacleClass::initialiseUDP()
 		transport[UDPTransportId].initialised = true;				//Mark as initialised
 	#elif defined(ESP32)
 	udp = new AsyncUDP;
+	udpRxQueue = new udpRxSlot[udpRxQueueLength];					//Received packets wait here until unpacked, before any can arrive
 	if(udp->listenMulticast(udpMulticastAddress, udpPort))
 	{
 		udp->onPacket(
@@ -85,17 +86,19 @@ bool treacleClass::initialiseUDP()
 					treacle.debugPrintln();
 					*/
 				#endif
-				if(treacle.receiveBufferSize == 0 && receivedMessage.length() < treacle.maximumBufferSize)
+				if(treacle.udpRxQueue != nullptr && receivedMessage.length() < treacle.maximumBufferSize &&
+					(uint8_t)(treacle.udpRxQueueHead - treacle.udpRxQueueTail) < treacle.udpRxQueueLength)	//There is a free slot
 				{
 					treacle.transport[treacle.UDPTransportId].rxPackets++;						//Count the packet as received
 					if(receivedMessage.data()[0] == (uint8_t)treacle.nodeId::allNodes ||
 						receivedMessage.data()[0] == treacle.currentNodeId)						//Packet is meaningful to this node
 					{
-						memcpy(treacle.receiveBuffer, receivedMessage.data(), receivedMessage.length());	//Copy the UDP payload into the receive buffer
-						treacle.receiveBufferSize = receivedMessage.length();								//Record the amount of payload
-						treacle.receiveBufferCrcChecked = false;											//Mark the payload as unchecked
-						treacle.receiveTransport = treacle.UDPTransportId;									//Record that it was received by UDP
-						treacle.transport[treacle.UDPTransportId].rxPacketsProcessed++;						//Count the packet as processed
+						treacleClass::udpRxSlot* slot = &treacle.udpRxQueue[treacle.udpRxQueueHead % treacle.udpRxQueueLength];
+						memcpy(slot->data, receivedMessage.data(), receivedMessage.length());		//Copy the UDP payload into the queue
+						slot->length = receivedMessage.length();
+						slot->address = receivedMessage.remoteIP();									//Record where it came from
+						treacle.udpRxQueueHead++;														//Only now is the slot visible to receiveUDP()
+						treacle.transport[treacle.UDPTransportId].rxPacketsProcessed++;				//Count the packet as processed
 					}
 					else
 					{
@@ -136,7 +139,23 @@ bool treacleClass::initialiseUDP()
 	}
 	return transport[UDPTransportId].initialised;
 }
-#if defined(ESP8266) || defined(AVR)
+#if defined(ESP32)
+bool treacleClass::receiveUDP()
+{
+	if(receiveBufferSize == 0 && udpRxQueueTail != udpRxQueueHead)		//Hand the oldest queued packet on once the receive buffer is free
+	{
+		udpRxSlot* slot = &udpRxQueue[udpRxQueueTail % udpRxQueueLength];
+		memcpy(receiveBuffer, slot->data, slot->length);				//Copy the UDP payload
+		lastUDPAddress = slot->address;									//Where it came from, for unpacking
+		receiveBufferSize = slot->length;								//Record the amount of payload
+		receiveBufferCrcChecked = false;								//Mark the payload as unchecked
+		receiveTransport = UDPTransportId;								//Record that it was received by UDP
+		udpRxQueueTail++;												//Free the slot
+		return true;
+	}
+	return false;
+}
+#elif defined(ESP8266) || defined(AVR)
 bool treacleClass::receiveUDP()
 {
 	uint8_t receivedMessageLength = udp->parsePacket();
@@ -149,6 +168,7 @@ bool treacleClass::receiveUDP()
 				udp->peek() == currentNodeId)							//Packet is meaningful to this node
 			{
 				udp->read(receiveBuffer, receivedMessageLength);		//Copy the UDP payload
+				lastUDPAddress = udp->remoteIP();						//Record where it came from
 				receiveBufferSize = receivedMessageLength;				//Record the amount of payload
 				receiveBufferCrcChecked = false;						//Mark the payload as unchecked
 				receiveTransport = UDPTransportId;						//Record that it was received by ESP-Now
@@ -169,43 +189,129 @@ bool treacleClass::receiveUDP()
 }
 #endif
 bool treacleClass::sendBufferByUDP(uint8_t* buffer, uint8_t packetSize)
+{
+	uint8_t recipient = buffer[(uint8_t)headerPosition::recipient];
+	if(recipient != (uint8_t)nodeId::allNodes && udpPeerAddresses != nullptr)
+	{
+		uint8_t nodeIndex = nodeIndexFromId(recipient);
+		if(nodeIndex != maximumNumberOfNodes && udpPeerAddresses[nodeIndex] != IPAddress(0,0,0,0))	//The address has been learned
+		{
+			if(sendUDPDatagram(udpPeerAddresses[nodeIndex], buffer, packetSize))
+			{
+				udpPeerTxPackets[nodeIndex]++;
+				return true;
+			}
+			return false;
+		}
+	}
+	bool result = sendUDPDatagram(udpMulticastAddress, buffer, packetSize);	//Multicast reaches every node that can hear it, and is how nodes find each other
+	if(recipient == (uint8_t)nodeId::allNodes &&
+		(buffer[(uint8_t)headerPosition::payloadType] & 0x0f) == (uint8_t)payloadType::keepalive)
+	{
+		for(uint8_t peerIndex = 0; peerIndex < numberOfUDPUnicastPeers; peerIndex++)
+		{
+			if(sendUDPDatagram(udpUnicastPeers[peerIndex], buffer, packetSize))	//Any that also arrive by multicast are ignored as duplicates
+			{
+				udpUnicastPeerTxPackets[peerIndex]++;
+			}
+		}
+	}
+	return result;
+}
+bool treacleClass::sendUDPDatagram(IPAddress address, uint8_t* buffer, uint8_t packetSize)
 {
 	transport[UDPTransportId].txStartTime = micros();
+	bool sent = false;
 	#if defined(ESP8266)
-		udp->beginPacketMulticast(udpMulticastAddress, udpPort, WiFi.localIP());
-		udp->write(buffer, packetSize);
-		if(udp->endPacket())
+		if(address == udpMulticastAddress)
 		{
-			transport[UDPTransportId].txTime += micros()			//Add to the total transmit time
-				- transport[UDPTransportId].txStartTime;
-			transport[UDPTransportId].txStartTime = 0;				//Clear the initial send time
-			transport[UDPTransportId].txPackets++;					//Count the packet
-			return true;
+			udp->beginPacketMulticast(udpMulticastAddress, udpPort, WiFi.localIP());
 		}
-	#elif defined(ESP32)
-		if(udp->write(buffer, packetSize))
+		else
 		{
-			transport[UDPTransportId].txTime += micros()			//Add to the total transmit time
-				- transport[UDPTransportId].txStartTime;
-			transport[UDPTransportId].txStartTime = 0;				//Clear the initial send time
-			transport[UDPTransportId].txPackets++;					//Count the packet
-			return true;
+			udp->beginPacket(address, udpPort);
 		}
-	#elif defined(AVR)
-		udp->beginPacket(udpMulticastAddress, udpPort);
 		udp->write(buffer, packetSize);
-		if(udp->endPacket())
+		sent = udp->endPacket();
+	#elif defined(ESP32)
+		if(address == udpMulticastAddress)
 		{
-			transport[UDPTransportId].txTime += micros()			//Add to the total transmit time
-				- transport[UDPTransportId].txStartTime;
-			transport[UDPTransportId].txStartTime = 0;				//Clear the initial send time
-			transport[UDPTransportId].txPackets++;					//Count the packet
-			return true;
+			sent = udp->write(buffer, packetSize);
 		}
+		else
+		{
+			sent = udp->writeTo(buffer, packetSize, address, udpPort);
+		}
+	#elif defined(AVR)
+		udp->beginPacket(address, udpPort);
+		udp->write(buffer, packetSize);
+		sent = udp->endPacket();
 	#endif
-	transport[UDPTransportId].txStartTime = 0;
+	if(sent)
+	{
+		recordTxTime(UDPTransportId, micros() - transport[UDPTransportId].txStartTime);			//Add to the total transmit time and duty cycle window
+		transport[UDPTransportId].txPackets++;					//Count the packet
+	}
+	transport[UDPTransportId].txStartTime = 0;					//Clear the initial send time
+	return sent;
+}
+void treacleClass::enableUDPUnicast()
+{
+	udpUnicast = true;
+	if(transport != nullptr && UDPInitialised() && udpPeerAddresses == nullptr)	//Otherwise this happens in begin()
+	{
+		allocateUDPPeerAddresses();
+	}
+}
+void treacleClass::allocateUDPPeerAddresses()
+{
+	udpPeerAddresses = new IPAddress[maximumNumberOfNodes];	//Storage for IP addresses, which start as 0.0.0.0
+	udpPeerTxPackets = new uint32_t[maximumNumberOfNodes];	//Storage for per node counts
+	memset(udpPeerTxPackets, 0, maximumNumberOfNodes * sizeof(uint32_t));
+}
+void treacleClass::disableUDPUnicast()
+{
+	udpUnicast = false;
+	if(udpPeerAddresses != nullptr)
+	{
+		delete[] udpPeerAddresses;
+		delete[] udpPeerTxPackets;
+		udpPeerAddresses = nullptr;
+		udpPeerTxPackets = nullptr;
+	}
+}
+bool treacleClass::addUDPUnicastPeer(IPAddress address)
+{
+	if(numberOfUDPUnicastPeers < udpMaximumUnicastPeers)
+	{
+		udpUnicastPeers[numberOfUDPUnicastPeers++] = address;
+		return true;
+	}
 	return false;
 }
+uint32_t treacleClass::getUDPPeerTxPackets(uint8_t id)
+{
+	if(udpPeerTxPackets != nullptr)
+	{
+		uint8_t nodeIndex = nodeIndexFromId(id);
+		if(nodeIndex != maximumNumberOfNodes)
+		{
+			return udpPeerTxPackets[nodeIndex];
+		}
+	}
+	return 0;
+}
+uint32_t treacleClass::getUDPUnicastPeerTxPackets(IPAddress address)
+{
+	for(uint8_t peerIndex = 0; peerIndex < numberOfUDPUnicastPeers; peerIndex++)
+	{
+		if(udpUnicastPeers[peerIndex] == address)
+		{
+			return udpUnicastPeerTxPackets[peerIndex];
+		}
+	}
+	return 0;
+}
 bool treacleClass::UDPInitialised()
 {
 	if(UDPTransportId != 255)
@@ -114,16 +114,13 @@ bool treacleClass::sendBufferByCobs(uint8_t* buffer, uint8_t packetSize)
 			Serial.printf("%02x ", 0xff);
 			#endif
 			cobsStream_->write((uint8_t)0xff);							//Send the 'no zeroes left in this chunk' marker
-			if(lastZeroOffset > 1)	//Send the data between the previous zero (or the start) and this
+			#if defined(TREACLE_DEBUG_COBS)
+			for(uint8_t chunkIndex = index-(lastZeroOffset-1); chunkIndex <= index; chunkIndex++)
 			{
-				#if defined(TREACLE_DEBUG_COBS)
-				for(uint8_t chunkIndex = index-(lastZeroOffset-1); chunkIndex <= index; chunkIndex++)
-				{
-					Serial.printf("%02x ", buffer[chunkIndex]);
-				}
-				#endif
-				cobsStream_->write(&buffer[index-(lastZeroOffset-1)], lastZeroOffset);
+				Serial.printf("%02x ", buffer[chunkIndex]);
 			}
+			#endif
+			cobsStream_->write(&buffer[index-(lastZeroOffset-1)], lastZeroOffset);	//Send the data after the previous zero, which may be a single byte
 			lastZeroOffset = 0;
 		}
 	}
@@ -131,8 +128,7 @@ bool treacleClass::sendBufferByCobs(uint8_t* buffer, uint8_t packetSize)
 	#if defined(TREACLE_DEBUG_COBS)
 	Serial.printf("%02x\r\n", 0x00);
 	#endif
-	transport[cobsTransportId].txTime += micros()		//Add to the total transmit time
-		- transport[cobsTransportId].txStartTime;
+	recordTxTime(cobsTransportId, micros() - transport[cobsTransportId].txStartTime);		//Add to the total transmit time and duty cycle window
 	transport[cobsTransportId].txStartTime = 0;			//Clear the initial send time
 	transport[cobsTransportId].txPackets++;				//Count the packet
 	//debugPrintln("\r\nTX COBS packet");
@@ -175,11 +171,18 @@ bool treacleClass::receiveCobs()
 					}
 				}
 			}
-			#if defined(TREACLE_DEBUG_COBS)
 			if(cobsStream_->peek() == 0)
 			{
-				Serial.printf_P(PSTR("%02x"), cobsStream_->read());
+				if(nextZero == 1 && receiveBufferSize < maximumBufferSize)		//The packet itself ended in a zero, which is only marked by the last chunk
+				{
+					receiveBuffer[receiveBufferSize++] = 0;
+				}
+				cobsStream_->read();											//Consume the trailing zero so back to back packets are decoded from the right place
+				#if defined(TREACLE_DEBUG_COBS)
+				Serial.printf_P(PSTR("%02x"), 0);
+				#endif
 			}
+			#if defined(TREACLE_DEBUG_COBS)
 			else
 			{
 				Serial.print(F("timeout"));
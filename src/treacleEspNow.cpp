@@ -66,6 +66,23 @@ uint8_t treacleClass::getEspNowChannel()
 {
 	return currentEspNowChannel;								//Gets the current channel
 }
+void treacleClass::enableEspNowChannelDiscovery()
+{
+	espNowChannelDiscovery = true;
+}
+void treacleClass::disableEspNowChannelDiscovery()
+{
+	espNowChannelDiscovery = false;
+	espNowScanning = false;
+}
+uint32_t treacleClass::getEspNowRejoinTime()
+{
+	return espNowRejoinTime;
+}
+uint32_t treacleClass::getEspNowRejoins()
+{
+	return espNowRejoins;
+}
 #if defined(ESP32)
 bool treacleClass::enableEspNowLrMode()
 {
@@ -128,6 +145,42 @@ uint32_t treacleClass::getEspNowTxPacketsDropped()
 	}
 	return 0;
 }
+void treacleClass::enableEspNowLargeFrames()
+{
+	espNowLargeFrames = true;
+	if(transport != nullptr && espNowInitialised() && espNowTxFrame == nullptr)	//Otherwise this happens in begin()
+	{
+		allocateEspNowLargeFrames();
+	}
+}
+void treacleClass::disableEspNowLargeFrames()
+{
+	espNowLargeFrames = false;
+}
+void treacleClass::allocateEspNowLargeFrames()
+{
+	#if defined(TREACLE_ESPNOW_LARGE_FRAMES)
+		uint32_t espNowVersion = 0;
+		if(esp_now_get_version(&espNowVersion) == ESP_OK && espNowVersion >= 2)	//Large frames need ESP-Now v2
+		{
+			espNowTxFrame = new uint8_t[ESP_NOW_MAX_DATA_LEN_V2];
+			espNowRxFrame = new uint8_t[ESP_NOW_MAX_DATA_LEN_V2];
+			transport[espNowTransportId].maximumFrameSize = ESP_NOW_MAX_DATA_LEN_V2;	//Only once there is somewhere to put them
+		}
+	#endif
+}
+uint32_t treacleClass::getEspNowLargeFrames()
+{
+	return espNowLargeFramesSent;
+}
+uint8_t treacleClass::getEspNowPeers()
+{
+	return numberOfEspNowPeers;
+}
+uint32_t treacleClass::getEspNowPeerEvictions()
+{
+	return espNowPeerEvictions;
+}
 float treacleClass::getEspNowDutyCycle()
 {
 	if(espNowInitialised())
@@ -326,6 +379,7 @@ void treacleClass::esp8266receiveCallback(uint8_t *macAddress, uint8_t *received
 				receivedMessage[(uint8_t)headerPosition::recipient] == currentNodeId)	//Packet is meaningful to this node
 			{
 				memcpy(&receiveBuffer,receivedMessage,receivedMessageLength);	//Copy the ESP-Now payload
+				memcpy(lastEspNowMacAddress, macAddress, 6);					//Record where it came from
 				receiveBufferSize = receivedMessageLength;						//Record the amount of payload
 				receiveBufferCrcChecked = false;								//Mark the payload as unchecked
 				receiveTransport = espNowTransportId;							//Record that it was received by ESP-Now
@@ -348,20 +402,7 @@ void treacleEsp8266sendCallbackWrapper(uint8_t* macAddress, uint8_t status)	//ES
 }
 void treacleClass::esp8266sendCallback(uint8_t* macAddress, uint8_t status)	//ESP-Now send callback is used to measure airtime for duty cycle calculations
 {
-	if(status == ESP_OK)
-	{
-		if(transport[espNowTransportId].txStartTime != 0)				//Check the initial send time was recorded
-		{
-			transport[espNowTransportId].txTime += micros()			//Add to the total transmit time
-				- transport[espNowTransportId].txStartTime;
-			transport[espNowTransportId].txStartTime = 0;				//Clear the initial send time
-		}
-		transport[espNowTransportId].txPackets++;						//Count the packet
-	}
-	else
-	{
-		transport[espNowTransportId].txPacketsDropped++;				//Count the drop
-	}
+	espNowSendComplete(macAddress, status == ESP_OK);
 }
 #endif
 bool treacleClass::initialiseEspNow()
@@ -416,6 +457,24 @@ bool treacleClass::initialiseEspNow()
 				#endif
 						if(treacle.currentState != treacle.state::starting)	//Must not receive packets before the buffers are allocated
 						{
+							#if defined(TREACLE_ESPNOW_LARGE_FRAMES)
+							if(receivedMessageLength > treacle.maximumBufferSize)							//A large frame carrying several packets
+							{
+								if(treacle.espNowRxFrame != nullptr && treacle.espNowRxFrameLength == 0 &&
+									receivedMessageLength <= treacle.transport[treacle.espNowTransportId].maximumFrameSize)	//Check the large frame buffer is free first
+								{
+									memcpy(treacle.espNowRxFrame, receivedMessage, receivedMessageLength);		//Copy the whole frame, it is split up by receiveEspNow()
+									memcpy(treacle.espNowRxFrameMacAddress, macAddress, 6);						//Record where it came from
+									treacle.espNowRxFramePosition = 0;
+									treacle.espNowRxFrameLength = receivedMessageLength;						//Only now is the frame visible to receiveEspNow()
+								}
+								else
+								{
+									treacle.transport[treacle.espNowTransportId].rxPacketsDropped++;		//Count the drop
+								}
+								return;
+							}
+							#endif
 							if(treacle.receiveBufferSize == 0 && receivedMessageLength < treacle.maximumBufferSize)	//Check the receive buffer is empty first
 							{
 								treacle.transport[treacle.espNowTransportId].rxPackets++;					//Count the packet as received
@@ -423,6 +482,7 @@ bool treacleClass::initialiseEspNow()
 									receivedMessage[(uint8_t)treacle.headerPosition::recipient] == treacle.currentNodeId)	//Packet is meaningful to this node
 								{
 									memcpy(&treacle.receiveBuffer,receivedMessage,receivedMessageLength);	//Copy the ESP-Now payload
+									memcpy(treacle.lastEspNowMacAddress, macAddress, 6);					//Record where it came from
 									treacle.receiveBufferSize = receivedMessageLength;						//Record the amount of payload
 									treacle.receiveBufferCrcChecked = false;								//Mark the payload as unchecked
 									treacle.receiveTransport = treacle.espNowTransportId;					//Record that it was received by ESP-Now
@@ -449,20 +509,7 @@ bool treacleClass::initialiseEspNow()
 						[](const uint8_t* macAddress, esp_now_send_status_t status)							//ESP-Now send callback is used to measure airtime for duty cycle calculations
 					#endif
 						{
-							if(status == ESP_OK)
-							{
-								if(treacle.transport[treacle.espNowTransportId].txStartTime != 0)			//Check the initial send time was recorded
-								{
-									treacle.transport[treacle.espNowTransportId].txTime += micros()			//Add to the total transmit time
-										- treacle.transport[treacle.espNowTransportId].txStartTime;
-									treacle.transport[treacle.espNowTransportId].txStartTime = 0;			//Clear the initial send time
-								}
-								treacle.transport[treacle.espNowTransportId].txPackets++;					//Count the packet
-							}
-							else
-							{
-								treacle.transport[treacle.espNowTransportId].txPacketsDropped++;			//Count the drop
-							}
+							treacle.espNowSendComplete(macAddress, status == ESP_NOW_SEND_SUCCESS);
 						}
 					) == ESP_OK)
 					{
@@ -509,6 +556,10 @@ bool treacleClass::initialiseEspNow()
 		{
 			transport[espNowTransportId].defaultTick = maximumTickTime/10;
 			transport[espNowTransportId].minimumTick = maximumTickTime/100;
+			if(espNowLargeFrames == true)
+			{
+				allocateEspNowLargeFrames();
+			}
 			#if defined(TREACLE_DEBUG)
 				debugPrintln(treacleDebugString_OK);
 			#endif
@@ -594,35 +645,430 @@ bool treacleClass::deleteEspNowPeer(uint8_t* macaddress)
 	return false;
 }
 
+uint8_t* treacleClass::espNowPeerMacAddress(uint8_t id)
+{
+	uint8_t nodeIndex = nodeIndexFromId(id);
+	if(nodeIndex != maximumNumberOfNodes && espNowMacAddresses != nullptr)
+	{
+		uint8_t* macAddress = &espNowMacAddresses[nodeIndex * 6];
+		if((macAddress[0] | macAddress[1] | macAddress[2] | macAddress[3] | macAddress[4] | macAddress[5]) != 0)	//The address has been learned
+		{
+			uint8_t peerIndex = espNowPeerIndex(nodeIndex);
+			if(peerIndex == numberOfEspNowPeers)									//Not a peer yet
+			{
+				if(numberOfEspNowPeers == espNowMaximumPeers)						//The peer table is full, so remove the least recently used
+				{
+					uint8_t leastRecentlyUsed = 0;
+					for(uint8_t index = 1; index < numberOfEspNowPeers; index++)
+					{
+						if(millis() - espNowPeerLastUsed[index] > millis() - espNowPeerLastUsed[leastRecentlyUsed])
+						{
+							leastRecentlyUsed = index;
+						}
+					}
+					removeEspNowPeer(leastRecentlyUsed);
+					espNowPeerEvictions++;
+				}
+				if(esp_now_is_peer_exist(macAddress) == 0 && addEspNowPeer(macAddress) == false)
+				{
+					return broadcastMacAddress;
+				}
+				peerIndex = numberOfEspNowPeers++;
+				espNowPeerNodeIndex[peerIndex] = nodeIndex;
+			}
+			espNowPeerLastUsed[peerIndex] = millis();
+			return macAddress;
+		}
+	}
+	return broadcastMacAddress;	//The radio won't ACK or retry, but the packet will still reach the node if it can hear it
+}
+uint8_t treacleClass::espNowPeerIndex(uint8_t nodeIndex)
+{
+	for(uint8_t peerIndex = 0; peerIndex < numberOfEspNowPeers; peerIndex++)
+	{
+		if(espNowPeerNodeIndex[peerIndex] == nodeIndex)
+		{
+			return peerIndex;
+		}
+	}
+	return numberOfEspNowPeers;
+}
+void treacleClass::removeEspNowPeer(uint8_t peerIndex)
+{
+	deleteEspNowPeer(&espNowMacAddresses[espNowPeerNodeIndex[peerIndex] * 6]);
+	numberOfEspNowPeers--;
+	espNowPeerNodeIndex[peerIndex] = espNowPeerNodeIndex[numberOfEspNowPeers];	//Order doesn't matter, so fill the gap with the last peer
+	espNowPeerLastUsed[peerIndex] = espNowPeerLastUsed[numberOfEspNowPeers];
+}
+void treacleClass::removeAllEspNowPeers()
+{
+	while(numberOfEspNowPeers > 0)
+	{
+		removeEspNowPeer(numberOfEspNowPeers - 1);
+	}
+}
 bool treacleClass::sendBufferByEspNow(uint8_t* buffer, uint8_t packetSize)
 {
-	transport[espNowTransportId].txStartTime = micros();
-	
+	if(espNowTxWindowFull())
+	{
+		return false;										//Wait for a frame in flight to complete
+	}
+	#if defined(TREACLE_ESPNOW_LARGE_FRAMES)
+		if(espNowTxFrameLength > 0)							//Packets are being held for a large frame
+		{
+			if(buffer[(uint8_t)headerPosition::recipient] == (uint8_t)nodeId::allNodes &&
+				espNowTxFrameLength + 1 + packetSize <= transport[espNowTransportId].maximumFrameSize)
+			{
+				addToEspNowFrame(buffer, packetSize);		//This packet goes in the frame too
+				return sendEspNowFrame();
+			}
+			if(sendEspNowFrame() == false || espNowTxWindowFull())	//Send the held packets on their own first
+			{
+				return false;
+			}
+		}
+	#endif
+	uint8_t* destinationMacAddress = broadcastMacAddress;
+	if(buffer[(uint8_t)headerPosition::recipient] != (uint8_t)nodeId::allNodes)
+	{
+		destinationMacAddress = espNowPeerMacAddress(buffer[(uint8_t)headerPosition::recipient]);	//Unicast gets link layer ACKs and retries
+	}
+	return sendEspNowData(destinationMacAddress, buffer, packetSize);
+}
+bool treacleClass::espNowTxWindowFull()
+{
+	if((uint8_t)(espNowTxHead - espNowTxTail) >= espNowTxWindow)
+	{
+		if(micros() - espNowTxStartTimes[espNowTxTail % espNowTxRecords] < espNowTxTimeout)
+		{
+			return true;
+		}
+		#if defined(ESP32)
+			portENTER_CRITICAL(&espNowTxLock);
+		#endif
+		if((uint8_t)(espNowTxHead - espNowTxTail) >= espNowTxWindow)	//The send callback may have come in the meantime
+		{
+			espNowTxComplete(false);						//The send callback is late or missed, so give up on the oldest frame, a late callback is ignored
+		}
+		#if defined(ESP32)
+			portEXIT_CRITICAL(&espNowTxLock);
+		#endif
+	}
+	return false;
+}
+bool treacleClass::sendEspNowData(uint8_t* destinationMacAddress, uint8_t* data, uint16_t length)
+{
+	if(espNowTxWindowFull())
+	{
+		return false;
+	}
+	#if defined(ESP32)
+		portENTER_CRITICAL(&espNowTxLock);
+	#endif
+	if((uint8_t)(espNowTxHead - espNowTxTimedOutTail) >= espNowTxRecords)
+	{
+		espNowTxTimedOutTail++;								//Stop waiting for the callback of the oldest timed out frame, to make room
+	}
+	espNowTxStartTimes[espNowTxHead % espNowTxRecords] = micros();
+	memcpy(espNowTxMacAddresses[espNowTxHead % espNowTxRecords], destinationMacAddress, 6);
+	espNowTxHead++;											//Done first, as the send callback can happen before esp_now_send() returns
+	if((uint8_t)(espNowTxHead - espNowTxTail) >= espNowTxWindow)
+	{
+		transport[espNowTransportId].txStartTime = espNowTxStartTimes[espNowTxTail % espNowTxRecords] | 1;	//Window full, nothing else can be sent until a frame completes
+	}
+	#if defined(ESP32)
+		portEXIT_CRITICAL(&espNowTxLock);
+	#endif
 	#if defined(ESP8266)
-	int8_t espNowSendResult = esp_now_send(broadcastMacAddress, buffer, (size_t)packetSize);
+	int8_t espNowSendResult = esp_now_send(destinationMacAddress, data, (size_t)length);
 	#elif defined(ESP32)
-	esp_err_t espNowSendResult = esp_now_send(broadcastMacAddress, buffer, (size_t)packetSize);
+	esp_err_t espNowSendResult = esp_now_send(destinationMacAddress, data, (size_t)length);
 	#endif
 	if(espNowSendResult == ESP_OK)
 	{
-		return true;	//The send callback function records success/fail and txTime from here on
+		return true;	//The send callback function records success/fail and txTime from here on, the data has been copied so it can be reused
 	}
 	else
 	{
+		#if defined(ESP32)
+			portENTER_CRITICAL(&espNowTxLock);
+		#endif
+		espNowTxHead--;										//Nothing was sent, so take the frame back out of the window
+		transport[espNowTransportId].txStartTime = 0;
+		#if defined(ESP32)
+			portEXIT_CRITICAL(&espNowTxLock);
+		#endif
 		transport[espNowTransportId].txPacketsDropped++;	//Record the drop
 		if(WiFi.channel() != currentEspNowChannel)			//Channel has changed, alter the peer address
 		{
-			currentEspNowChannel = WiFi.channel();			//Update the expected channel
-			currentEspNowChannelChanged = true;				//Set the flag to inform the application
-			if(deleteEspNowPeer(broadcastMacAddress))		//This could perhaps be changed to modify the existing peer but this should be infrequent
-			{
-				addEspNowPeer(broadcastMacAddress);			//Add the peer back for future sends
-			}
+			espNowChannelMoved();
 		}
 	}
-	transport[espNowTransportId].txStartTime = 0;
 	return false;
 }
+void treacleClass::espNowSendComplete(const uint8_t* macAddress, bool success)
+{
+	#if defined(ESP32)
+		portENTER_CRITICAL(&espNowTxLock);
+	#endif
+	bool late = false;
+	while(espNowTxTimedOutTail != espNowTxTail && late == false)	//Callbacks come in the order frames were sent, so any for timed out frames come first
+	{
+		late = memcmp(espNowTxMacAddresses[espNowTxTimedOutTail % espNowTxRecords], macAddress, 6) == 0;	//If not, that frame's callback was missed altogether
+		espNowTxTimedOutTail++;
+	}
+	if(late == false && espNowTxHead != espNowTxTail &&
+		memcmp(espNowTxMacAddresses[espNowTxTail % espNowTxRecords], macAddress, 6) == 0)	//Otherwise it is not for any frame in flight
+	{
+		espNowTxComplete(success);
+		espNowTxTimedOutTail = espNowTxTail;
+	}
+	#if defined(ESP32)
+		portEXIT_CRITICAL(&espNowTxLock);
+	#endif
+}
+void treacleClass::espNowTxComplete(bool success)
+{
+	uint32_t now = micros();
+	uint32_t startTime = espNowTxStartTimes[espNowTxTail % espNowTxRecords];
+	if(espNowLastTxCompletion != 0 && (int32_t)(espNowLastTxCompletion - startTime) > 0)
+	{
+		startTime = espNowLastTxCompletion;					//Queued behind the previous frame, so it only went on air once that finished
+	}
+	recordTxTime(espNowTransportId, now - startTime);		//Add to the total transmit time and duty cycle window, failures use airtime too
+	espNowLastTxCompletion = now;
+	espNowTxTail++;
+	transport[espNowTransportId].txStartTime = 0;			//There is room in the window again
+	if(success)
+	{
+		transport[espNowTransportId].txPackets++;			//Count the packet
+	}
+	else
+	{
+		transport[espNowTransportId].txPacketsDropped++;	//Count the drop
+	}
+}
+bool treacleClass::espNowLargeFramesUsable()
+{
+	if(espNowLargeFrames == false || espNowTxFrame == nullptr)
+	{
+		return false;										//This node can't send them
+	}
+	bool nodesReachable = false;
+	for(uint8_t word = 0; word < nodeBitmaskSize; word++)
+	{
+		if((transport[espNowTransportId].reachableNodes[word] & ~espNowLargeFrameNodes[word]) != 0)
+		{
+			return false;									//A node that could hear the frame can't receive it
+		}
+		if(transport[espNowTransportId].reachableNodes[word] != 0)
+		{
+			nodesReachable = true;
+		}
+	}
+	return nodesReachable;
+}
+bool treacleClass::addToEspNowFrame(uint8_t* buffer, uint8_t packetSize)
+{
+	if(espNowTxFrame == nullptr || buffer[(uint8_t)headerPosition::recipient] != (uint8_t)nodeId::allNodes)
+	{
+		return false;
+	}
+	if(espNowTxFrameLength + 1 + packetSize > transport[espNowTransportId].maximumFrameSize)	//Full, so send it and start another
+	{
+		if(sendEspNowFrame() == false)
+		{
+			return false;
+		}
+	}
+	espNowTxFrame[espNowTxFrameLength++] = packetSize;		//Each packet is preceded by its length, as padding means the packet length field can't be used
+	memcpy(&espNowTxFrame[espNowTxFrameLength], buffer, packetSize);
+	espNowTxFrameLength += packetSize;
+	return true;
+}
+bool treacleClass::sendEspNowFrame()
+{
+	if(espNowTxFrameLength == 0)
+	{
+		return true;
+	}
+	if(espNowTxWindowFull())
+	{
+		return false;										//Keep the packets until there is room
+	}
+	while(espNowTxFrameLength <= maximumBufferSize)			//Receivers recognise large frames by their size, so pad a short one
+	{
+		espNowTxFrame[espNowTxFrameLength++] = 0;
+	}
+	bool result = sendEspNowData(broadcastMacAddress, espNowTxFrame, espNowTxFrameLength);
+	espNowTxFrameLength = 0;								//Whatever happens these packets are done with, as with any other failed send
+	if(result)
+	{
+		espNowLargeFramesSent++;
+	}
+	return result;
+}
+bool treacleClass::receiveEspNow()
+{
+	while(receiveBufferSize == 0 && espNowRxFrameLength > 0)	//Hand on the next packet once the receive buffer is free
+	{
+		uint8_t packetSize = 0;
+		if(espNowRxFramePosition < espNowRxFrameLength)
+		{
+			packetSize = espNowRxFrame[espNowRxFramePosition];
+		}
+		if(packetSize == 0 || espNowRxFramePosition + 1 + packetSize > espNowRxFrameLength)	//Padding, or the end of the frame
+		{
+			espNowRxFrameLength = 0;						//Free the frame
+			return false;
+		}
+		uint8_t* packet = &espNowRxFrame[espNowRxFramePosition + 1];
+		espNowRxFramePosition += 1 + packetSize;
+		transport[espNowTransportId].rxPackets++;			//Count the packet as received
+		if(packet[(uint8_t)headerPosition::recipient] == (uint8_t)nodeId::allNodes ||
+			packet[(uint8_t)headerPosition::recipient] == currentNodeId)	//Packet is meaningful to this node
+		{
+			memcpy(receiveBuffer, packet, packetSize);		//Copy the packet
+			memcpy(lastEspNowMacAddress, espNowRxFrameMacAddress, 6);	//Record where it came from
+			receiveBufferSize = packetSize;					//Record the amount of payload
+			receiveBufferCrcChecked = false;				//Mark the payload as unchecked
+			receiveTransport = espNowTransportId;			//Record that it was received by ESP-Now
+			transport[espNowTransportId].rxPacketsProcessed++;	//Count the packet as processed
+			return true;
+		}
+		transport[espNowTransportId].rxPacketsIgnored++;	//Count the ignore
+	}
+	return false;
+}
+void treacleClass::unpackEspNowFlags(uint8_t nodeIndex)
+{
+	if((receiveBuffer[(uint8_t)headerPosition::payloadType] & 0x0f) != (uint8_t)payloadType::keepalive)
+	{
+		return;												//Only keepalives carry the flag
+	}
+	if(receiveBuffer[(uint8_t)headerPosition::payloadType] & (uint8_t)payloadType::espNowLargeFrames)
+	{
+		espNowLargeFrameNodes[nodeIndex/32] |= (0x00000001 << (nodeIndex%32));
+		receiveBuffer[(uint8_t)headerPosition::payloadType] &= (0xff ^ (uint8_t)payloadType::espNowLargeFrames);	//Remove the flag, so it isn't taken for LoRa slots
+	}
+	else
+	{
+		espNowLargeFrameNodes[nodeIndex/32] &= ~(0x00000001 << (nodeIndex%32));
+	}
+}
+bool treacleClass::espNowChannelLocked()
+{
+	if((WiFi.getMode() == WIFI_STA || WiFi.getMode() == WIFI_AP_STA) && WiFi.status() == WL_CONNECTED)
+	{
+		return true;										//The access point decides the channel
+	}
+	if((WiFi.getMode() == WIFI_AP || WiFi.getMode() == WIFI_AP_STA) && WiFi.softAPgetStationNum() > 0)
+	{
+		return true;										//Moving would disconnect this node's own WiFi clients
+	}
+	return false;
+}
+void treacleClass::checkEspNowChannel()
+{
+	if(millis() - espNowLastChannelCheck < espNowChannelCheckInterval)
+	{
+		return;
+	}
+	espNowLastChannelCheck = millis();
+	if(WiFi.channel() != currentEspNowChannel)				//Moved by the access point, so follow it before any sends fail
+	{
+		#if defined(TREACLE_DEBUG)
+			debugPrint(treacleDebugString_treacleSpace);
+			debugPrint(treacleDebugString_WiFi);
+			debugPrint(' ');
+			debugPrint(treacleDebugString_channel);
+			debugPrint(' ');
+			debugPrint(treacleDebugString_changedSpaceTo);
+			debugPrint(':');
+			debugPrintln(WiFi.channel());
+		#endif
+		espNowChannelMoved();
+		if(espNowRejoinStart == 0)
+		{
+			espNowRejoinStart = millis();
+		}
+		bringForwardEspNowTick();							//Let any other nodes here know straight away
+		return;
+	}
+	if(espNowChannelDiscovery == false || espNowChannelLocked())
+	{
+		espNowScanning = false;
+		return;
+	}
+	if(espNowScanning == false)
+	{
+		if(millis() - espNowLastRx < 2 * (uint32_t)transport[espNowTransportId].defaultTick ||	//Still in contact
+			millis() - espNowScanStepTime < 4 * (uint32_t)transport[espNowTransportId].defaultTick)	//Wait between searches, so lone nodes meet on the preferred channel
+		{
+			return;
+		}
+		espNowScanning = true;
+		espNowScanChannelsTried = 0;
+		espNowScanStepTime = millis() - espNowScanDwellTime;
+		if(espNowRejoinStart == 0)
+		{
+			espNowRejoinStart = millis();
+		}
+	}
+	if(millis() - espNowScanStepTime < espNowScanDwellTime)
+	{
+		return;
+	}
+	espNowScanStepTime = millis();
+	uint8_t channel = currentEspNowChannel % espNowMaximumChannel + 1;	//Try the next channel
+	if(espNowScanChannelsTried++ == espNowMaximumChannel)	//Nobody found anywhere, go back to the preferred channel to wait
+	{
+		espNowScanning = false;
+		channel = preferredespNowChannel;
+	}
+	if(channel != currentEspNowChannel && changeWiFiChannel(channel))
+	{
+		espNowChannelMoved();
+		bringForwardEspNowTick();							//Announce this node on the new channel, nodes here reply straight away
+	}
+	else if(espNowScanning == true)
+	{
+		espNowScanning = false;								//The channel can't be changed
+	}
+}
+void treacleClass::espNowChannelMoved()
+{
+	currentEspNowChannel = WiFi.channel();					//Update the expected channel
+	currentEspNowChannelChanged = true;						//Set the flag to inform the application
+	if(deleteEspNowPeer(broadcastMacAddress))				//This could perhaps be changed to modify the existing peer but this should be infrequent
+	{
+		addEspNowPeer(broadcastMacAddress);					//Add the peer back for future sends
+	}
+	removeAllEspNowPeers();									//Unicast peers are added back on the next send to them, on the new channel
+}
+void treacleClass::espNowPacketReceived(uint8_t nodeIndex)
+{
+	bool arrived = millis() - node[nodeIndex].lastTick[espNowTransportId] > 2 * (uint32_t)transport[espNowTransportId].defaultTick;	//Not heard for a while, it may be searching for the network
+	espNowLastRx = millis();
+	espNowScanning = false;									//Found the other nodes, so stay on this channel
+	if(espNowRejoinStart != 0)
+	{
+		espNowRejoinTime = millis() - espNowRejoinStart;
+		espNowRejoinStart = 0;
+		espNowRejoins++;
+	}
+	else if(arrived == true && millis() - transport[espNowTransportId].lastTick > transport[espNowTransportId].minimumTick)
+	{
+		bringForwardEspNowTick();							//Reply before it moves on to another channel
+	}
+}
+void treacleClass::bringForwardEspNowTick()
+{
+	if(transport[espNowTransportId].nextTick != 0)
+	{
+		transport[espNowTransportId].lastTick = millis() - (transport[espNowTransportId].nextTick + 1);
+	}
+}
 uint16_t treacleClass::espNowRxReliability(uint8_t id)
 {
 	if(espNowInitialised())
@@ -59,6 +59,8 @@ bool treacleClass::initialiseLoRa()
 		LoRa.setTxPower(loRaTxPower);							//Set TX power
 		LoRa.setSpreadingFactor(loRaSpreadingFactor);			//Set spreading factor
 		LoRa.setSignalBandwidth(loRaSignalBandwidth);			//Set badwidth
+		LoRa.setCodingRate4(loRaCodingRate);					//Set coding rate
+		LoRa.setPreambleLength(loRaPreambleLength);				//Set preamble length
 		LoRa.setGain(loRaRxGain);
 		LoRa.setSyncWord(loRaSyncWord);							//Set sync word
 		LoRa.enableCrc();										//Enable CRC check
@@ -73,50 +75,25 @@ bool treacleClass::initialiseLoRa()
 			LoRa.onTxDone(										//Send callback function
 				[]() {
 					//Serial.println("LORA SENT");
-					if(treacle.transport[treacle.loRaTransportId].txStartTime != 0)			//Check the initial send time was recorded
-					{
-						treacle.transport[treacle.loRaTransportId].txTime += micros()			//Add to the total transmit time
-							- treacle.transport[treacle.loRaTransportId].txStartTime;
-						treacle.transport[treacle.loRaTransportId].txStartTime = 0;			//Clear the initial send time
-					}
-					treacle.transport[treacle.loRaTransportId].txPackets++;					//Count the packet
+					treacle.loRaTransmitComplete();											//Count the packet and free the radio for the next one
+					LoRa.receive();															//The radio goes to standby after sending, so start receiving again
+				}
+			);
+			LoRa.onCadDone(										//Channel activity detection callback function
+				[](bool signalDetected) {
+					treacle.loRaCadResult = signalDetected ? 2 : 1;
 				}
 			);
 			LoRa.onReceive(
 				[](int receivedMessageLength) {
 					//Serial.println("LORA RECEIVED");
-					if(receivedMessageLength > 0)
-					{
-						if(treacle.receiveBufferSize == 0 && receivedMessageLength < treacle.maximumBufferSize)
-						{
-							treacle.transport[treacle.loRaTransportId].rxPackets++;				//Count the packet as received
-							if(LoRa.peek() == (uint8_t)treacle.nodeId::allNodes ||
-								LoRa.peek() == treacle.currentNodeId)							//Packet is meaningful to this node
-							{
-								LoRa.readBytes(treacle.receiveBuffer, receivedMessageLength);	//Copy the LoRa payload
-								treacle.receiveBufferSize = receivedMessageLength;				//Record the amount of payload
-								treacle.receiveBufferCrcChecked = false;						//Mark the payload as unchecked
-								treacle.receiveTransport = treacle.loRaTransportId;				//Record that it was received by ESP-Now
-								treacle.transport[treacle.loRaTransportId].rxPacketsProcessed++;//Count the packet as processed
-							}
-							else
-							{
-								treacle.transport[treacle.loRaTransportId].rxPacketsIgnored++;	//Count the ignore
-							}
-							return;
-						}
-						else
-						{
-							treacle.transport[treacle.loRaTransportId].rxPacketsDropped++;		//Count the drop
-						}
-						while(LoRa.available())													//Drop the packet
-						{
-							LoRa.read();
-						}
-					}
+					treacle.queueLoRaPacket(receivedMessageLength);							//Empty the FIFO straight away, the radio stays in continuous receive
 				}
 			);
 		}
+		#if !defined(AVR)
+			loRaRxQueue = new loRaRxSlot[loRaRxQueueLength];	//Received packets wait here until unpacked
+		#endif
 		LoRa.receive();											//Start LoRa reception
 	}
 	else
@@ -208,10 +185,12 @@ uint8_t treacleClass::getLoRaTxPower()
 void treacleClass::setLoRaTxPower(uint8_t value)
 {
 	loRaTxPower = value;
+	loRaBaseTxPower = value;			//Adaptive data rate never goes above this
 }
 void treacleClass::setLoRaSpreadingFactor(uint8_t value)
 {
 	loRaSpreadingFactor = value;
+	loRaBaseSpreadingFactor = value;	//Adaptive data rate falls back to this
 }
 void treacleClass::setLoRaSignalBandwidth(uint32_t value)
 {
@@ -221,6 +200,44 @@ void treacleClass::setLoRaRxGain(uint8_t value)
 {
 	loRaRxGain = value;
 }
+void treacleClass::setLoRaCodingRate(uint8_t value)
+{
+	if(value >= 5 && value <= 8)
+	{
+		loRaCodingRate = value;
+	}
+}
+uint8_t treacleClass::getLoRaCodingRate()
+{
+	return loRaCodingRate;
+}
+void treacleClass::setLoRaPreambleLength(uint16_t value)
+{
+	loRaPreambleLength = value;
+}
+uint16_t treacleClass::getLoRaPreambleLength()
+{
+	return loRaPreambleLength;
+}
+/*
+ *
+ *	Time on air, from the Semtech SX1276 datasheet/AN1200.13 with explicit header and CRC, which treacle always uses
+ *
+ */
+uint32_t treacleClass::loRaTimeOnAir(uint8_t packetSize)
+{
+	uint32_t symbolTime = ((uint32_t)1 << loRaSpreadingFactor) * 1000000UL / loRaSignalBandwidth;		//Symbol time in micros, 2^SF/BW
+	uint8_t lowDataRateOptimise = symbolTime > 16000 ? 1 : 0;										//The LoRa library sets this for symbols over 16ms
+	int32_t payloadBits = 8 * (int32_t)packetSize - 4 * loRaSpreadingFactor + 28 + 16;				//8PL - 4SF + 28 + 16CRC - 20IH, with IH = 0
+	int32_t bitsPerSymbolBlock = 4 * (loRaSpreadingFactor - 2 * lowDataRateOptimise);
+	uint32_t payloadSymbols = 8;
+	if(payloadBits > 0)
+	{
+		payloadSymbols += ((payloadBits + bitsPerSymbolBlock - 1) / bitsPerSymbolBlock) * loRaCodingRate;	//Rounded up, then multiplied by CR + 4
+	}
+	return ((4 * (uint32_t)loRaPreambleLength + 17) * symbolTime) / 4								//Preamble is (Npreamble + 4.25) symbols
+		+ payloadSymbols * symbolTime;
+}
 uint8_t treacleClass::getLoRaSpreadingFactor()
 {
 	if(loRaInitialised())
@@ -239,64 +256,794 @@ uint32_t treacleClass::getLoRaSignalBandwidth()
 }
 bool treacleClass::sendBufferByLoRa(uint8_t* buffer, uint8_t packetSize)
 {
+	loRaChannelWasBusy = false;
+	if(loRaTransmitting())															//Only one packet can be sent at a time
+	{
+		return false;
+	}
+	if(loRaListenBeforeTalk == true && loRaConsecutiveDeferrals < loRaMaximumDeferrals && loRaChannelClear() == false)
+	{
+		loRaChannelBusyEvents++;
+		loRaChannelWasBusy = true;													//The caller puts the tick or packet back, see deferLoRaSend()
+		return false;
+	}
+	loRaConsecutiveDeferrals = 0;
 	if(LoRa.beginPacket())
 	{
 		LoRa.write(buffer, packetSize);
-		if(loRaIrqPin == -1)															//No LoRa IRQ, do this synchronously
+		loRaTxDuration = loRaTimeOnAir(packetSize);									//Use the calculated time on air, which does not include SPI overhead
+		transport[loRaTransportId].txStartTime = micros();							//Marks the radio as busy until the send completes
+		if(transport[loRaTransportId].txStartTime == 0)
+		{
+			transport[loRaTransportId].txStartTime = 1;								//Zero means idle
+		}
+		if(LoRa.endPacket(true))													//Don't block for the time on air, completion is picked up from the IRQ or by polling
+		{
+			return true;
+		}
+		transport[loRaTransportId].txStartTime = 0;
+	}
+	return false;
+}
+bool treacleClass::loRaTransmitting()
+{
+	if(transport[loRaTransportId].txStartTime == 0)
+	{
+		return false;
+	}
+	uint32_t elapsed = micros() - transport[loRaTransportId].txStartTime;
+	if(elapsed < loRaTxDuration)													//It can't have finished yet, so don't touch the radio
+	{
+		return true;
+	}
+	if(elapsed < 2 * loRaTxDuration + loRaTxTimeout)
+	{
+		if(loRaIrqPin != -1)														//The TX done IRQ will complete it
+		{
+			return true;
+		}
+		if(LoRa.beginPacket() == 0)													//Without an IRQ pin, this fails while the radio is still sending
+		{
+			return true;
+		}
+	}
+	#if defined(TREACLE_DEBUG)
+		if(elapsed >= 2 * loRaTxDuration + loRaTxTimeout)
+		{
+			debugPrint(treacleDebugString_treacleSpace);
+			debugPrint(treacleDebugString_LoRa);
+			debugPrint(' ');
+			debugPrint(treacleDebugString_TX);
+			debugPrint(':');
+			debugPrintln(treacleDebugString_failed);
+		}
+	#endif
+	loRaTransmitComplete();															//Finished, or the TX done IRQ was missed
+	LoRa.receive();																	//The radio is in standby, so start receiving again
+	return false;
+}
+void treacleClass::loRaTransmitComplete()
+{
+	if(transport[loRaTransportId].txStartTime != 0)									//Only count each packet once
+	{
+		recordTxTime(loRaTransportId, loRaTxDuration);								//Add to the total transmit time and duty cycle window
+		transport[loRaTransportId].txStartTime = 0;									//Clear the initial send time, so the next packet can go
+		transport[loRaTransportId].txPackets++;										//Count the packet
+	}
+}
+bool treacleClass::receiveLoRa()
+{
+	if(loRaTransmitting() == false && loRaIrqPin == -1)				//Without an IRQ pin the radio must be polled, but not while sending as that would cut the packet short
+	{
+		int receivedMessageLength = LoRa.parsePacket();					//This also re-arms single receive if nothing has arrived
+		if(receivedMessageLength > 0)
+		{
+			queueLoRaPacket(receivedMessageLength);
+		}
+	}
+	#if defined(AVR)
+		return receiveBufferSize > 0 && receiveTransport == loRaTransportId;	//Packets go straight into receiveBuffer
+	#else
+		if(receiveBufferSize == 0 && loRaRxQueueTail != loRaRxQueueHead)	//Hand the oldest queued packet on once the receive buffer is free
+		{
+			loRaRxSlot* slot = &loRaRxQueue[loRaRxQueueTail % loRaRxQueueLength];
+			memcpy(receiveBuffer, slot->data, slot->length);				//Copy the LoRa payload
+			lastLoRaRssi = slot->rssi;										//RSSI and SNR of this packet, for unpacking
+			lastLoRaSNR = slot->snr;
+			receiveBufferSize = slot->length;								//Record the amount of payload
+			receiveBufferCrcChecked = false;								//Mark the payload as unchecked
+			receiveTransport = loRaTransportId;								//Record that it was received by LoRa
+			loRaRxQueueTail++;												//Free the slot
+			return true;
+		}
+		return false;
+	#endif
+}
+void treacleClass::receiveMissedLoRaPacket()
+{
+	#if defined(AVR)
+		if(loRaIrqPin != -1 && loRaTransmitting() == false && digitalRead(loRaIrqPin) == HIGH)	//Edge interrupts can't wake AVR from power down and the edge is lost, so the IRQ pin stays high
+		{
+			queueLoRaPacket(LoRa.parsePacket());						//Read the packet as if polling, which also clears the IRQ
+			LoRa.receive();												//Reading a packet leaves the radio in standby
+		}
+	#endif
+}
+void treacleClass::queueLoRaPacket(int receivedMessageLength)
+{
+	if(receivedMessageLength <= 0)
+	{
+		return;
+	}
+	transport[loRaTransportId].rxPackets++;								//Count the packet as received
+	#if defined(AVR)
+	if(receivedMessageLength < maximumBufferSize && receiveBufferSize == 0)	//The receive buffer is free
+	{
+		if(LoRa.peek() == (uint8_t)nodeId::allNodes ||
+			LoRa.peek() == currentNodeId)								//Packet is meaningful to this node
+		{
+			lastLoRaRssi = LoRa.packetRssi();							//Record RSSI and SNR for unpacking
+			lastLoRaSNR = LoRa.packetSnr();
+			LoRa.readBytes(receiveBuffer, receivedMessageLength);		//Copy the LoRa payload
+			receiveBufferCrcChecked = false;							//Mark the payload as unchecked
+			receiveTransport = loRaTransportId;							//Record that it was received by LoRa
+			receiveBufferSize = receivedMessageLength;					//Only now is the packet visible to the main loop
+			transport[loRaTransportId].rxPacketsProcessed++;			//Count the packet as processed
+			return;
+		}
+	#else
+	if(receivedMessageLength < maximumBufferSize && loRaRxQueue != nullptr &&
+		(uint8_t)(loRaRxQueueHead - loRaRxQueueTail) < loRaRxQueueLength)	//There is a free slot
+	{
+		if(LoRa.peek() == (uint8_t)nodeId::allNodes ||
+			LoRa.peek() == currentNodeId)								//Packet is meaningful to this node
+		{
+			loRaRxSlot* slot = &loRaRxQueue[loRaRxQueueHead % loRaRxQueueLength];
+			slot->rssi = LoRa.packetRssi();								//Record RSSI and SNR with the packet
+			slot->snr = LoRa.packetSnr();
+			LoRa.readBytes(slot->data, receivedMessageLength);			//Copy the LoRa payload
+			slot->length = receivedMessageLength;
+			loRaRxQueueHead++;											//Only now is the slot visible to receiveLoRa()
+			transport[loRaTransportId].rxPacketsProcessed++;			//Count the packet as processed
+			return;
+		}
+	#endif
+		transport[loRaTransportId].rxPacketsIgnored++;					//Count the ignore
+	}
+	else
+	{
+		transport[loRaTransportId].rxPacketsDropped++;					//Count the drop
+	}
+	while(LoRa.available())												//Drop the packet
+	{
+		LoRa.read();
+	}
+}
+void treacleClass::enableLoRaListenBeforeTalk()
+{
+	loRaListenBeforeTalk = true;
+}
+void treacleClass::disableLoRaListenBeforeTalk()
+{
+	loRaListenBeforeTalk = false;
+}
+uint32_t treacleClass::getLoRaDeferrals()
+{
+	return loRaDeferrals;
+}
+uint32_t treacleClass::getLoRaChannelBusy()
+{
+	return loRaChannelBusyEvents;
+}
+bool treacleClass::loRaChannelClear()
+{
+	uint32_t symbolTime = ((uint32_t)1 << loRaSpreadingFactor) * 1000000UL / loRaSignalBandwidth;	//Symbol time in micros, 2^SF/BW
+	uint32_t checkStart = micros();
+	if(loRaIrqPin != -1)															//Channel activity detection needs the IRQ pin
+	{
+		loRaCadResult = 0;
+		LoRa.channelActivityDetection();
+		while(loRaCadResult == 0 && micros() - checkStart < 4 * symbolTime)		//Detection takes about two symbols
+		{
+			yield();
+		}
+		LoRa.receive();																//Go back to receiving, so any packet detected isn't missed
+		return loRaCadResult != 2;													//If detection didn't finish, transmit anyway
+	}
+	do
+	{
+		if(LoRa.rssi() > loRaBusyRssi)												//Otherwise fall back to signal strength, which can't see packets below the noise floor
+		{
+			return false;
+		}
+	}
+	while(micros() - checkStart < symbolTime);
+	return true;
+}
+uint32_t treacleClass::loRaBackoff()
+{
+	if(loRaNumberOfSlots > 0 && loRaSlot < loRaNumberOfSlots)
+	{
+		return timeToLoRaSlot(1);													//A random backoff would land in another node's slot, so wait for this one to come round
+	}
+	uint8_t exponent = loRaConsecutiveDeferrals < 5 ? loRaConsecutiveDeferrals : 5;
+	uint32_t backoff = random(1, (2 << exponent) + 1) * (loRaTimeOnAir(64)/1000 + 1);	//Units of a typical packet's time on air, which is seconds at high spreading factors
+	return backoff < maximumTickTime ? backoff : maximumTickTime;
+}
+uint32_t treacleClass::deferLoRaSend()
+{
+	loRaConsecutiveDeferrals++;
+	loRaDeferrals++;
+	loRaBackoffTime = loRaBackoff();
+	loRaBackoffStart = millis();
+	return loRaBackoffTime;
+}
+uint32_t treacleClass::timeToLoRaBackoffEnd()
+{
+	if(loRaBackoffTime == 0)
+	{
+		return 0;
+	}
+	if(millis() - loRaBackoffStart >= loRaBackoffTime)
+	{
+		loRaBackoffTime = 0;														//Finished, which also saves checking again
+		return 0;
+	}
+	return loRaBackoffTime - (millis() - loRaBackoffStart);
+}
+void treacleClass::enableLoRaAdaptiveDataRate(uint8_t margin)
+{
+	if(loRaAdaptiveDataRate == false)
+	{
+		loRaAdaptiveDataRate = true;
+		loRaDataRateMargin = margin;
+		loRaBaseSpreadingFactor = loRaSpreadingFactor;
+		loRaBaseTxPower = loRaTxPower;
+		loRaRequiredSpreadingFactor = 0;
+		loRaPendingSpreadingFactor = 0;
+		enableTimeSync();													//Changes are timed from network time
+		if(transport != nullptr && loRaInitialised() && loRaNodeReportedSnr == nullptr)	//Otherwise this happens in begin()
+		{
+			allocateLoRaDataRate();
+		}
+	}
+}
+void treacleClass::disableLoRaAdaptiveDataRate()
+{
+	if(loRaAdaptiveDataRate == true)
+	{
+		loRaAdaptiveDataRate = false;
+		loRaBeaconSpreadingFactor = 0;
+		setLoRaDataRate(loRaBaseSpreadingFactor, loRaBaseTxPower);
+	}
+}
+uint32_t treacleClass::getLoRaDataRateFallbacks()
+{
+	return loRaDataRateFallbacks;
+}
+void treacleClass::allocateLoRaDataRate()
+{
+	loRaNodeReportedSnr = new int8_t[maximumNumberOfNodes];
+	loRaNodeNeededAtSwitch = new bool[maximumNumberOfNodes];
+	for(uint8_t index = 0; index < maximumNumberOfNodes; index++)
+	{
+		loRaNodeReportedSnr[index] = loRaUnknownSnr;
+		loRaNodeNeededAtSwitch[index] = false;
+	}
+}
+bool treacleClass::loRaNodeNeedsLoRa(uint8_t nodeIndex)
+{
+	if((node[nodeIndex].rxReliability[loRaTransportId] & 0xf000) == 0)			//Not heard in the last few ticks
+	{
+		return false;
+	}
+	for(uint8_t transportId = 0; transportId < numberOfActiveTransports; transportId++)
+	{
+		if(transportId != loRaTransportId && transport[transportId].initialised == true && online(nodeIndex, transportId))
+		{
+			return false;															//It can be reached another way
+		}
+	}
+	return true;
+}
+int8_t treacleClass::loRaLinkSnr(uint8_t nodeIndex)
+{
+	int16_t linkSnr = snr[nodeIndex];												//Until the node reports, assume the link is symmetric
+	if(loRaNodeReportedSnr[nodeIndex] != loRaUnknownSnr)
+	{
+		linkSnr = loRaNodeReportedSnr[nodeIndex] + (loRaBaseTxPower - loRaTxPower);	//As it would be at full power, the other direction is covered by the other node
+	}
+	return linkSnr < -128 ? -128 : (linkSnr > 126 ? 126 : linkSnr);
+}
+uint8_t treacleClass::loRaSpreadingFactorForSnr(int8_t linkSnr)
+{
+	for(uint8_t spreadingFactor = loRaMinimumSpreadingFactor; spreadingFactor < loRaBaseSpreadingFactor; spreadingFactor++)
+	{
+		if(linkSnr - loRaDataRateMargin >= -5 - 2.5 * (spreadingFactor - 6))		//Demodulation floor is -7.5dB at SF7, 2.5dB lower for each step
+		{
+			return spreadingFactor;
+		}
+	}
+	return loRaBaseSpreadingFactor;
+}
+void treacleClass::considerLoRaSpreadingFactor(uint8_t spreadingFactor, uint8_t origin, uint32_t originTime)
+{
+	if(origin == loRaRequiredSpreadingFactorOrigin)
+	{
+		if((int32_t)(originTime - loRaRequiredSpreadingFactorTime) < 0)
+		{
+			return;																	//Older news from the same node
+		}
+	}
+	else if(spreadingFactor <= loRaRequiredSpreadingFactor && networkMillis() - loRaRequiredSpreadingFactorTime < loRaDataRateExpiry)
+	{
+		return;																		//A higher need is still current
+	}
+	loRaRequiredSpreadingFactor = spreadingFactor;
+	loRaRequiredSpreadingFactorOrigin = origin;
+	loRaRequiredSpreadingFactorTime = originTime;
+}
+void treacleClass::updateLoRaDataRate()
+{
+	if(loRaNodeReportedSnr == nullptr || currentNodeId == (uint8_t)nodeId::unknownNode)
+	{
+		return;
+	}
+	if(loRaDataRateHoldStart != 0 && millis() - loRaDataRateHoldStart > loRaDataRateHoldTime)
+	{
+		loRaDataRateHoldStart = 0;
+	}
+	if(loRaSpreadingFactor < loRaBaseSpreadingFactor || loRaBeaconSpreadingFactor != 0)
+	{
+		updateLoRaBeacon();
+		if(loRaBeaconSpreadingFactor != 0)
+		{
+			return;																	//Switches wait until the listen after a beacon is over
+		}
+	}
+	if(loRaDataRateSwitchTime != 0 &&
+		millis() - loRaDataRateSwitchTime > 2 * (uint32_t)transport[loRaTransportId].defaultTick + transport[loRaTransportId].minimumTick)	//Time to check contact after a switch
+	{
+		loRaDataRateSwitchTime = 0;
+		for(uint8_t nodeIndex = 0; nodeIndex < numberOfNodes; nodeIndex++)
 		{
-			transport[loRaTransportId].txStartTime = micros();
-			if(LoRa.endPacket())
+			if(loRaNodeNeededAtSwitch[nodeIndex] == true && (node[nodeIndex].rxReliability[loRaTransportId] & 0xc000) == 0)	//Not heard in the last two ticks
 			{
-				transport[loRaTransportId].txTime += micros()			//Add to the total transmit time
-					- transport[loRaTransportId].txStartTime;
-				transport[loRaTransportId].txStartTime = 0;			//Clear the initial send time
-				transport[loRaTransportId].txPackets++;				//Count the packet
-				return true;
+				loRaDataRateFallback();												//Go back to what is known to work, other nodes that lost contact do the same
+				break;
 			}
 		}
-		else
+	}
+	uint32_t period = networkMillis() / loRaDataRateSwitchInterval;
+	if(period != loRaDataRatePeriod)												//A boundary has passed
+	{
+		loRaDataRatePeriod = period;
+		uint8_t target = loRaRequiredSpreadingFactor;
+		if(networkMillis() - loRaRequiredSpreadingFactorTime > loRaDataRateExpiry || target == 0 || networkTimeSynchronised() == false)
+		{
+			target = loRaBaseSpreadingFactor;										//Not enough information, so use the configured setting
+		}
+		if(target == loRaPendingSpreadingFactor && target != loRaSpreadingFactor)	//Agreed for a whole interval, so all nodes should change together
 		{
-			transport[loRaTransportId].txStartTime = micros();
-			if(LoRa.endPacket(true))
+			for(uint8_t nodeIndex = 0; nodeIndex < numberOfNodes; nodeIndex++)
 			{
-				return true;
+				loRaNodeNeededAtSwitch[nodeIndex] = loRaNodeNeedsLoRa(nodeIndex);
 			}
+			loRaDataRateSwitchTime = millis();
+			loRaLastBeacon = millis() - random(loRaDataRateSwitchInterval/2);		//Spread out the beacons of different nodes
+			setLoRaDataRate(target, loRaBaseTxPower);								//Start at full power, then reduce it again
 		}
+		loRaPendingSpreadingFactor = target;
 	}
-	transport[loRaTransportId].txStartTime = 0;
-	return false;
 }
-bool treacleClass::receiveLoRa()
+void treacleClass::loRaDataRateFallback()
+{
+	loRaDataRateFallbacks++;
+	loRaDataRateHoldStart = millis();
+	loRaPendingSpreadingFactor = loRaBaseSpreadingFactor;
+	loRaBeaconSpreadingFactor = 0;
+	setLoRaDataRate(loRaBaseSpreadingFactor, loRaBaseTxPower);
+	#if defined(TREACLE_DEBUG)
+		debugPrint(treacleDebugString_treacleSpace);
+		debugPrint(treacleDebugString_LoRa);
+		debugPrint(' ');
+		debugPrint(treacleDebugString_spreading_factor);
+		debugPrint(' ');
+		debugPrintln(treacleDebugString_fallback);
+	#endif
+}
+void treacleClass::updateLoRaBeacon()
+{
+	if(loRaBeaconSpreadingFactor == 0)
+	{
+		if(loRaDataRateSwitchTime == 0 && millis() - loRaLastBeacon > loRaDataRateSwitchInterval &&	//Not while checking contact after a switch
+			timeToNextTick(loRaTransportId) < loRaBeaconGuardTime)					//The next tick is the beacon, so nothing is missed waiting for it
+		{
+			loRaLastBeacon = millis();
+			loRaBeaconSpreadingFactor = loRaSpreadingFactor;
+			loRaBeaconTxPower = loRaTxPower;
+			loRaBeaconTxPackets = transport[loRaTransportId].txPackets;
+			loRaBeaconListenStart = 0;
+			setLoRaDataRate(loRaBaseSpreadingFactor, loRaBaseTxPower);				//A new or restarted node starts at the configured settings
+		}
+		return;
+	}
+	if(loRaBeaconListenStart == 0)
+	{
+		if(transport[loRaTransportId].txPackets != loRaBeaconTxPackets)
+		{
+			loRaBeaconListenStart = millis();										//Sent, so listen for replies
+		}
+		else if(millis() - loRaLastBeacon < maximumTickTime)
+		{
+			return;																	//Still waiting to send it
+		}
+	}
+	if(loRaBeaconListenStart == 0 || millis() - loRaBeaconListenStart > 2 * loRaTimeOnAir(maximumBufferSize)/1000 + loRaBeaconGuardTime)	//Long enough for a reply, which doesn't wait for a slot
+	{
+		uint8_t spreadingFactor = loRaBeaconSpreadingFactor;
+		loRaBeaconSpreadingFactor = 0;
+		setLoRaDataRate(spreadingFactor, loRaBeaconTxPower);						//Nobody new, so carry on as before
+		bringForwardLoRaTick();														//Neighbours didn't hear the beacon, so send a keepalive before they count a missed tick
+	}
+}
+void treacleClass::checkLoRaBeaconReply(uint8_t nodeIndex)
+{
+	if(loRaBeaconSpreadingFactor != 0 && (node[nodeIndex].rxReliability[loRaTransportId] & 0xf000) == 0)	//Not heard in the last few ticks, so it can't be using the current spreading factor
+	{
+		loRaDataRateFallback();														//Other nodes follow when they beacon and hear this node
+	}
+}
+void treacleClass::recordLoRaBeacon(uint8_t spreadingFactor)
+{
+	if(spreadingFactor < loRaMinimumSpreadingFactor || spreadingFactor >= loRaSpreadingFactor || loRaBeaconSpreadingFactor != 0)
+	{
+		return;
+	}
+	if(loRaDataRateHoldStart == 0 && loRaDataRateSwitchTime == 0)
+	{
+		for(uint8_t nodeIndex = 0; nodeIndex < numberOfNodes; nodeIndex++)
+		{
+			loRaNodeNeededAtSwitch[nodeIndex] = loRaNodeNeedsLoRa(nodeIndex);
+		}
+		loRaDataRateSwitchTime = millis();
+		loRaPendingSpreadingFactor = spreadingFactor;
+		loRaLastBeacon = millis() - random(loRaDataRateSwitchInterval/2);
+		setLoRaDataRate(spreadingFactor, loRaBaseTxPower);							//Join the network, which falls back as usual if it can't hear the beaconing node
+	}
+	else if(transport[loRaTransportId].nextTick != 0)
+	{
+		transport[loRaTransportId].lastTick = millis() - (transport[loRaTransportId].nextTick + 1);	//Joining failed, so reply straight away while the beaconing node is listening
+	}
+}
+void treacleClass::setLoRaDataRate(uint8_t spreadingFactor, uint8_t txPower)
+{
+	if(spreadingFactor != loRaSpreadingFactor)
+	{
+		loRaSpreadingFactor = spreadingFactor;
+		LoRa.setSpreadingFactor(loRaSpreadingFactor);
+		#if defined(TREACLE_DEBUG)
+			debugPrint(treacleDebugString_treacleSpace);
+			debugPrint(treacleDebugString_LoRa);
+			debugPrint(' ');
+			debugPrint(treacleDebugString_spreading_factor);
+			debugPrint(':');
+			debugPrintln(loRaSpreadingFactor);
+		#endif
+	}
+	if(txPower != loRaTxPower)
+	{
+		loRaTxPower = txPower;
+		LoRa.setTxPower(loRaTxPower);
+	}
+	if(loRaIrqPin != -1)
+	{
+		LoRa.receive();																//Changing settings leaves receive mode
+	}
+}
+void treacleClass::adjustLoRaTxPower()
 {
-	uint8_t receivedMessageLength = LoRa.parsePacket();
-	if(receivedMessageLength > 0)
+	int16_t worstMargin = 127;
+	for(uint8_t nodeIndex = 0; nodeIndex < numberOfNodes; nodeIndex++)
 	{
-		if(receiveBufferSize == 0 && receivedMessageLength < maximumBufferSize)
+		if(loRaNodeNeedsLoRa(nodeIndex))
 		{
-			transport[loRaTransportId].rxPackets++;						//Count the packet as received
-			if(LoRa.peek() == (uint8_t)nodeId::allNodes ||
-				LoRa.peek() == currentNodeId)							//Packet is meaningful to this node
+			if(loRaNodeReportedSnr[nodeIndex] == loRaUnknownSnr)
 			{
-				lastLoRaRssi = LoRa.packetRssi();						//Record RSSI and SNR
-				lastLoRaSNR = LoRa.packetSnr();
-				LoRa.readBytes(receiveBuffer, receivedMessageLength);	//Copy the LoRa payload
-				receiveBufferSize = receivedMessageLength;				//Record the amount of payload
-				receiveBufferCrcChecked = false;						//Mark the payload as unchecked
-				receiveTransport = loRaTransportId;						//Record that it was received by ESP-Now
-				transport[loRaTransportId].rxPacketsProcessed++;		//Count the packet as processed
-				return true;
+				return;																//Can't tell how well it hears this node
+			}
+			int16_t margin = loRaNodeReportedSnr[nodeIndex] - (-5 - 2.5 * (loRaSpreadingFactor - 6)) - loRaDataRateMargin;
+			if(margin < worstMargin)
+			{
+				worstMargin = margin;
 			}
 		}
-		else
+	}
+	if(worstMargin == 127)
+	{
+		return;
+	}
+	uint8_t txPower = loRaTxPower;
+	if(worstMargin < 0)
+	{
+		txPower += (-worstMargin < 3 ? -worstMargin : 3);							//Quickly turn up
+	}
+	else if(worstMargin >= 3 && txPower > 2)
+	{
+		txPower--;																	//Slowly turn down, leaving a little spare
+	}
+	setLoRaDataRate(loRaSpreadingFactor, txPower < loRaBaseTxPower ? txPower : loRaBaseTxPower);
+}
+void treacleClass::addLoRaLinkDataToPacket()
+{
+	if(loRaAdaptiveDataRate == false || loRaNodeReportedSnr == nullptr || currentNodeId == (uint8_t)nodeId::unknownNode)
+	{
+		return;
+	}
+	uint8_t ownRequirement = loRaMinimumSpreadingFactor;
+	if(loRaDataRateHoldStart != 0)
+	{
+		ownRequirement = loRaBaseSpreadingFactor;									//Holding after losing contact
+	}
+	uint8_t numberOfNeighbours = 0;
+	for(uint8_t nodeIndex = 0; nodeIndex < numberOfNodes; nodeIndex++)
+	{
+		if(loRaNodeNeedsLoRa(nodeIndex))
 		{
-			transport[loRaTransportId].rxPacketsDropped++;				//Count the drop
+			uint8_t linkRequirement = loRaSpreadingFactorForSnr(loRaLinkSnr(nodeIndex));
+			if(linkRequirement > ownRequirement)
+			{
+				ownRequirement = linkRequirement;
+			}
 		}
-		while(LoRa.available())											//Drop the packet
+		if((node[nodeIndex].rxReliability[loRaTransportId] & 0xf000) != 0 &&
+			transport[loRaTransportId].transmitPacketSize + 2 * (numberOfNeighbours + numberOfNodes) + 11 + timeSyncSize <= maximumPayloadSize)	//Leave room for slots and time
 		{
-			LoRa.read();
+			transport[loRaTransportId].transmitBuffer[transport[loRaTransportId].transmitPacketSize++] = node[nodeIndex].id;
+			transport[loRaTransportId].transmitBuffer[transport[loRaTransportId].transmitPacketSize++] = (int8_t)snr[nodeIndex];	//How well this node hears it
+			numberOfNeighbours++;
 		}
 	}
-	return false;
+	considerLoRaSpreadingFactor(ownRequirement, currentNodeId, networkMillis());
+	if(loRaBeaconSpreadingFactor == 0)
+	{
+		adjustLoRaTxPower();														//Beacons go at the configured TX power
+	}
+	transport[loRaTransportId].transmitBuffer[transport[loRaTransportId].transmitPacketSize++] = numberOfNeighbours;
+	if(loRaBeaconSpreadingFactor != 0)
+	{
+		transport[loRaTransportId].transmitBuffer[transport[loRaTransportId].transmitPacketSize++] = loRaBeaconSpreadingFactor | loRaBeaconFlag;	//Where to find the network, older nodes ignore this as out of range
+	}
+	else
+	{
+		transport[loRaTransportId].transmitBuffer[transport[loRaTransportId].transmitPacketSize++] = loRaRequiredSpreadingFactor;
+	}
+	transport[loRaTransportId].transmitBuffer[transport[loRaTransportId].transmitPacketSize++] = loRaRequiredSpreadingFactorOrigin;
+	transport[loRaTransportId].transmitBuffer[transport[loRaTransportId].transmitPacketSize++] = (loRaRequiredSpreadingFactorTime & 0xff000000) >> 24;
+	transport[loRaTransportId].transmitBuffer[transport[loRaTransportId].transmitPacketSize++] = (loRaRequiredSpreadingFactorTime & 0x00ff0000) >> 16;
+	transport[loRaTransportId].transmitBuffer[transport[loRaTransportId].transmitPacketSize++] = (loRaRequiredSpreadingFactorTime & 0x0000ff00) >> 8;
+	transport[loRaTransportId].transmitBuffer[transport[loRaTransportId].transmitPacketSize++] = (loRaRequiredSpreadingFactorTime & 0x000000ff);
+	transport[loRaTransportId].transmitBuffer[(uint8_t)headerPosition::payloadType] |= (uint8_t)payloadType::loRaLinkData;	//Flag the link data at the end of the payload
+}
+void treacleClass::recordLoRaLinkData(uint8_t nodeIndex, uint8_t start, uint8_t numberOfNeighbours)
+{
+	if(loRaNodeReportedSnr == nullptr)
+	{
+		return;
+	}
+	for(uint8_t neighbour = 0; neighbour < numberOfNeighbours; neighbour++)
+	{
+		if(receiveBuffer[start + 2 * neighbour] == currentNodeId)
+		{
+			loRaNodeReportedSnr[nodeIndex] = (int8_t)receiveBuffer[start + 2 * neighbour + 1];	//How well it hears this node
+		}
+	}
+	uint8_t position = start + 2 * numberOfNeighbours + 1;
+	uint32_t originTime = ((uint32_t)receiveBuffer[position + 2]) << 24 |
+		((uint32_t)receiveBuffer[position + 3]) << 16 |
+		((uint32_t)receiveBuffer[position + 4]) << 8 |
+		((uint32_t)receiveBuffer[position + 5]);
+	if(receiveBuffer[position] & loRaBeaconFlag)
+	{
+		recordLoRaBeacon(receiveBuffer[position] & (0xff ^ loRaBeaconFlag));
+	}
+	else if(receiveBuffer[position] >= loRaMinimumSpreadingFactor && receiveBuffer[position] <= 12)
+	{
+		considerLoRaSpreadingFactor(receiveBuffer[position], receiveBuffer[position + 1], originTime);
+	}
+	#if defined(TREACLE_DEBUG)
+		debugPrint(treacleDebugString_spreading_factor);
+		debugPrint(':');
+		debugPrint(receiveBuffer[position]);
+		debugPrint(' ');
+	#endif
+}
+void treacleClass::enableLoRaSlots(uint8_t slots)
+{
+	loRaNumberOfSlots = slots < 2 ? 2 : (slots > loRaMaximumNumberOfSlots ? loRaMaximumNumberOfSlots : slots);
+	loRaSlot = 255;
+	enableTimeSync();											//Slots are timed from network time
+	if(transport != nullptr && loRaInitialised() && loRaNodeSlot == nullptr)	//Otherwise this happens in begin()
+	{
+		allocateLoRaSlots();
+	}
+}
+void treacleClass::disableLoRaSlots()
+{
+	loRaNumberOfSlots = 0;
+	loRaSlot = 255;
+}
+uint8_t treacleClass::getLoRaSlot()
+{
+	if(loRaNumberOfSlots > 0)
+	{
+		return loRaSlot;
+	}
+	return 255;
+}
+uint32_t treacleClass::getLoRaSlotChanges()
+{
+	return loRaSlotChanges;
+}
+void treacleClass::allocateLoRaSlots()
+{
+	loRaNodeSlot = new uint8_t[maximumNumberOfNodes];
+	loRaNodeSlotNeighbours = new uint32_t[maximumNumberOfNodes];
+	for(uint8_t index = 0; index < maximumNumberOfNodes; index++)
+	{
+		loRaNodeSlot[index] = 255;
+		loRaNodeSlotNeighbours[index] = 0;
+	}
+}
+uint32_t treacleClass::loRaSlotLength()
+{
+	uint32_t slotLength = loRaTimeOnAir(maximumBufferSize)/1000 + loRaSlotGuardTime;	//Long enough for the largest packet
+	if(slotLength * loRaNumberOfSlots > maximumTickTime)
+	{
+		slotLength = maximumTickTime / loRaNumberOfSlots;								//A frame must fit in the longest tick
+	}
+	return slotLength;
+}
+uint16_t treacleClass::timeToLoRaSlot(uint16_t notBefore)
+{
+	uint32_t slotLength = loRaSlotLength();
+	uint32_t frameLength = slotLength * loRaNumberOfSlots;
+	uint32_t framePosition = (networkMillis() + notBefore) % frameLength;				//Frames are aligned to network time, so all nodes agree on them
+	uint32_t slotStart = loRaSlot * slotLength + loRaSlotGuardTime/2;
+	return notBefore + (slotStart + frameLength - framePosition) % frameLength;
+}
+void treacleClass::bringForwardLoRaTick()
+{
+	if(transport[loRaTransportId].nextTick == 0)
+	{
+		return;
+	}
+	if(loRaNumberOfSlots > 0 && loRaSlot < loRaNumberOfSlots)
+	{
+		transport[loRaTransportId].lastTick = millis() + timeToLoRaSlot(0) - transport[loRaTransportId].nextTick;	//At the start of the next slot
+		return;
+	}
+	transport[loRaTransportId].lastTick = millis() - (transport[loRaTransportId].nextTick + tickRandomisation(loRaTransportId));
+}
+uint16_t treacleClass::nextLoRaSlotTick()
+{
+	selectLoRaSlot();
+	uint32_t frameLength = loRaSlotLength() * loRaNumberOfSlots;
+	uint16_t notBefore = transport[loRaTransportId].defaultTick > frameLength ? transport[loRaTransportId].defaultTick - frameLength : 0;
+	uint16_t nextTick = timeToLoRaSlot(notBefore);										//The first time the slot comes round, up to the default tick
+	return nextTick > 0 ? nextTick : frameLength;										//0 would mean never
+}
+void treacleClass::selectLoRaSlot()
+{
+	if(loRaNodeSlot == nullptr)
+	{
+		return;
+	}
+	uint32_t slotsUsed = 0;
+	bool keepSlot = loRaSlot < loRaNumberOfSlots;
+	for(uint8_t nodeIndex = 0; nodeIndex < numberOfNodes; nodeIndex++)
+	{
+		if((node[nodeIndex].rxReliability[loRaTransportId] & 0xf000) != 0)				//Only nodes heard in the last few ticks
+		{
+			if(loRaNodeSlot[nodeIndex] < loRaNumberOfSlots)
+			{
+				slotsUsed |= 0x00000001UL << loRaNodeSlot[nodeIndex];
+				if(loRaNodeSlot[nodeIndex] == loRaSlot && node[nodeIndex].id < currentNodeId)
+				{
+					keepSlot = false;													//Clash with a neighbour, the higher ID moves
+				}
+			}
+			slotsUsed |= loRaNodeSlotNeighbours[nodeIndex];
+			if(keepSlot == true && (loRaNodeSlotNeighbours[nodeIndex] & (0x00000001UL << loRaSlot)) && random(0,2) == 0)
+			{
+				keepSlot = false;														//Clash with a node two hops away, whose ID is unknown so either might move
+			}
+		}
+	}
+	if(keepSlot == false)
+	{
+		uint8_t freeSlots = 0;
+		for(uint8_t slot = 0; slot < loRaNumberOfSlots; slot++)
+		{
+			if((slotsUsed & (0x00000001UL << slot)) == 0)
+			{
+				freeSlots++;
+			}
+		}
+		if(freeSlots == 0 && loRaSlot < loRaNumberOfSlots)
+		{
+			return;																		//Moving won't help when every slot is in use, so share this one
+		}
+		uint8_t choice = freeSlots > 0 ? random(0, freeSlots) : random(0, loRaNumberOfSlots);	//If there are no free slots share one at random
+		for(uint8_t slot = 0; slot < loRaNumberOfSlots; slot++)
+		{
+			if(freeSlots == 0 || (slotsUsed & (0x00000001UL << slot)) == 0)
+			{
+				if(choice == 0)
+				{
+					if(loRaSlot < loRaNumberOfSlots)
+					{
+						loRaSlotChanges++;
+					}
+					loRaSlot = slot;
+					break;
+				}
+				choice--;
+			}
+		}
+		#if defined(TREACLE_DEBUG)
+			debugPrint(treacleDebugString_treacleSpace);
+			debugPrint(treacleDebugString_LoRa);
+			debugPrint(' ');
+			debugPrint(treacleDebugString_slot);
+			debugPrint(':');
+			debugPrintln(loRaSlot);
+		#endif
+	}
+}
+void treacleClass::addLoRaSlotToPacket()
+{
+	if(loRaNumberOfSlots == 0 || loRaSlot >= loRaNumberOfSlots || loRaNodeSlot == nullptr)
+	{
+		return;
+	}
+	uint8_t numberOfNeighbours = 0;
+	for(uint8_t nodeIndex = 0; nodeIndex < numberOfNodes; nodeIndex++)
+	{
+		if((node[nodeIndex].rxReliability[loRaTransportId] & 0xf000) != 0 && loRaNodeSlot[nodeIndex] < loRaNumberOfSlots &&
+			transport[loRaTransportId].transmitPacketSize + 2 * numberOfNeighbours + 4 + timeSyncSize <= maximumPayloadSize)
+		{
+			transport[loRaTransportId].transmitBuffer[transport[loRaTransportId].transmitPacketSize++] = node[nodeIndex].id;
+			transport[loRaTransportId].transmitBuffer[transport[loRaTransportId].transmitPacketSize++] = loRaNodeSlot[nodeIndex];
+			numberOfNeighbours++;
+		}
+	}
+	transport[loRaTransportId].transmitBuffer[transport[loRaTransportId].transmitPacketSize++] = numberOfNeighbours;
+	transport[loRaTransportId].transmitBuffer[transport[loRaTransportId].transmitPacketSize++] = loRaSlot;
+	transport[loRaTransportId].transmitBuffer[(uint8_t)headerPosition::payloadType] |= (uint8_t)payloadType::loRaSlots;	//Flag the slots at the end of the payload
+}
+void treacleClass::recordLoRaSlots(uint8_t nodeIndex, uint8_t start, uint8_t numberOfNeighbours)
+{
+	if(loRaNodeSlot == nullptr)
+	{
+		return;
+	}
+	uint32_t neighbourSlots = 0;
+	for(uint8_t neighbour = 0; neighbour < numberOfNeighbours; neighbour++)
+	{
+		if(receiveBuffer[start + 2 * neighbour] != currentNodeId && receiveBuffer[start + 2 * neighbour + 1] < loRaMaximumNumberOfSlots)	//This node's own slot doesn't count
+		{
+			neighbourSlots |= 0x00000001UL << receiveBuffer[start + 2 * neighbour + 1];
+		}
+	}
+	loRaNodeSlot[nodeIndex] = receiveBuffer[start + 2 * numberOfNeighbours + 1];
+	loRaNodeSlotNeighbours[nodeIndex] = neighbourSlots;
+	#if defined(TREACLE_DEBUG)
+		debugPrint(treacleDebugString_slot);
+		debugPrint(':');
+		debugPrint(loRaNodeSlot[nodeIndex]);
+		debugPrint(' ');
+	#endif
 }
 uint16_t treacleClass::loRaRxReliability(uint8_t id)
 {
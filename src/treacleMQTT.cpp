@@ -284,8 +284,7 @@ bool treacleClass::sendBufferByMQTT(uint8_t* buffer, uint8_t packetSize)
 	transport[MQTTTransportId].txStartTime = micros();
 	if(mqtt->publish(MQTTtopic, buffer, packetSize))
 	{
-		transport[MQTTTransportId].txTime += micros()			//Add to the total transmit time
-			- transport[MQTTTransportId].txStartTime;
+		recordTxTime(MQTTTransportId, micros() - transport[MQTTTransportId].txStartTime);			//Add to the total transmit time and duty cycle window
 		transport[MQTTTransportId].txStartTime = 0;				//Clear the initial send time
 		transport[MQTTTransportId].txPackets++;					//Count the packet
 		return true;